@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "analysis_cache.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Drop the source positions bril2json -p adds, which change without the code changing
+void strip_positions(json &value)
+{
+  if (value.is_object())
+  {
+    value.erase("pos");
+    for (auto &[key, field] : value.items())
+    {
+      strip_positions(field);
+    }
+  }
+  else if (value.is_array())
+  {
+    for (auto &element : value)
+    {
+      strip_positions(element);
+    }
+  }
+}
+
+// Two unrelated 64-bit hashes of the same bytes, so a file name collision needs both to collide
+std::pair<uint64_t, uint64_t> hash128(const std::string &text)
+{
+  uint64_t fnv = 0xcbf29ce484222325ull;
+  uint64_t mix = 0x9e3779b97f4a7c15ull ^ text.size();
+  for (unsigned char c : text)
+  {
+    fnv = (fnv ^ c) * 0x100000001b3ull;
+    mix = (mix ^ c) * 0xff51afd7ed558ccdull;
+    mix ^= mix >> 32;
+  }
+  mix ^= mix >> 33;
+  mix *= 0xc4ceb9fe1a85ec53ull;
+  mix ^= mix >> 33;
+  return {fnv, mix};
+}
+
+} // namespace
+
+AnalysisCache::AnalysisCache(std::string dir, uint64_t max_bytes) : dir(std::move(dir)), max_bytes(max_bytes)
+{
+  std::error_code ec;
+  fs::create_directories(this->dir, ec);
+  for (auto it = fs::recursive_directory_iterator(this->dir, ec); !ec && it != fs::recursive_directory_iterator();
+       it.increment(ec))
+  {
+    if (it->is_regular_file(ec))
+    {
+      total_bytes += it->file_size(ec);
+    }
+  }
+}
+
+std::unique_ptr<AnalysisCache> AnalysisCache::from_env()
+{
+  const char *dir = std::getenv("BRIL_CACHE_DIR");
+  if (!dir || !*dir)
+  {
+    return nullptr;
+  }
+  const char *max_mb = std::getenv("BRIL_CACHE_MAX_MB");
+  uint64_t max_bytes = (max_mb && *max_mb ? std::strtoull(max_mb, nullptr, 10) : 256) << 20;
+  return std::make_unique<AnalysisCache>(dir, max_bytes);
+}
+
+std::string AnalysisCache::digest(const json &func)
+{
+  json normalized = json::object();
+  for (const char *field : {"args", "type", "instrs"})
+  {
+    if (func.contains(field))
+    {
+      normalized[field] = func[field];
+    }
+  }
+  strip_positions(normalized);
+
+  auto [high, low] = hash128(normalized.dump());
+  char hex[33];
+  std::snprintf(hex, sizeof hex, "%016llx%016llx", (unsigned long long)high, (unsigned long long)low);
+  return hex;
+}
+
+std::string AnalysisCache::path_of(const std::string &kind, const std::string &digest) const
+{
+  return dir + "/" + kind + "/" + digest + ".cbor";
+}
+
+std::optional<json> AnalysisCache::lookup(const std::string &kind, const std::string &digest)
+{
+  std::string path = path_of(kind, digest);
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+  {
+    misses++;
+    return std::nullopt;
+  }
+  std::vector<uint8_t> bytes{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+
+  // A truncated or foreign file is just a miss; the next store replaces it
+  json value = json::from_cbor(bytes, true, false);
+  if (value.is_discarded())
+  {
+    misses++;
+    return std::nullopt;
+  }
+
+  // Mark it recently used
+  std::error_code ec;
+  fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+  hits++;
+  return value;
+}
+
+void AnalysisCache::store(const std::string &kind, const std::string &digest, const json &value)
+{
+  std::string path = path_of(kind, digest);
+  std::error_code ec;
+  fs::create_directories(dir + "/" + kind, ec);
+
+  // Write to a private name and rename into place, so readers never see half an entry
+  std::vector<uint8_t> bytes = json::to_cbor(value);
+  std::string tmp = path + ".tmp" + std::to_string(::getpid()) + "-" +
+                    std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+  {
+    std::ofstream out(tmp, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    if (!out)
+    {
+      fs::remove(tmp, ec);
+      return;
+    }
+  }
+  fs::rename(tmp, path, ec);
+  if (ec)
+  {
+    fs::remove(tmp, ec);
+    return;
+  }
+
+  total_bytes += bytes.size();
+  if (total_bytes > max_bytes)
+  {
+    evict();
+  }
+}
+
+void AnalysisCache::evict()
+{
+  // Rescan, since other processes may have added or evicted entries too
+  struct Entry {
+    fs::file_time_type used;
+    uint64_t size;
+    fs::path path;
+  };
+  std::vector<Entry> entries;
+  std::error_code ec;
+  total_bytes = 0;
+  for (auto it = fs::recursive_directory_iterator(dir, ec); !ec && it != fs::recursive_directory_iterator();
+       it.increment(ec))
+  {
+    if (it->is_regular_file(ec) && it->path().extension() == ".cbor")
+    {
+      Entry entry{it->last_write_time(ec), it->file_size(ec), it->path()};
+      total_bytes += entry.size;
+      entries.push_back(std::move(entry));
+    }
+  }
+
+  std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.used < b.used; });
+  for (const Entry &entry : entries)
+  {
+    if (total_bytes <= max_bytes / 10 * 9)
+    {
+      break;
+    }
+    if (fs::remove(entry.path, ec))
+    {
+      total_bytes -= entry.size;
+    }
+  }
+}
@@ -0,0 +1,74 @@
+#ifndef ANALYSIS_CACHE_H
+#define ANALYSIS_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+/**
+ * @brief An on-disk cache of per-function results, addressed by content.
+ *
+ * Each result is stored under the digest of the function it was computed
+ * from and the kind of result it is (e.g. "cfg-1", "adce-1"; bump the number
+ * whenever the code producing it changes).  A function that comes back
+ * unchanged, in this program or any other, gets the stored result instead of
+ * being analyzed again.
+ *
+ * Entries are CBOR files under `dir/<kind>/`, written atomically so several
+ * processes can share a directory.  A hit refreshes the entry's modification
+ * time, and once the directory grows past `max_bytes` the least recently used
+ * entries are deleted until it is back under 90% of that.
+ */
+class AnalysisCache {
+public:
+  AnalysisCache(std::string dir, uint64_t max_bytes);
+
+  /**
+   * @brief The cache configured by the environment, if any.
+   *
+   * `BRIL_CACHE_DIR` turns caching on; `BRIL_CACHE_MAX_MB` caps its size
+   * (256 MB by default).
+   *
+   * @return nullptr when `BRIL_CACHE_DIR` is unset, so tools run uncached.
+   */
+  static std::unique_ptr<AnalysisCache> from_env();
+
+  /**
+   * @brief Digest of a function's normalized form.
+   *
+   * Covers the arguments, return type and instructions, without source
+   * positions, in canonical JSON.  The name is left out so identical
+   * functions share entries.  128 bits, as 32 hex digits.
+   */
+  static std::string digest(const json& func);
+
+  /**
+   * @brief The stored result of this kind for the function with this digest.
+   */
+  std::optional<json> lookup(const std::string& kind, const std::string& digest);
+
+  /**
+   * @brief Stores a result, evicting old entries if the cache is over its cap.
+   *
+   * Failures to write are ignored; the cache is only an accelerator.
+   */
+  void store(const std::string& kind, const std::string& digest, const json& value);
+
+  /// Lookups answered from and missing the cache, for reporting.
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+
+private:
+  std::string path_of(const std::string& kind, const std::string& digest) const;
+  void evict();
+
+  std::string dir;
+  uint64_t max_bytes;
+  uint64_t total_bytes = 0;   ///< Size of the directory as of the last scan plus what was stored since.
+};
+
+#endif // ANALYSIS_CACHE_H
@@ -0,0 +1,97 @@
+#include <string>
+#include <vector>
+#include "cached_analyses.h"
+
+namespace {
+
+// Kinds of cached results; bump the number when the analysis behind one changes
+const std::string CFG_KIND = "cfg-1";
+const std::string DOM_KIND = "dom-1";
+
+template <typename Compute>
+DominatorTree cached_tree(AnalysisCache *cache, const std::string &kind, const std::string &digest, Compute compute)
+{
+  if (!cache)
+  {
+    return compute();
+  }
+  if (std::optional<json> stored = cache->lookup(kind, digest))
+  {
+    return dominator_tree_from_json(*stored);
+  }
+  DominatorTree tree = compute();
+  cache->store(kind, digest, dominator_tree_to_json(tree));
+  return tree;
+}
+
+} // namespace
+
+json block_graph_to_json(const BlockGraph &graph)
+{
+  return {{"names", graph.names},
+          {"blocks", graph.blocks},
+          {"preds", graph.preds},
+          {"succs", graph.succs},
+          {"layout", graph.layout},
+          {"explicit_label", graph.explicit_label},
+          {"implicit_terminator", graph.implicit_terminator}};
+}
+
+BlockGraph block_graph_from_json(const json &j)
+{
+  BlockGraph graph;
+  j.at("names").get_to(graph.names);
+  j.at("blocks").get_to(graph.blocks);
+  j.at("preds").get_to(graph.preds);
+  j.at("succs").get_to(graph.succs);
+  j.at("layout").get_to(graph.layout);
+  j.at("explicit_label").get_to(graph.explicit_label);
+  j.at("implicit_terminator").get_to(graph.implicit_terminator);
+  for (unsigned idx = 0; idx < graph.size(); idx++)
+  {
+    graph.indices[graph.names[idx]] = idx;
+  }
+  return graph;
+}
+
+json dominator_tree_to_json(const DominatorTree &tree)
+{
+  return {{"root", tree.root},
+          {"idoms", tree.idoms},
+          {"children", tree.children},
+          {"frontier", tree.frontier},
+          {"pre", tree.pre},
+          {"post", tree.post}};
+}
+
+DominatorTree dominator_tree_from_json(const json &j)
+{
+  DominatorTree tree;
+  j.at("root").get_to(tree.root);
+  j.at("idoms").get_to(tree.idoms);
+  j.at("children").get_to(tree.children);
+  j.at("frontier").get_to(tree.frontier);
+  j.at("pre").get_to(tree.pre);
+  j.at("post").get_to(tree.post);
+  return tree;
+}
+
+BlockGraph cached_block_graph(AnalysisCache *cache, const json &func, const std::string &digest)
+{
+  if (!cache)
+  {
+    return form_block_graph(func["instrs"].get<std::vector<json>>());
+  }
+  if (std::optional<json> stored = cache->lookup(CFG_KIND, digest))
+  {
+    return block_graph_from_json(*stored);
+  }
+  BlockGraph graph = form_block_graph(func["instrs"].get<std::vector<json>>());
+  cache->store(CFG_KIND, digest, block_graph_to_json(graph));
+  return graph;
+}
+
+DominatorTree cached_dominators(AnalysisCache *cache, const BlockGraph &graph, const std::string &digest)
+{
+  return cached_tree(cache, DOM_KIND, digest, [&] { return compute_dominators(graph); });
+}
@@ -0,0 +1,36 @@
+#ifndef CACHED_ANALYSES_H
+#define CACHED_ANALYSES_H
+
+#include <nlohmann/json.hpp>
+#include "../cfg/block_graph.h"
+#include "../dominance-tree/dominator_tree.h"
+#include "analysis_cache.h"
+
+using json = nlohmann::json;
+
+/// Serialized forms of the index-form CFG and dominator trees, as the cache stores them.
+json block_graph_to_json(const BlockGraph& graph);
+BlockGraph block_graph_from_json(const json& j);
+json dominator_tree_to_json(const DominatorTree& tree);
+DominatorTree dominator_tree_from_json(const json& j);
+
+/**
+ * @brief `form_block_graph` for a function, through the cache.
+ *
+ * With a null cache this is just `form_block_graph(func["instrs"])`.  A
+ * cached graph may carry different generated names for unlabeled blocks
+ * than a fresh one would; they are still unique within the function.
+ *
+ * @param func Bril function object.
+ * @param digest `AnalysisCache::digest(func)`, computed once per function.
+ */
+BlockGraph cached_block_graph(AnalysisCache* cache, const json& func, const std::string& digest);
+
+/**
+ * @brief `compute_dominators(graph)` through the cache.
+ *
+ * `graph` must be the graph of the function with this digest.
+ */
+DominatorTree cached_dominators(AnalysisCache* cache, const BlockGraph& graph, const std::string& digest);
+
+#endif // CACHED_ANALYSES_H
@@ -0,0 +1,19 @@
+#!/bin/sh
+# Runs a cached tool twice on the program on stdin, first against an empty
+# cache and then against what the first run stored, and fails unless both
+# print the same.  Prints that output followed by the kinds of results the
+# cache holds.
+# Usage: bril2json < prog.bril | ./cold_warm.sh tool [args...]
+set -e
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cat > "$work/program.json"
+
+BRIL_CACHE_DIR=$work/cache "$@" < "$work/program.json" > "$work/cold"
+BRIL_CACHE_DIR=$work/cache "$@" < "$work/program.json" > "$work/warm"
+cat "$work/warm"
+echo "cached: $(ls "$work/cache" 2>/dev/null | tr '\n' ' ')"
+if ! cmp -s "$work/cold" "$work/warm"; then
+  echo "warm run differs from cold run" >&2
+  exit 1
+fi
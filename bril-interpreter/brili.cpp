@@ -0,0 +1,88 @@
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "bytecode.hpp"
+#include "interpreter.hpp"
+
+using json = nlohmann::json;
+
+int main(int argc, char **argv)
+{
+  // `-p` asks for the dynamic instruction count, `--call-profile FILE` for the
+  // calls between functions; everything else is an argument to main
+  bool profile = false;
+  std::string call_profile;
+  std::vector<std::string> args;
+  for (int k = 1; k < argc; k++)
+  {
+    if (std::strcmp(argv[k], "-p") == 0)
+    {
+      profile = true;
+    }
+    else if (std::strcmp(argv[k], "--call-profile") == 0 && k + 1 < argc)
+    {
+      call_profile = argv[++k];
+    }
+    else
+    {
+      args.push_back(argv[k]);
+    }
+  }
+
+  std::ios::sync_with_stdio(false);
+
+  // Read JSON input
+  json program;
+  std::cin >> program;
+
+  // Check if "functions" exists and is an array
+  if (!program.contains("functions") || !program["functions"].is_array())
+  {
+    std::cerr << "Error: Expected a 'functions' key with an array of functions.\n";
+    return 1;
+  }
+
+  interp::Program lowered;
+  try
+  {
+    lowered = interp::lower(program);
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "error: " << e.what() << "\n";
+    return 1;
+  }
+
+  interp::Interpreter interpreter(lowered, std::cout);
+  if (!call_profile.empty())
+  {
+    interpreter.profile_calls();
+  }
+  try
+  {
+    interpreter.run_main(args);
+  }
+  catch (const std::exception &e)
+  {
+    std::cout.flush();
+    std::cerr << "error: " << e.what() << "\n";
+    return 2;
+  }
+
+  std::cout.flush();
+  if (profile)
+  {
+    std::cerr << "total_dyn_inst: " << interpreter.instruction_count() << "\n";
+  }
+  if (!call_profile.empty())
+  {
+    std::ofstream profile_file(call_profile);
+    interpreter.write_call_profile(profile_file);
+  }
+
+  return 0;
+}
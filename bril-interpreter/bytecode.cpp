@@ -0,0 +1,458 @@
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../utils.hpp"
+#include "bytecode.hpp"
+
+namespace interp {
+
+using json = nlohmann::json;
+
+namespace {
+
+// Opcodes that map one-to-one onto a Bril op with a destination and one or two register operands
+const std::unordered_map<std::string, Opcode> VALUE_OPS = {
+    {"id", Opcode::ID},
+    {"add", Opcode::ADD}, {"sub", Opcode::SUB}, {"mul", Opcode::MUL}, {"div", Opcode::DIV},
+    {"eq", Opcode::EQ}, {"lt", Opcode::LT}, {"gt", Opcode::GT}, {"le", Opcode::LE}, {"ge", Opcode::GE},
+    {"not", Opcode::NOT}, {"and", Opcode::AND}, {"or", Opcode::OR},
+    {"fadd", Opcode::FADD}, {"fsub", Opcode::FSUB}, {"fmul", Opcode::FMUL}, {"fdiv", Opcode::FDIV},
+    {"feq", Opcode::FEQ}, {"flt", Opcode::FLT}, {"fgt", Opcode::FGT}, {"fle", Opcode::FLE}, {"fge", Opcode::FGE},
+    {"ceq", Opcode::CEQ}, {"clt", Opcode::CLT}, {"cgt", Opcode::CGT}, {"cle", Opcode::CLE}, {"cge", Opcode::CGE},
+    {"char2int", Opcode::CHAR2INT}, {"int2char", Opcode::INT2CHAR},
+    {"alloc", Opcode::ALLOC}, {"load", Opcode::LOAD}, {"ptradd", Opcode::PTRADD}};
+
+// Per-function lowering state: register numbering and types
+struct Lowering {
+  Function fn;
+  std::unordered_map<std::string, uint32_t> regs;
+  std::unordered_map<std::string, TypeTag> types;
+
+  uint32_t reg(const std::string &name)
+  {
+    auto [it, inserted] = regs.emplace(name, fn.num_regs);
+    if (inserted)
+    {
+      fn.num_regs++;
+    }
+    return it->second;
+  }
+
+  uint32_t arg(const Instruction &instr, size_t k)
+  {
+    if (k >= instr.args.size())
+    {
+      throw std::runtime_error("'" + instr.op + "' is missing an argument");
+    }
+    return reg(instr.args[k]);
+  }
+};
+
+// Which registers each instruction must CHECK before reading: those that are
+// not written on every path from the entry (a must-be-defined data-flow
+// analysis over basic blocks).  A guard's label is entered after rolling
+// back, so nothing is assumed defined there.  Expects every variable of
+// `instrs` to have a register already.
+std::vector<std::vector<uint32_t>> undefined_reads(Lowering &L, const std::vector<Instruction> &instrs)
+{
+  // Split into blocks of instruction indices
+  std::vector<size_t> starts;
+  std::unordered_map<std::string, size_t> label_block;
+  for (size_t k = 0; k < instrs.size(); k++)
+  {
+    bool after_terminator = k > 0 && !instrs[k - 1].label &&
+                            (instrs[k - 1].op == "jmp" || instrs[k - 1].op == "br" || instrs[k - 1].op == "ret");
+    if (starts.empty() || after_terminator || (instrs[k].label && k != starts.back()))
+    {
+      starts.push_back(k);
+    }
+    if (instrs[k].label)
+    {
+      label_block[*instrs[k].label] = starts.size() - 1;
+    }
+  }
+  size_t n = starts.size();
+  starts.push_back(instrs.size());
+
+  std::vector<std::vector<size_t>> preds(n);
+  std::vector<bool> rolled_back(n, false);
+  auto block_of = [&](const std::string &label) {
+    auto it = label_block.find(label);
+    if (it == label_block.end())
+    {
+      throw std::runtime_error("undefined label '" + label + "' in @" + L.fn.name);
+    }
+    return it->second;
+  };
+  for (size_t b = 0; b < n; b++)
+  {
+    bool falls_through = true;
+    for (size_t k = starts[b]; k < starts[b + 1]; k++)
+    {
+      const Instruction &instr = instrs[k];
+      if (instr.label)
+      {
+        continue;
+      }
+      if (instr.op == "guard")
+      {
+        rolled_back[block_of(instr.labels.at(0))] = true;
+      }
+      else if (instr.op == "jmp" || instr.op == "br")
+      {
+        for (const auto &label : instr.labels)
+        {
+          preds[block_of(label)].push_back(b);
+        }
+        falls_through = false;
+      }
+      else if (instr.op == "ret")
+      {
+        falls_through = false;
+      }
+    }
+    if (falls_through && b + 1 < n)
+    {
+      preds[b + 1].push_back(b);
+    }
+  }
+
+  // Iterate to the greatest fixed point; blocks start as "everything defined"
+  std::vector<bool> params(L.fn.num_regs, false);
+  for (uint32_t r : L.fn.arg_regs)
+  {
+    params[r] = true;
+  }
+  std::vector<std::vector<bool>> in(n, std::vector<bool>(L.fn.num_regs, true));
+  std::vector<std::vector<bool>> out = in;
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (size_t b = 0; b < n; b++)
+    {
+      std::vector<bool> defined = b == 0 ? params : std::vector<bool>(L.fn.num_regs, true);
+      if (rolled_back[b])
+      {
+        defined.assign(L.fn.num_regs, false);
+      }
+      for (size_t p : preds[b])
+      {
+        for (uint32_t r = 0; r < L.fn.num_regs; r++)
+        {
+          defined[r] = defined[r] && out[p][r];
+        }
+      }
+      in[b] = defined;
+      for (size_t k = starts[b]; k < starts[b + 1]; k++)
+      {
+        if (instrs[k].dest)
+        {
+          defined[L.regs.at(*instrs[k].dest)] = true;
+        }
+      }
+      if (defined != out[b])
+      {
+        out[b] = std::move(defined);
+        changed = true;
+      }
+    }
+  }
+
+  std::vector<std::vector<uint32_t>> checks(instrs.size());
+  for (size_t b = 0; b < n; b++)
+  {
+    std::vector<bool> defined = in[b];
+    for (size_t k = starts[b]; k < starts[b + 1]; k++)
+    {
+      for (const auto &a : instrs[k].args)
+      {
+        uint32_t r = L.regs.at(a);
+        if (!defined[r])
+        {
+          checks[k].push_back(r);
+          defined[r] = true;
+        }
+      }
+      if (instrs[k].dest)
+      {
+        defined[L.regs.at(*instrs[k].dest)] = true;
+      }
+    }
+  }
+  return checks;
+}
+
+} // namespace
+
+uint32_t decode_char(const std::string &s)
+{
+  if (s.empty())
+  {
+    throw std::runtime_error("empty char constant");
+  }
+  unsigned char c0 = s[0];
+  if (c0 < 0x80)
+  {
+    return c0;
+  }
+  int extra = c0 >= 0xF0 ? 3 : c0 >= 0xE0 ? 2 : 1;
+  uint32_t cp = c0 & (0x3F >> extra);
+  for (int k = 1; k <= extra && k < static_cast<int>(s.size()); k++)
+  {
+    cp = (cp << 6) | (static_cast<unsigned char>(s[k]) & 0x3F);
+  }
+  return cp;
+}
+
+TypeTag type_tag(const json &type)
+{
+  if (type.is_object())
+  {
+    return TypeTag::PTR;
+  }
+  return type_tag(type.get<std::string>());
+}
+
+TypeTag type_tag(const std::string &name)
+{
+  if (!name.empty() && name.front() == '{')
+  {
+    return TypeTag::PTR;
+  }
+  if (name == "int")   return TypeTag::INT;
+  if (name == "bool")  return TypeTag::BOOL;
+  if (name == "float") return TypeTag::FLOAT;
+  if (name == "char")  return TypeTag::CHAR;
+  throw std::runtime_error("unknown type '" + name + "'");
+}
+
+Program lower(const json &program)
+{
+  Program prog;
+  const json &funcs = program.at("functions");
+
+  // Number the functions first so calls can be resolved in any order
+  for (const auto &f : funcs)
+  {
+    prog.function_index[f.at("name").get<std::string>()] = prog.functions.size();
+    prog.functions.emplace_back();
+  }
+
+  for (const auto &f : funcs)
+  {
+    Lowering L;
+    L.fn.name = f.at("name").get<std::string>();
+    L.fn.returns_value = f.contains("type");
+
+    if (f.contains("args"))
+    {
+      for (const auto &a : f["args"])
+      {
+        std::string name = a.at("name").get<std::string>();
+        L.fn.arg_regs.push_back(L.reg(name));
+        L.fn.arg_types.push_back(type_tag(a.at("type")));
+        L.fn.arg_names.push_back(name);
+        L.types[name] = L.fn.arg_types.back();
+      }
+    }
+
+    std::vector<Instruction> instrs = f.contains("instrs") ? f["instrs"].get<std::vector<Instruction>>()
+                                                           : std::vector<Instruction>{};
+
+    // Number every variable up front so the definedness analysis can index them
+    for (const auto &instr : instrs)
+    {
+      if (instr.dest)
+      {
+        L.reg(*instr.dest);
+      }
+      for (const auto &a : instr.args)
+      {
+        L.reg(a);
+      }
+    }
+    std::vector<std::vector<uint32_t>> checks = undefined_reads(L, instrs);
+
+    // First pass: every label's code offset and every variable's type
+    std::unordered_map<std::string, uint32_t> label_pc;
+    uint32_t pc = 0;
+    for (size_t k = 0; k < instrs.size(); k++)
+    {
+      const Instruction &instr = instrs[k];
+      if (instr.label)
+      {
+        label_pc[*instr.label] = pc;
+        continue;
+      }
+      if (instr.dest && instr.type)
+      {
+        L.types[*instr.dest] = type_tag(*instr.type);
+      }
+      pc += checks[k].size() + 1;
+    }
+
+    auto target = [&](const std::string &label) {
+      auto it = label_pc.find(label);
+      if (it == label_pc.end())
+      {
+        throw std::runtime_error("undefined label '" + label + "' in @" + L.fn.name);
+      }
+      return it->second;
+    };
+
+    // Second pass: emit the code
+    for (size_t k = 0; k < instrs.size(); k++)
+    {
+      const Instruction &instr = instrs[k];
+      if (instr.label)
+      {
+        continue;
+      }
+
+      for (uint32_t r : checks[k])
+      {
+        Op check;
+        check.code = Opcode::CHECK;
+        check.a = r;
+        L.fn.code.push_back(check);
+      }
+
+      Op op;
+      const std::string &name = instr.op;
+      auto value_op = VALUE_OPS.find(name);
+
+      if (name == "const")
+      {
+        Value v;
+        TypeTag t = L.types.at(*instr.dest);
+        const json &lit = *instr.value;
+        switch (t)
+        {
+        case TypeTag::INT:   v.i = lit.get<int64_t>(); break;
+        case TypeTag::BOOL:  v.b = lit.get<bool>(); break;
+        case TypeTag::FLOAT: v.f = lit.get<double>(); break;
+        case TypeTag::CHAR:  v.c = decode_char(lit.get<std::string>()); break;
+        case TypeTag::PTR:   throw std::runtime_error("pointer constants are not supported");
+        }
+        op.code = Opcode::CONST;
+        op.dest = L.reg(*instr.dest);
+        op.a = L.fn.constants.size();
+        L.fn.constants.push_back(v);
+      }
+      else if (value_op != VALUE_OPS.end())
+      {
+        op.code = value_op->second;
+        op.dest = L.reg(*instr.dest);
+        op.a = L.arg(instr, 0);
+        if (instr.args.size() > 1)
+        {
+          op.b = L.arg(instr, 1);
+        }
+      }
+      else if (name == "jmp")
+      {
+        op.code = Opcode::JMP;
+        op.a = target(instr.labels.at(0));
+      }
+      else if (name == "br")
+      {
+        op.code = Opcode::BR;
+        op.a = L.arg(instr, 0);
+        op.b = target(instr.labels.at(0));
+        op.dest = target(instr.labels.at(1));
+      }
+      else if (name == "guard")
+      {
+        op.code = Opcode::GUARD;
+        op.a = L.arg(instr, 0);
+        op.b = target(instr.labels.at(0));
+      }
+      else if (name == "call")
+      {
+        auto callee = prog.function_index.find(instr.funcs.at(0));
+        if (callee == prog.function_index.end())
+        {
+          throw std::runtime_error("call to unknown function @" + instr.funcs.at(0));
+        }
+        size_t expected = funcs[callee->second].contains("args") ? funcs[callee->second]["args"].size() : 0;
+        if (instr.args.size() != expected)
+        {
+          throw std::runtime_error("@" + instr.funcs.at(0) + " expects " + std::to_string(expected) +
+                                   " arguments, got " + std::to_string(instr.args.size()));
+        }
+        op.code = Opcode::CALL;
+        op.dest = instr.dest ? L.reg(*instr.dest) : NO_REG;
+        op.a = L.fn.aux.size();
+        op.b = instr.args.size();
+        L.fn.aux.push_back(callee->second);
+        for (const auto &a : instr.args)
+        {
+          L.fn.aux.push_back(L.reg(a));
+        }
+      }
+      else if (name == "ret")
+      {
+        if (instr.args.empty())
+        {
+          op.code = Opcode::RET_VOID;
+        }
+        else
+        {
+          op.code = Opcode::RET;
+          op.a = L.arg(instr, 0);
+        }
+      }
+      else if (name == "print")
+      {
+        op.code = Opcode::PRINT;
+        op.a = L.fn.aux.size();
+        op.b = instr.args.size();
+        for (const auto &a : instr.args)
+        {
+          auto t = L.types.find(a);
+          L.fn.aux.push_back(L.reg(a));
+          L.fn.aux.push_back(static_cast<uint32_t>(t == L.types.end() ? TypeTag::INT : t->second));
+        }
+      }
+      else if (name == "store")
+      {
+        op.code = Opcode::STORE;
+        op.a = L.arg(instr, 0);
+        op.b = L.arg(instr, 1);
+      }
+      else if (name == "free")
+      {
+        op.code = Opcode::FREE;
+        op.a = L.arg(instr, 0);
+      }
+      else if (name == "nop")      op.code = Opcode::NOP;
+      else if (name == "speculate") op.code = Opcode::SPECULATE;
+      else if (name == "commit")   op.code = Opcode::COMMIT;
+      else
+      {
+        throw std::runtime_error("unknown opcode '" + name + "' in @" + L.fn.name);
+      }
+
+      L.fn.code.push_back(op);
+    }
+
+    Op end;
+    end.code = Opcode::END;
+    L.fn.code.push_back(end);
+
+    L.fn.reg_names.resize(L.fn.num_regs);
+    for (const auto &[name, r] : L.regs)
+    {
+      L.fn.reg_names[r] = name;
+    }
+
+    prog.functions[prog.function_index[L.fn.name]] = std::move(L.fn);
+  }
+
+  return prog;
+}
+
+} // namespace interp
@@ -0,0 +1,174 @@
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../utils.hpp"   /**< Defines Instruction, from_json, to_json, etc. */
+
+namespace interp {
+
+/**
+ * @brief Every bytecode opcode, as an X-macro so the enum and the
+ * interpreter's dispatch table are generated from the same list.
+ *
+ * Operand layout (fields of `Op`):
+ *  - CONST:                    dest ← constants[a]
+ *  - unary ops (ID, NOT, ...): dest ← op(a)
+ *  - binary ops (ADD, ...):    dest ← a op b
+ *  - JMP:                      pc ← a
+ *  - BR:                       pc ← a ? b : dest
+ *  - GUARD:                    if !a: roll back speculation, pc ← b
+ *  - CALL:                     dest ← call(aux[a], aux[a+1 .. a+b]); dest is NO_REG for void calls
+ *  - RET:                      return a
+ *  - PRINT:                    print aux[a .. a+2b) as (register, type) pairs
+ *  - STORE:                    *a ← b
+ *  - FREE:                     free(a)
+ *  - CHECK:                    fail if register a is undefined (not counted)
+ *  - END:                      implicit return at the end of a function (not counted)
+ */
+#define BRIL_OPCODES(X) \
+  X(CONST) X(ID) \
+  X(ADD) X(SUB) X(MUL) X(DIV) \
+  X(EQ) X(LT) X(GT) X(LE) X(GE) \
+  X(NOT) X(AND) X(OR) \
+  X(FADD) X(FSUB) X(FMUL) X(FDIV) \
+  X(FEQ) X(FLT) X(FGT) X(FLE) X(FGE) \
+  X(CEQ) X(CLT) X(CGT) X(CLE) X(CGE) X(CHAR2INT) X(INT2CHAR) \
+  X(ALLOC) X(FREE) X(STORE) X(LOAD) X(PTRADD) \
+  X(JMP) X(BR) X(CALL) X(RET) X(RET_VOID) \
+  X(PRINT) X(NOP) \
+  X(SPECULATE) X(COMMIT) X(GUARD) \
+  X(CHECK) X(END)
+
+enum class Opcode : uint8_t {
+#define BRIL_ENUM(name) name,
+  BRIL_OPCODES(BRIL_ENUM)
+#undef BRIL_ENUM
+};
+
+/// Static type of a register, needed to print it and to parse `main`'s arguments.
+enum class TypeTag : uint8_t { INT, BOOL, FLOAT, CHAR, PTR };
+
+/**
+ * @brief A runtime value.  Registers are untyped; the bytecode knows which
+ * member is meaningful.  Pointers use `i` for the allocation id and
+ * `offset` for the element index within it.  A register that has not been
+ * written yet holds `Value::undefined()`, which only CHECK looks at.
+ */
+struct Value {
+  union {
+    int64_t  i;
+    double   f;
+    bool     b;
+    uint32_t c;
+  };
+  int64_t offset = 0;
+
+  Value() : i(0) {}
+
+  /// Offset marking an unwritten register; no valid pointer can have it.
+  static constexpr int64_t UNDEFINED = INT64_MIN;
+
+  static Value undefined()
+  {
+    Value v;
+    v.offset = UNDEFINED;
+    return v;
+  }
+
+  bool is_undefined() const { return offset == UNDEFINED; }
+};
+
+/// Sentinel register index meaning "no register".
+constexpr uint32_t NO_REG = ~0u;
+
+/**
+ * @brief One bytecode instruction: an opcode and up to three operands,
+ * all register indices, constant-pool indices or code offsets.
+ */
+struct Op {
+  Opcode   code;
+  uint32_t dest = NO_REG;
+  uint32_t a = 0;
+  uint32_t b = 0;
+};
+
+/**
+ * @brief A Bril function lowered to bytecode.
+ */
+struct Function {
+  std::string name;
+
+  /// The code, ending in an END op.
+  std::vector<Op> code;
+
+  /// Variable-length operands of CALL and PRINT.
+  std::vector<uint32_t> aux;
+
+  /// Constant pool for CONST.
+  std::vector<Value> constants;
+
+  /// Number of registers (distinct variables) the function uses.
+  uint32_t num_regs = 0;
+
+  /// Variable name of each register, for error messages.
+  std::vector<std::string> reg_names;
+
+  /// Registers and types of the parameters, in order.
+  std::vector<uint32_t> arg_regs;
+  std::vector<TypeTag> arg_types;
+  std::vector<std::string> arg_names;
+
+  /// True if the function returns a value.
+  bool returns_value = false;
+};
+
+/**
+ * @brief A whole lowered program.
+ */
+struct Program {
+  std::vector<Function> functions;
+  std::unordered_map<std::string, uint32_t> function_index;
+};
+
+/**
+ * @brief Lowers a Bril program in JSON form to register bytecode.
+ *
+ * Each function's variables are numbered densely and become registers;
+ * labels disappear and branch targets become code offsets.  Instructions
+ * are read through the `Instruction` struct from utils.hpp.  A CHECK is
+ * placed before each read of a variable that is not assigned on every path
+ * to it, so only those reads pay for reporting an undefined variable.
+ *
+ * @param program The parsed Bril JSON program.
+ * @return The lowered program.
+ *
+ * @throws std::runtime_error
+ *   On unknown opcodes, undefined labels, unknown functions, or call
+ *   sites whose argument count does not match the callee.
+ */
+Program lower(const nlohmann::json& program);
+
+/**
+ * @brief Converts a Bril type (e.g. `"int"` or `{"ptr": "int"}`) to a TypeTag.
+ */
+TypeTag type_tag(const nlohmann::json& type);
+
+/**
+ * @brief Converts the `Instruction::type` spelling of a Bril type to a TypeTag.
+ */
+TypeTag type_tag(const std::string& type);
+
+/**
+ * @brief Decodes the first UTF-8 code point of a string.
+ *
+ * @throws std::runtime_error If the string is empty.
+ */
+uint32_t decode_char(const std::string& s);
+
+} // namespace interp
+
+#endif // BYTECODE_HPP
@@ -0,0 +1,468 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "bytecode.hpp"
+#include "interpreter.hpp"
+
+using json = nlohmann::json;
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BRIL_THREADED_DISPATCH 1
+#endif
+
+namespace interp {
+
+namespace {
+
+// Wrapping 64-bit arithmetic, matching the reference interpreter's BigInt.asIntN(64)
+inline int64_t wrap_add(int64_t a, int64_t b) { return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b)); }
+inline int64_t wrap_sub(int64_t a, int64_t b) { return static_cast<int64_t>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b)); }
+inline int64_t wrap_mul(int64_t a, int64_t b) { return static_cast<int64_t>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b)); }
+
+void encode_char(std::string &s, uint32_t cp)
+{
+  if (cp < 0x80)
+  {
+    s += static_cast<char>(cp);
+  }
+  else if (cp < 0x800)
+  {
+    s += static_cast<char>(0xC0 | (cp >> 6));
+    s += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+  else if (cp < 0x10000)
+  {
+    s += static_cast<char>(0xE0 | (cp >> 12));
+    s += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    s += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+  else
+  {
+    s += static_cast<char>(0xF0 | (cp >> 18));
+    s += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    s += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    s += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+}
+
+// Floats print like JavaScript's toFixed(17), which is what brili uses
+void format_float(std::string &s, double f)
+{
+  if (std::isnan(f))
+  {
+    s += "NaN";
+  }
+  else if (std::isinf(f))
+  {
+    s += f > 0 ? "Infinity" : "-Infinity";
+  }
+  else
+  {
+    char buf[512];
+    std::snprintf(buf, sizeof(buf), "%.17f", f);
+    s += buf;
+  }
+}
+
+Value parse_argument(const std::string &text, TypeTag type, const std::string &name)
+{
+  Value v;
+  try
+  {
+    switch (type)
+    {
+    case TypeTag::INT:
+      v.i = std::stoll(text);
+      break;
+    case TypeTag::BOOL:
+      if (text != "true" && text != "false")
+      {
+        throw std::invalid_argument(text);
+      }
+      v.b = text == "true";
+      break;
+    case TypeTag::FLOAT:
+      v.f = std::stod(text);
+      break;
+    case TypeTag::CHAR:
+    {
+      // Exactly one code point, which may span several UTF-8 bytes
+      if (text.empty())
+      {
+        throw std::invalid_argument(text);
+      }
+      v.c = decode_char(text);
+      std::string encoded;
+      encode_char(encoded, v.c);
+      if (encoded != text)
+      {
+        throw std::invalid_argument(text);
+      }
+      break;
+    }
+    case TypeTag::PTR:
+      throw std::invalid_argument(text);
+    }
+  }
+  catch (const std::logic_error &)
+  {
+    throw std::runtime_error("invalid value '" + text + "' for argument " + name);
+  }
+  return v;
+}
+
+} // namespace
+
+Interpreter::Interpreter(const Program &program, std::ostream &out)
+    : program(program), out(out)
+{
+}
+
+void Interpreter::run_main(const std::vector<std::string> &args)
+{
+  auto it = program.function_index.find("main");
+  if (it == program.function_index.end())
+  {
+    throw std::runtime_error("no main function");
+  }
+  const Function &main_fn = program.functions[it->second];
+  if (args.size() != main_fn.arg_regs.size())
+  {
+    throw std::runtime_error("main expects " + std::to_string(main_fn.arg_regs.size()) +
+                             " arguments, got " + std::to_string(args.size()));
+  }
+
+  std::vector<Value> regs(main_fn.num_regs, Value::undefined());
+  for (size_t k = 0; k < args.size(); k++)
+  {
+    regs[main_fn.arg_regs[k]] = parse_argument(args[k], main_fn.arg_types[k], main_fn.arg_names[k]);
+  }
+  call(main_fn, regs);
+
+  if (live_allocations != 0)
+  {
+    throw std::runtime_error("some memory locations have not been freed by end of execution");
+  }
+}
+
+void Interpreter::write_call_profile(std::ostream &os) const
+{
+  json calls = json::array();
+  for (const auto &[pair, count] : call_counts)
+  {
+    calls.push_back({{"caller", program.functions[pair >> 32].name},
+                     {"callee", program.functions[pair & 0xffffffff].name},
+                     {"count", count}});
+  }
+  os << calls.dump(2) << "\n";
+}
+
+Value &Interpreter::cell(const Value &ptr)
+{
+  if (ptr.i < 0 || static_cast<uint64_t>(ptr.i) >= heap.size())
+  {
+    throw std::runtime_error("invalid pointer to heap location " + std::to_string(ptr.i));
+  }
+  Allocation &alloc = heap[ptr.i];
+  if (!alloc.live)
+  {
+    throw std::runtime_error("access to freed memory");
+  }
+  if (ptr.offset < 0 || static_cast<uint64_t>(ptr.offset) >= alloc.cells.size())
+  {
+    throw std::runtime_error("uninitialized heap location " + std::to_string(ptr.i) +
+                             " and/or illegal offset " + std::to_string(ptr.offset));
+  }
+  return alloc.cells[ptr.offset];
+}
+
+void Interpreter::print(const Function &fn, const Op &op, const std::vector<Value> &regs)
+{
+  std::string line;
+  for (uint32_t k = 0; k < op.b; k++)
+  {
+    if (k > 0)
+    {
+      line += ' ';
+    }
+    const Value &v = regs[fn.aux[op.a + 2 * k]];
+    switch (static_cast<TypeTag>(fn.aux[op.a + 2 * k + 1]))
+    {
+    case TypeTag::INT:   line += std::to_string(v.i); break;
+    case TypeTag::BOOL:  line += v.b ? "true" : "false"; break;
+    case TypeTag::FLOAT: format_float(line, v.f); break;
+    case TypeTag::CHAR:  encode_char(line, v.c); break;
+    case TypeTag::PTR:   line += "<ptr " + std::to_string(v.i) + "+" + std::to_string(v.offset) + ">"; break;
+    }
+  }
+  line += '\n';
+  out << line;
+}
+
+Value Interpreter::call(const Function &fn, std::vector<Value> &regs)
+{
+  const Op *code = fn.code.data();
+  const Op *pc = code;
+  Value *r = regs.data();
+
+  // Saved variables for each open `speculate`, innermost last
+  std::vector<std::vector<Value>> snapshots;
+
+  // Count into a local so the hot loop does not write through `this`
+  uint64_t count = 0;
+
+#ifdef BRIL_THREADED_DISPATCH
+  static const void *const dispatch_table[] = {
+#define BRIL_LABEL(name) &&L_##name,
+      BRIL_OPCODES(BRIL_LABEL)
+#undef BRIL_LABEL
+  };
+#define TARGET(name) L_##name: count++;
+#define DISPATCH() goto *dispatch_table[static_cast<uint8_t>(pc->code)]
+#else
+#define TARGET(name) case Opcode::name: count++;
+#define DISPATCH() goto dispatch
+#endif
+#define NEXT() do { pc++; DISPATCH(); } while (0)
+// Results are written as whole Values so they clear the undefined marker
+#define RESULT(member, expr) do { Value v_; v_.member = (expr); r[pc->dest] = v_; } while (0)
+#define BINARY(member, expr) do { RESULT(member, expr); NEXT(); } while (0)
+
+#ifdef BRIL_THREADED_DISPATCH
+  DISPATCH();
+  {
+#else
+dispatch:
+  switch (pc->code)
+  {
+#endif
+  TARGET(CONST) r[pc->dest] = fn.constants[pc->a]; NEXT();
+  TARGET(ID)    r[pc->dest] = r[pc->a]; NEXT();
+
+  TARGET(ADD) BINARY(i, wrap_add(r[pc->a].i, r[pc->b].i));
+  TARGET(SUB) BINARY(i, wrap_sub(r[pc->a].i, r[pc->b].i));
+  TARGET(MUL) BINARY(i, wrap_mul(r[pc->a].i, r[pc->b].i));
+  TARGET(DIV)
+  {
+    int64_t lhs = r[pc->a].i, rhs = r[pc->b].i;
+    if (rhs == 0)
+    {
+      icount += count;
+      throw std::runtime_error("division by zero");
+    }
+    RESULT(i, rhs == -1 ? wrap_sub(0, lhs) : lhs / rhs);
+    NEXT();
+  }
+
+  TARGET(EQ) BINARY(b, r[pc->a].i == r[pc->b].i);
+  TARGET(LT) BINARY(b, r[pc->a].i <  r[pc->b].i);
+  TARGET(GT) BINARY(b, r[pc->a].i >  r[pc->b].i);
+  TARGET(LE) BINARY(b, r[pc->a].i <= r[pc->b].i);
+  TARGET(GE) BINARY(b, r[pc->a].i >= r[pc->b].i);
+
+  TARGET(NOT) BINARY(b, !r[pc->a].b);
+  TARGET(AND) BINARY(b, r[pc->a].b && r[pc->b].b);
+  TARGET(OR)  BINARY(b, r[pc->a].b || r[pc->b].b);
+
+  TARGET(FADD) BINARY(f, r[pc->a].f + r[pc->b].f);
+  TARGET(FSUB) BINARY(f, r[pc->a].f - r[pc->b].f);
+  TARGET(FMUL) BINARY(f, r[pc->a].f * r[pc->b].f);
+  TARGET(FDIV) BINARY(f, r[pc->a].f / r[pc->b].f);
+
+  TARGET(FEQ) BINARY(b, r[pc->a].f == r[pc->b].f);
+  TARGET(FLT) BINARY(b, r[pc->a].f <  r[pc->b].f);
+  TARGET(FGT) BINARY(b, r[pc->a].f >  r[pc->b].f);
+  TARGET(FLE) BINARY(b, r[pc->a].f <= r[pc->b].f);
+  TARGET(FGE) BINARY(b, r[pc->a].f >= r[pc->b].f);
+
+  TARGET(CEQ) BINARY(b, r[pc->a].c == r[pc->b].c);
+  TARGET(CLT) BINARY(b, r[pc->a].c <  r[pc->b].c);
+  TARGET(CGT) BINARY(b, r[pc->a].c >  r[pc->b].c);
+  TARGET(CLE) BINARY(b, r[pc->a].c <= r[pc->b].c);
+  TARGET(CGE) BINARY(b, r[pc->a].c >= r[pc->b].c);
+  TARGET(CHAR2INT) BINARY(i, static_cast<int64_t>(r[pc->a].c));
+  TARGET(INT2CHAR)
+  {
+    int64_t v = r[pc->a].i;
+    if (v < 0 || v > 0x10FFFF || (v >= 0xD800 && v <= 0xDFFF))
+    {
+      icount += count;
+      throw std::runtime_error("value " + std::to_string(v) + " cannot be converted to char");
+    }
+    RESULT(c, static_cast<uint32_t>(v));
+    NEXT();
+  }
+
+  TARGET(ALLOC)
+  {
+    int64_t n = r[pc->a].i;
+    if (n <= 0)
+    {
+      icount += count;
+      throw std::runtime_error("cannot allocate " + std::to_string(n) + " entries");
+    }
+    Value ptr;
+    ptr.i = heap.size();
+    heap.emplace_back();
+    heap.back().cells.resize(n);
+    live_allocations++;
+    r[pc->dest] = ptr;
+    NEXT();
+  }
+  TARGET(FREE)
+  {
+    const Value &ptr = r[pc->a];
+    if (ptr.offset != 0 || ptr.i < 0 || static_cast<uint64_t>(ptr.i) >= heap.size() || !heap[ptr.i].live)
+    {
+      icount += count;
+      throw std::runtime_error("tried to free illegal memory location");
+    }
+    heap[ptr.i].live = false;
+    heap[ptr.i].cells = std::vector<Value>();
+    live_allocations--;
+    NEXT();
+  }
+  TARGET(STORE)
+  {
+    icount += count;
+    count = 0;
+    cell(r[pc->a]) = r[pc->b];
+    NEXT();
+  }
+  TARGET(LOAD)
+  {
+    icount += count;
+    count = 0;
+    r[pc->dest] = cell(r[pc->a]);
+    NEXT();
+  }
+  TARGET(PTRADD)
+  {
+    Value ptr = r[pc->a];
+    ptr.offset = wrap_add(ptr.offset, r[pc->b].i);
+    r[pc->dest] = ptr;
+    NEXT();
+  }
+
+  TARGET(JMP) pc = code + pc->a; DISPATCH();
+  TARGET(BR)  pc = code + (r[pc->a].b ? pc->b : pc->dest); DISPATCH();
+
+  TARGET(CALL)
+  {
+    const uint32_t *aux = fn.aux.data() + pc->a;
+    const Function &callee = program.functions[aux[0]];
+    if (call_profile_enabled)
+    {
+      call_counts[uint64_t(&fn - program.functions.data()) << 32 | aux[0]]++;
+    }
+    std::vector<Value> callee_regs(callee.num_regs, Value::undefined());
+    for (uint32_t k = 0; k < pc->b; k++)
+    {
+      callee_regs[callee.arg_regs[k]] = r[aux[k + 1]];
+    }
+    icount += count;
+    count = 0;
+    Value result = call(callee, callee_regs);
+    if (pc->dest != NO_REG)
+    {
+      r[pc->dest] = result;
+    }
+    NEXT();
+  }
+  TARGET(RET)
+  {
+    icount += count;
+    return r[pc->a];
+  }
+  TARGET(RET_VOID)
+  {
+    icount += count;
+    return Value();
+  }
+
+  TARGET(PRINT)
+  {
+    icount += count;
+    count = 0;
+    print(fn, *pc, regs);
+    NEXT();
+  }
+  TARGET(NOP) NEXT();
+
+  TARGET(SPECULATE)
+  {
+    snapshots.emplace_back(regs);
+    NEXT();
+  }
+  TARGET(COMMIT)
+  {
+    if (snapshots.empty())
+    {
+      icount += count;
+      throw std::runtime_error("commit in non-speculative state");
+    }
+    snapshots.pop_back();
+    NEXT();
+  }
+  TARGET(GUARD)
+  {
+    if (r[pc->a].b)
+    {
+      NEXT();
+    }
+    if (snapshots.empty())
+    {
+      icount += count;
+      throw std::runtime_error("guard failed in non-speculative state");
+    }
+    // Abort: restore the variables from before `speculate` and take the guard's label
+    regs.swap(snapshots.back());
+    snapshots.pop_back();
+    r = regs.data();
+    pc = code + pc->b;
+    DISPATCH();
+  }
+
+  TARGET(CHECK)
+  {
+    // Inserted by the lowering, not a Bril instruction
+    count--;
+    if (r[pc->a].is_undefined())
+    {
+      icount += count;
+      throw std::runtime_error("undefined variable " + fn.reg_names[pc->a]);
+    }
+    NEXT();
+  }
+
+#ifdef BRIL_THREADED_DISPATCH
+  L_END:
+#else
+  case Opcode::END:
+#endif
+  {
+    icount += count;
+    if (fn.returns_value)
+    {
+      throw std::runtime_error("@" + fn.name + " reached its end without returning a value");
+    }
+    return Value();
+  }
+  }
+
+#undef TARGET
+#undef DISPATCH
+#undef NEXT
+#undef RESULT
+#undef BINARY
+
+  return Value();
+}
+
+} // namespace interp
@@ -0,0 +1,79 @@
+#ifndef INTERPRETER_HPP
+#define INTERPRETER_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "bytecode.hpp"
+
+namespace interp {
+
+/**
+ * @brief Executes lowered Bril bytecode.
+ *
+ * Dispatch is threaded through a computed-goto table when the compiler
+ * supports it (GCC and Clang), and falls back to a switch otherwise.
+ *
+ * Speculation follows the reference interpreter: `speculate` snapshots the
+ * current function's variables, `commit` discards the newest snapshot, and
+ * a failing `guard` restores it and jumps to the guard's label.  Only
+ * variables are rolled back; memory and output are not, so a trace must not
+ * store or print before its guards (trace-injector.cpp never emits such
+ * traces).  Speculation may nest, and is local to the function frame it
+ * started in.
+ */
+class Interpreter {
+public:
+  Interpreter(const Program &program, std::ostream &out);
+
+  /**
+   * @brief Runs `main` with arguments given as command-line strings.
+   *
+   * @throws std::runtime_error
+   *   On a missing `main`, bad arguments, or any runtime error (division by
+   *   zero, out-of-bounds or freed memory access, leaked memory, guard or
+   *   commit outside speculation).
+   */
+  void run_main(const std::vector<std::string> &args);
+
+  /// Number of instructions executed so far, as reported by `brili -p`.
+  uint64_t instruction_count() const { return icount; }
+
+  /// Start counting calls from each function to each other function.
+  void profile_calls() { call_profile_enabled = true; }
+
+  /**
+   * @brief Writes the call counts gathered so far as JSON.
+   *
+   * An array of `{"caller", "callee", "count"}` objects, one per pair of
+   * functions with at least one call between them; the inliner reads it.
+   */
+  void write_call_profile(std::ostream &os) const;
+
+private:
+  // One `alloc`ed region; pointers name it by index
+  struct Allocation {
+    std::vector<Value> cells;
+    bool live = true;
+  };
+
+  const Program &program;
+  std::ostream &out;
+  std::vector<Allocation> heap;
+  uint64_t live_allocations = 0;
+  uint64_t icount = 0;
+  bool call_profile_enabled = false;
+
+  // Calls per (caller index << 32 | callee index)
+  std::unordered_map<uint64_t, uint64_t> call_counts;
+
+  Value call(const Function &fn, std::vector<Value> &regs);
+  Value &cell(const Value &ptr);
+  void print(const Function &fn, const Op &op, const std::vector<Value> &regs);
+};
+
+} // namespace interp
+
+#endif // INTERPRETER_HPP
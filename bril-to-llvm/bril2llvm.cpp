@@ -0,0 +1,581 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Bril ops that lower to a single LLVM binary instruction on two loaded operands
+// (div is lowered separately: a bare sdiv is undefined for a zero divisor)
+const std::unordered_map<std::string, std::string> BINARY_OPS = {
+    {"add", "add i64"}, {"sub", "sub i64"}, {"mul", "mul i64"},
+    {"eq", "icmp eq i64"}, {"lt", "icmp slt i64"}, {"gt", "icmp sgt i64"},
+    {"le", "icmp sle i64"}, {"ge", "icmp sge i64"},
+    {"and", "and i1"}, {"or", "or i1"},
+    {"fadd", "fadd double"}, {"fsub", "fsub double"}, {"fmul", "fmul double"}, {"fdiv", "fdiv double"},
+    {"feq", "fcmp oeq double"}, {"flt", "fcmp olt double"}, {"fgt", "fcmp ogt double"},
+    {"fle", "fcmp ole double"}, {"fge", "fcmp oge double"},
+    {"ceq", "icmp eq i32"}, {"clt", "icmp ult i32"}, {"cgt", "icmp ugt i32"},
+    {"cle", "icmp ule i32"}, {"cge", "icmp uge i32"}};
+
+// Declarations of the helpers in runtime.c
+const char *RUNTIME_DECLS =
+    "declare void @bril_print_int(i64)\n"
+    "declare void @bril_print_bool(i1 zeroext)\n"
+    "declare void @bril_print_float(double)\n"
+    "declare void @bril_print_char(i32)\n"
+    "declare void @bril_print_ptr(ptr)\n"
+    "declare void @bril_print_sep()\n"
+    "declare void @bril_print_end()\n"
+    "declare ptr @bril_alloc(i64, i64)\n"
+    "declare void @bril_free(ptr)\n"
+    "declare void @bril_check_argc(i32, i32)\n"
+    "declare void @bril_div_by_zero() noreturn\n"
+    "declare void @bril_guard_failed() noreturn\n"
+    "declare i64 @bril_arg_int(ptr, i32)\n"
+    "declare zeroext i1 @bril_arg_bool(ptr, i32)\n"
+    "declare double @bril_arg_float(ptr, i32)\n"
+    "declare i32 @bril_arg_char(ptr, i32)\n";
+
+/**
+ * @brief Maps a Bril type to its LLVM type: int → i64, bool → i1,
+ * float → double, char → i32 (a code point) and every pointer → ptr.
+ */
+std::string llvm_type(const json &type)
+{
+  if (type.is_object())
+  {
+    return "ptr";
+  }
+  std::string name = type.get<std::string>();
+  if (name == "int")   return "i64";
+  if (name == "bool")  return "i1";
+  if (name == "float") return "double";
+  if (name == "char")  return "i32";
+  throw std::runtime_error("unknown type '" + name + "'");
+}
+
+// The Bril type a `ptr<T>` points to
+const json &pointee(const json &type)
+{
+  if (!type.is_object() || !type.contains("ptr"))
+  {
+    throw std::runtime_error("expected a pointer type, got " + type.dump());
+  }
+  return type["ptr"];
+}
+
+// Size in bytes of one element of type `type`, for alloc
+unsigned type_size(const json &type)
+{
+  std::string t = llvm_type(type);
+  return t == "i1" ? 1 : t == "i32" ? 4 : 8;
+}
+
+// Decode the first UTF-8 code point of a string
+uint32_t decode_char(const std::string &s)
+{
+  if (s.empty())
+  {
+    throw std::runtime_error("empty char constant");
+  }
+  unsigned char c0 = s[0];
+  if (c0 < 0x80)
+  {
+    return c0;
+  }
+  int extra = c0 >= 0xF0 ? 3 : c0 >= 0xE0 ? 2 : 1;
+  uint32_t cp = c0 & (0x3F >> extra);
+  for (int k = 1; k <= extra && k < static_cast<int>(s.size()); k++)
+  {
+    cp = (cp << 6) | (static_cast<unsigned char>(s[k]) & 0x3F);
+  }
+  return cp;
+}
+
+// LLVM spelling of a Bril constant of the given type
+std::string constant(const json &value, const json &type)
+{
+  std::string t = llvm_type(type);
+  if (t == "i1")
+  {
+    return value.get<bool>() ? "true" : "false";
+  }
+  if (t == "double")
+  {
+    // Hex is the only exact spelling LLVM accepts for every double
+    double d = value.get<double>();
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof bits);
+    char buf[32];
+    std::snprintf(buf, sizeof buf, "0x%016llX", static_cast<unsigned long long>(bits));
+    return buf;
+  }
+  if (t == "i32")
+  {
+    return std::to_string(decode_char(value.get<std::string>()));
+  }
+  if (t == "ptr")
+  {
+    throw std::runtime_error("pointer constants are not supported");
+  }
+  return std::to_string(value.get<int64_t>());
+}
+
+// Quoted LLVM identifiers, so any Bril name is legal
+std::string slot(const std::string &var) { return "%\"" + var + ".addr\""; }
+std::string shadow(const std::string &var) { return "%\"" + var + ".spec\""; }
+std::string block(const std::string &label) { return "%\"" + label + "\""; }
+std::string global(const std::string &func) { return func == "main" ? "@__bril_main" : "@\"" + func + "\""; }
+
+/**
+ * @brief Lowers one Bril function to an LLVM function definition.
+ *
+ * Every variable gets an alloca in the entry block and every use or
+ * definition is a load or store, the way clang -O0 lowers locals; running
+ * `opt -opaque-pointers -passes=mem2reg` afterwards produces SSA (the IR
+ * uses opaque `ptr`, which LLVM 14 only accepts with that flag).  A fresh
+ * block is opened after any terminator that is not followed by a label, and
+ * a fall-through into a label becomes an explicit branch.
+ *
+ * Speculation is lowered with one shadow alloca per variable: `speculate`
+ * copies the variables into their shadows, a failing `guard` copies them
+ * back and branches to its label, and `commit` is a no-op.  Nested
+ * speculation is rejected.  A guard outside `speculate`/`commit` has
+ * nothing to roll back to, so failing it is a runtime error, as in brili.
+ */
+class FunctionLowering {
+public:
+  FunctionLowering(const json &func, const std::unordered_map<std::string, json> &signatures)
+      : func(func), signatures(signatures)
+  {
+  }
+
+  std::string lower()
+  {
+    collect_variables();
+
+    std::string ret = func.contains("type") ? llvm_type(func["type"]) : "void";
+    out << "define " << ret << " " << global(func["name"].get<std::string>()) << "(";
+    if (func.contains("args"))
+    {
+      for (size_t k = 0; k < func["args"].size(); k++)
+      {
+        const json &arg = func["args"][k];
+        out << (k ? ", " : "") << llvm_type(arg["type"]) << " %\"" << arg["name"].get<std::string>() << "\"";
+      }
+    }
+    out << ") {\n.entry:\n";
+
+    for (const std::string &var : order)
+    {
+      out << "  " << slot(var) << " = alloca " << llvm_type(types[var]) << "\n";
+      if (speculates)
+      {
+        out << "  " << shadow(var) << " = alloca " << llvm_type(types[var]) << "\n";
+      }
+    }
+    if (func.contains("args"))
+    {
+      for (const auto &arg : func["args"])
+      {
+        std::string name = arg["name"].get<std::string>();
+        out << "  store " << llvm_type(arg["type"]) << " %\"" << name << "\", ptr " << slot(name) << "\n";
+      }
+    }
+
+    if (func.contains("instrs"))
+    {
+      for (const auto &instr : func["instrs"])
+      {
+        if (instr.contains("label"))
+        {
+          start_block(instr["label"].get<std::string>());
+        }
+        else
+        {
+          if (terminated)
+          {
+            start_block(fresh(".dead"));
+          }
+          lower_instr(instr);
+        }
+      }
+    }
+
+    // Falling off the end returns; brili rejects that in a value-returning function, so just return zero
+    if (!terminated)
+    {
+      if (ret == "void")
+      {
+        out << "  ret void\n";
+      }
+      else
+      {
+        out << "  ret " << ret << " " << (ret == "ptr" ? "null" : ret == "double" ? "0.0" : ret == "i1" ? "false" : "0") << "\n";
+      }
+    }
+    out << "}\n";
+    return out.str();
+  }
+
+private:
+  const json &func;
+  const std::unordered_map<std::string, json> &signatures;
+  std::ostringstream out;
+
+  std::unordered_map<std::string, json> types;
+  std::vector<std::string> order;
+  bool speculates = false;
+  bool speculating = false;
+  bool terminated = false;
+  unsigned next_tmp = 0;
+
+  void collect_variables()
+  {
+    auto add = [&](const std::string &name, const json &type) {
+      if (types.emplace(name, type).second)
+      {
+        order.push_back(name);
+      }
+    };
+    if (func.contains("args"))
+    {
+      for (const auto &arg : func["args"])
+      {
+        add(arg["name"].get<std::string>(), arg["type"]);
+      }
+    }
+    if (func.contains("instrs"))
+    {
+      for (const auto &instr : func["instrs"])
+      {
+        if (instr.contains("dest") && instr.contains("type"))
+        {
+          add(instr["dest"].get<std::string>(), instr["type"]);
+        }
+        if (instr.contains("op") && instr["op"] == "speculate")
+        {
+          speculates = true;
+        }
+      }
+    }
+  }
+
+  std::string fresh(const std::string &prefix) { return prefix + "." + std::to_string(next_tmp++); }
+
+  void start_block(const std::string &label)
+  {
+    if (!terminated)
+    {
+      out << "  br label " << block(label) << "\n";
+    }
+    out << "\"" << label << "\":\n";
+    terminated = false;
+  }
+
+  const json &type_of(const std::string &var)
+  {
+    auto it = types.find(var);
+    if (it == types.end())
+    {
+      throw std::runtime_error("use of undefined variable '" + var + "'");
+    }
+    return it->second;
+  }
+
+  std::string load(const std::string &var)
+  {
+    std::string tmp = "%" + fresh(".t");
+    out << "  " << tmp << " = load " << llvm_type(type_of(var)) << ", ptr " << slot(var) << "\n";
+    return tmp;
+  }
+
+  void store(const std::string &var, const std::string &value)
+  {
+    out << "  store " << llvm_type(type_of(var)) << " " << value << ", ptr " << slot(var) << "\n";
+  }
+
+  // Copy every variable from one set of allocas to the other
+  void copy_all(std::string (*from)(const std::string &), std::string (*to)(const std::string &))
+  {
+    for (const std::string &var : order)
+    {
+      std::string t = llvm_type(types[var]);
+      std::string tmp = "%" + fresh(".t");
+      out << "  " << tmp << " = load " << t << ", ptr " << from(var) << "\n";
+      out << "  store " << t << " " << tmp << ", ptr " << to(var) << "\n";
+    }
+  }
+
+  void lower_instr(const json &instr)
+  {
+    std::string op = instr["op"].get<std::string>();
+    std::vector<std::string> args = instr.contains("args") ? instr["args"].get<std::vector<std::string>>()
+                                                           : std::vector<std::string>{};
+    std::string dest = instr.contains("dest") ? instr["dest"].get<std::string>() : "";
+    auto binary = BINARY_OPS.find(op);
+
+    if (op == "const")
+    {
+      store(dest, constant(instr["value"], instr["type"]));
+    }
+    else if (op == "id")
+    {
+      store(dest, load(args.at(0)));
+    }
+    else if (binary != BINARY_OPS.end())
+    {
+      std::string lhs = load(args.at(0)), rhs = load(args.at(1));
+      std::string tmp = "%" + fresh(".t");
+      out << "  " << tmp << " = " << binary->second << " " << lhs << ", " << rhs << "\n";
+      store(dest, tmp);
+    }
+    else if (op == "div")
+    {
+      // Division by zero is an error, as in brili; INT64_MIN / -1 wraps instead of trapping
+      std::string lhs = load(args.at(0)), rhs = load(args.at(1));
+      std::string zero = "%" + fresh(".t"), ok = fresh(".div.ok"), fail = fresh(".div.zero");
+      out << "  " << zero << " = icmp eq i64 " << rhs << ", 0\n";
+      out << "  br i1 " << zero << ", label " << block(fail) << ", label " << block(ok) << "\n";
+      out << "\"" << fail << "\":\n";
+      out << "  call void @bril_div_by_zero()\n  unreachable\n";
+      out << "\"" << ok << "\":\n";
+      std::string minus_one = "%" + fresh(".t"), divisor = "%" + fresh(".t"), quotient = "%" + fresh(".t");
+      std::string negated = "%" + fresh(".t"), tmp = "%" + fresh(".t");
+      out << "  " << minus_one << " = icmp eq i64 " << rhs << ", -1\n";
+      out << "  " << divisor << " = select i1 " << minus_one << ", i64 1, i64 " << rhs << "\n";
+      out << "  " << quotient << " = sdiv i64 " << lhs << ", " << divisor << "\n";
+      out << "  " << negated << " = sub i64 0, " << lhs << "\n";
+      out << "  " << tmp << " = select i1 " << minus_one << ", i64 " << negated << ", i64 " << quotient << "\n";
+      store(dest, tmp);
+    }
+    else if (op == "not")
+    {
+      std::string value = load(args.at(0));
+      std::string tmp = "%" + fresh(".t");
+      out << "  " << tmp << " = xor i1 " << value << ", true\n";
+      store(dest, tmp);
+    }
+    else if (op == "char2int" || op == "int2char")
+    {
+      std::string value = load(args.at(0));
+      std::string tmp = "%" + fresh(".t");
+      out << "  " << tmp << " = " << (op == "char2int" ? "zext i32 " : "trunc i64 ") << value
+          << (op == "char2int" ? " to i64\n" : " to i32\n");
+      store(dest, tmp);
+    }
+    else if (op == "alloc")
+    {
+      std::string count = load(args.at(0));
+      std::string tmp = "%" + fresh(".t");
+      out << "  " << tmp << " = call ptr @bril_alloc(i64 " << count << ", i64 " << type_size(pointee(instr["type"])) << ")\n";
+      store(dest, tmp);
+    }
+    else if (op == "free")
+    {
+      std::string ptr = load(args.at(0));
+      out << "  call void @bril_free(ptr " << ptr << ")\n";
+    }
+    else if (op == "store")
+    {
+      std::string ptr = load(args.at(0)), value = load(args.at(1));
+      out << "  store " << llvm_type(type_of(args.at(1))) << " " << value << ", ptr " << ptr << "\n";
+    }
+    else if (op == "load")
+    {
+      std::string ptr = load(args.at(0));
+      std::string tmp = "%" + fresh(".t");
+      out << "  " << tmp << " = load " << llvm_type(instr["type"]) << ", ptr " << ptr << "\n";
+      store(dest, tmp);
+    }
+    else if (op == "ptradd")
+    {
+      std::string ptr = load(args.at(0)), offset = load(args.at(1));
+      std::string tmp = "%" + fresh(".t");
+      out << "  " << tmp << " = getelementptr " << llvm_type(pointee(instr["type"])) << ", ptr " << ptr
+          << ", i64 " << offset << "\n";
+      store(dest, tmp);
+    }
+    else if (op == "call")
+    {
+      std::string callee = instr["funcs"].at(0).get<std::string>();
+      auto sig = signatures.find(callee);
+      if (sig == signatures.end())
+      {
+        throw std::runtime_error("call to unknown function @" + callee);
+      }
+      std::vector<std::string> values;
+      for (const auto &a : args)
+      {
+        values.push_back(llvm_type(type_of(a)) + " " + load(a));
+      }
+      std::string ret = sig->second.contains("type") ? llvm_type(sig->second["type"]) : "void";
+      std::string tmp = ret == "void" ? "" : "%" + fresh(".t");
+      out << "  " << (tmp.empty() ? "" : tmp + " = ") << "call " << ret << " " << global(callee) << "(";
+      for (size_t k = 0; k < values.size(); k++)
+      {
+        out << (k ? ", " : "") << values[k];
+      }
+      out << ")\n";
+      if (!dest.empty() && !tmp.empty())
+      {
+        store(dest, tmp);
+      }
+    }
+    else if (op == "print")
+    {
+      for (size_t k = 0; k < args.size(); k++)
+      {
+        if (k)
+        {
+          out << "  call void @bril_print_sep()\n";
+        }
+        std::string t = llvm_type(type_of(args[k]));
+        std::string fn = t == "i64" ? "int" : t == "i1" ? "bool" : t == "double" ? "float" : t == "i32" ? "char" : "ptr";
+        std::string value = load(args[k]);
+        out << "  call void @bril_print_" << fn << "(" << (t == "i1" ? "i1 zeroext" : t) << " " << value << ")\n";
+      }
+      out << "  call void @bril_print_end()\n";
+    }
+    else if (op == "jmp")
+    {
+      out << "  br label " << block(instr["labels"].at(0).get<std::string>()) << "\n";
+      terminated = true;
+    }
+    else if (op == "br")
+    {
+      std::string cond = load(args.at(0));
+      out << "  br i1 " << cond << ", label " << block(instr["labels"].at(0).get<std::string>())
+          << ", label " << block(instr["labels"].at(1).get<std::string>()) << "\n";
+      terminated = true;
+    }
+    else if (op == "ret")
+    {
+      if (args.empty())
+      {
+        out << "  ret void\n";
+      }
+      else
+      {
+        std::string value = load(args[0]);
+        out << "  ret " << llvm_type(type_of(args[0])) << " " << value << "\n";
+      }
+      terminated = true;
+    }
+    else if (op == "speculate")
+    {
+      if (speculating)
+      {
+        throw std::runtime_error("nested speculation is not supported");
+      }
+      speculating = true;
+      copy_all(slot, shadow);
+    }
+    else if (op == "commit")
+    {
+      speculating = false;
+    }
+    else if (op == "guard")
+    {
+      std::string ok = fresh(".guard.ok"), abort = fresh(".guard.abort");
+      std::string cond = load(args.at(0));
+      out << "  br i1 " << cond << ", label " << block(ok) << ", label " << block(abort) << "\n";
+      out << "\"" << abort << "\":\n";
+      if (speculating)
+      {
+        copy_all(shadow, slot);
+        out << "  br label " << block(instr["labels"].at(0).get<std::string>()) << "\n";
+      }
+      else
+      {
+        // The shadows only exist (and hold anything) inside speculation
+        out << "  call void @bril_guard_failed()\n  unreachable\n";
+      }
+      out << "\"" << ok << "\":\n";
+    }
+    else if (op != "nop")
+    {
+      throw std::runtime_error("unknown opcode '" + op + "'");
+    }
+  }
+};
+
+/**
+ * @brief Emits the C entry point: parses argv into `@main`'s Bril
+ * arguments and calls it.
+ */
+std::string lower_entry(const json &main_func)
+{
+  std::ostringstream out;
+  const json args = main_func.contains("args") ? main_func["args"] : json::array();
+  out << "define i32 @main(i32 %argc, ptr %argv) {\n";
+  out << "  call void @bril_check_argc(i32 %argc, i32 " << args.size() << ")\n";
+  std::vector<std::string> values;
+  for (size_t k = 0; k < args.size(); k++)
+  {
+    std::string t = llvm_type(args[k]["type"]);
+    std::string fn = t == "i64" ? "int" : t == "i1" ? "bool" : t == "double" ? "float" : t == "i32" ? "char" : "";
+    if (fn.empty())
+    {
+      throw std::runtime_error("main cannot take pointer arguments");
+    }
+    out << "  %a" << k << " = call " << (t == "i1" ? "zeroext i1" : t) << " @bril_arg_" << fn << "(ptr %argv, i32 " << k + 1 << ")\n";
+    values.push_back(t + " %a" + std::to_string(k));
+  }
+  std::string ret = main_func.contains("type") ? llvm_type(main_func["type"]) : "void";
+  out << "  " << (ret == "void" ? "" : "%r = ") << "call " << ret << " @__bril_main(";
+  for (size_t k = 0; k < values.size(); k++)
+  {
+    out << (k ? ", " : "") << values[k];
+  }
+  out << ")\n  ret i32 0\n}\n";
+  return out.str();
+}
+
+int main()
+{
+  // Read JSON input
+  json program;
+  std::cin >> program;
+
+  // Check if "functions" exists and is an array
+  if (!program.contains("functions") || !program["functions"].is_array())
+  {
+    std::cerr << "Error: Expected a 'functions' key with an array of functions.\n";
+    return 1;
+  }
+
+  std::unordered_map<std::string, json> signatures;
+  for (const auto &func : program["functions"])
+  {
+    signatures[func["name"].get<std::string>()] = func;
+  }
+
+  try
+  {
+    std::cout << "; Lowered from Bril by bril2llvm\n\n" << RUNTIME_DECLS;
+    for (const auto &func : program["functions"])
+    {
+      std::cout << "\n" << FunctionLowering(func, signatures).lower();
+    }
+    if (signatures.count("main"))
+    {
+      std::cout << "\n" << lower_entry(signatures["main"]);
+    }
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "error: " << e.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Runtime support for programs lowered by bril2llvm.
+ *
+ * Output matches brili: values on one line separated by spaces, booleans as
+ * true/false, floats with 17 decimal places and chars as UTF-8.
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void bril_error(const char *message)
+{
+  fflush(stdout);
+  fprintf(stderr, "error: %s\n", message);
+  exit(2);
+}
+
+void bril_print_int(int64_t value) { printf("%lld", (long long)value); }
+
+void bril_print_bool(bool value) { fputs(value ? "true" : "false", stdout); }
+
+void bril_print_float(double value)
+{
+  if (isnan(value))
+    fputs("NaN", stdout);
+  else if (isinf(value))
+    fputs(value > 0 ? "Infinity" : "-Infinity", stdout);
+  else
+    printf("%.17f", value);
+}
+
+void bril_print_char(uint32_t cp)
+{
+  if (cp < 0x80)
+    putchar((int)cp);
+  else if (cp < 0x800)
+  {
+    putchar(0xC0 | (cp >> 6));
+    putchar(0x80 | (cp & 0x3F));
+  }
+  else if (cp < 0x10000)
+  {
+    putchar(0xE0 | (cp >> 12));
+    putchar(0x80 | ((cp >> 6) & 0x3F));
+    putchar(0x80 | (cp & 0x3F));
+  }
+  else
+  {
+    putchar(0xF0 | (cp >> 18));
+    putchar(0x80 | ((cp >> 12) & 0x3F));
+    putchar(0x80 | ((cp >> 6) & 0x3F));
+    putchar(0x80 | (cp & 0x3F));
+  }
+}
+
+void bril_print_ptr(void *ptr) { printf("%p", ptr); }
+
+void bril_print_sep(void) { putchar(' '); }
+
+void bril_print_end(void) { putchar('\n'); }
+
+void *bril_alloc(int64_t count, int64_t size)
+{
+  if (count <= 0)
+    bril_error("cannot allocate a non-positive number of entries");
+  void *ptr = calloc((size_t)count, (size_t)size);
+  if (!ptr)
+    bril_error("out of memory");
+  return ptr;
+}
+
+void bril_free(void *ptr) { free(ptr); }
+
+void bril_check_argc(int argc, int expected)
+{
+  if (argc - 1 != expected)
+    bril_error("wrong number of arguments to main");
+}
+
+void bril_div_by_zero(void) { bril_error("division by zero"); }
+
+void bril_guard_failed(void) { bril_error("guard failed in non-speculative state"); }
+
+int64_t bril_arg_int(char **argv, int index) { return strtoll(argv[index], NULL, 10); }
+
+bool bril_arg_bool(char **argv, int index)
+{
+  if (strcmp(argv[index], "true") == 0)
+    return true;
+  if (strcmp(argv[index], "false") == 0)
+    return false;
+  bril_error("boolean arguments must be true or false");
+  return false;
+}
+
+double bril_arg_float(char **argv, int index) { return strtod(argv[index], NULL); }
+
+// Decodes an argument that must be exactly one UTF-8 encoded code point
+uint32_t bril_arg_char(char **argv, int index)
+{
+  const unsigned char *s = (const unsigned char *)argv[index];
+  if (s[0] == 0 || (s[0] >= 0x80 && s[0] < 0xC0) || s[0] >= 0xF8)
+    bril_error("char arguments must be a single character");
+  int extra = s[0] < 0x80 ? 0 : s[0] >= 0xF0 ? 3 : s[0] >= 0xE0 ? 2 : 1;
+  uint32_t cp = extra ? s[0] & (0x3F >> extra) : s[0];
+  for (int k = 1; k <= extra; k++)
+  {
+    // Stops at the terminating NUL too, which is not a continuation byte
+    if ((s[k] & 0xC0) != 0x80)
+      bril_error("char arguments must be a single character");
+    cp = (cp << 6) | (s[k] & 0x3F);
+  }
+  if (s[extra + 1] != 0)
+    bril_error("char arguments must be a single character");
+  return cp;
+}
@@ -0,0 +1,259 @@
+"""
+Generates synthetic programs with large, controllable CFGs, as Bril JSON or
+LLVM IR, for scaling benchmarks of the CFG and dominator code.
+
+Each function is built from nested single-entry single-exit regions until
+its block budget is spent: straight-line sequences, if/else diamonds, while
+loops (nested up to --depth), switches with --fanout cases (a chain of
+compares in Bril, which has no switch), and --irreducible two-entry cycles.
+Every loop and cycle advances a counter towards the argument n, so the
+programs also run to completion.
+
+Usage: python3 gen_cfg.py --blocks 1000 --depth 3 --irreducible 2 \
+           --fanout 8 --functions 4 --format llvm -o big.ll
+"""
+import argparse
+import json
+import random
+import sys
+
+
+class Block:
+    def __init__(self, name):
+        self.name = name
+        # Terminator: ("jmp", target) | ("br", t, f) | ("switch", [targets]) | ("ret",)
+        self.term = None
+        # Loop counter to zero ("init", k) or bump ("step", k) in this block, if any
+        self.counter = None
+
+
+class Function:
+    def __init__(self, name, args):
+        self.name = name
+        self.blocks = []
+        self.loops = 0
+        self.irreducible = args.irreducible
+        self.args = args
+
+    def block(self):
+        b = Block(f"b{len(self.blocks)}")
+        self.blocks.append(b)
+        return b
+
+    def region(self, budget, depth, rng):
+        """Builds a region of about `budget` blocks; returns its entry and exit blocks.
+        The exit block's terminator is left for the caller to set."""
+        if budget <= 1:
+            b = self.block()
+            return b, b
+
+        kinds = ["seq", "seq", "if"]
+        if depth < self.args.depth and budget >= 5:
+            kinds += ["loop"] * 3
+        if self.args.fanout >= 2 and budget >= self.args.fanout + 2:
+            kinds.append("switch")
+        if self.irreducible > 0 and budget >= 4:
+            kinds += ["irreducible"] * 2
+        kind = rng.choice(kinds)
+
+        if kind == "seq":
+            first = rng.randint(1, budget - 1)
+            e1, x1 = self.region(first, depth, rng)
+            e2, x2 = self.region(budget - first, depth, rng)
+            x1.term = ("jmp", e2)
+            return e1, x2
+
+        if kind == "if":
+            head = self.block()
+            rest = budget - 2
+            left = rng.randint(0, rest) if rest > 1 else rest
+            te, tx = self.region(max(left, 1), depth, rng)
+            fe, fx = self.region(max(rest - left, 1), depth, rng)
+            join = self.block()
+            head.term = ("br", te, fe)
+            tx.term = ("jmp", join)
+            fx.term = ("jmp", join)
+            return head, join
+
+        if kind == "loop":
+            k = self.loops
+            self.loops += 1
+            pre, header = self.block(), self.block()
+            pre.counter = ("init", k)
+            be, bx = self.region(budget - 4, depth + 1, rng)
+            latch, done = self.block(), self.block()
+            latch.counter = ("step", k)
+            header.counter = ("test", k)
+            pre.term = ("jmp", header)
+            header.term = ("br", be, done)
+            bx.term = ("jmp", latch)
+            latch.term = ("jmp", header)
+            return pre, done
+
+        if kind == "switch":
+            head = self.block()
+            cases = []
+            each = max((budget - 2) // self.args.fanout, 1)
+            for _ in range(self.args.fanout):
+                cases.append(self.region(each, depth, rng))
+            join = self.block()
+            head.term = ("switch", [e for e, _ in cases])
+            for _, x in cases:
+                x.term = ("jmp", join)
+            return head, join
+
+        # Two blocks that each enter the other: a cycle with two entries, which no
+        # natural-loop analysis accepts
+        self.irreducible -= 1
+        head, x, y, done = self.block(), self.block(), self.block(), self.block()
+        head.term = ("br", x, y)
+        x.term = ("br", y, done)
+        y.term = ("br", x, done)
+        return head, done
+
+
+def build(name, args, rng):
+    f = Function(name, args)
+    entry, exit_ = f.region(args.blocks, 0, rng)
+    exit_.term = ("ret",)
+    # Keep the region entry first so it is the function's entry block
+    f.blocks.remove(entry)
+    f.blocks.insert(0, entry)
+    return f
+
+
+def to_bril(functions, fanout):
+    def instr(op, dest=None, typ=None, args=None, labels=None, **extra):
+        i = {"op": op}
+        if dest is not None:
+            i["dest"], i["type"] = dest, typ
+        if args:
+            i["args"] = args
+        if labels:
+            i["labels"] = labels
+        i.update(extra)
+        return i
+
+    out = []
+    for f in functions:
+        instrs = [instr("const", "one", "int", value=1), instr("const", "v", "int", value=0)]
+        for b in f.blocks:
+            instrs.append({"label": b.name})
+            instrs.append(instr("add", "v", "int", ["v", "one"]))
+            kind, k = b.counter or (None, None)
+            if kind == "init":
+                instrs.append(instr("const", f"i{k}", "int", value=0))
+            elif kind == "step":
+                instrs.append(instr("add", f"i{k}", "int", [f"i{k}", "one"]))
+            t = b.term
+            if t[0] == "jmp":
+                instrs.append(instr("jmp", labels=[t[1].name]))
+            elif t[0] == "br":
+                var = f"i{k}" if kind == "test" else "v"
+                instrs.append(instr("lt", "c", "bool", [var, "n"]))
+                instrs.append(instr("br", args=["c"], labels=[t[1].name, t[2].name]))
+            elif t[0] == "switch":
+                # s = v mod fanout, then one compare per case
+                instrs.append(instr("const", "k", "int", value=fanout))
+                instrs.append(instr("div", "s", "int", ["v", "k"]))
+                instrs.append(instr("mul", "s", "int", ["s", "k"]))
+                instrs.append(instr("sub", "s", "int", ["v", "s"]))
+                for case, target in enumerate(t[1][:-1]):
+                    nxt = f"{b.name}.case{case + 1}"
+                    instrs.append(instr("const", "k", "int", value=case))
+                    instrs.append(instr("eq", "c", "bool", ["s", "k"]))
+                    instrs.append(instr("br", args=["c"], labels=[target.name, nxt]))
+                    instrs.append({"label": nxt})
+                instrs.append(instr("jmp", labels=[t[1][-1].name]))
+            else:
+                instrs.append(instr("ret", args=["v"]))
+        out.append({"name": f.name, "args": [{"name": "n", "type": "int"}], "type": "int", "instrs": instrs})
+
+    # main runs every function once and prints what it returns
+    main = [instr("const", "n", "int", value=10)]
+    for f in functions:
+        main.append(instr("call", "r", "int", ["n"], funcs=[f.name]))
+        main.append(instr("print", args=["r"]))
+    out.append({"name": "main", "instrs": main})
+    return json.dumps({"functions": out}, indent=1)
+
+
+def to_llvm(functions, fanout):
+    lines = []
+    for f in functions:
+        lines.append(f"define i64 @{f.name}(i64 %n) {{")
+        lines.append("alloca:")
+        lines.append("  %v = alloca i64")
+        for k in range(f.loops):
+            lines.append(f"  %i{k} = alloca i64")
+        lines.append("  store i64 0, i64* %v")
+        lines.append(f"  br label %{f.blocks[0].name}")
+        tmp = 0
+        for b in f.blocks:
+            lines.append(f"{b.name}:")
+            lines.append(f"  %t{tmp} = load i64, i64* %v")
+            lines.append(f"  %t{tmp + 1} = add i64 %t{tmp}, 1")
+            lines.append(f"  store i64 %t{tmp + 1}, i64* %v")
+            v = f"%t{tmp + 1}"
+            tmp += 2
+            kind, k = b.counter or (None, None)
+            if kind == "init":
+                lines.append(f"  store i64 0, i64* %i{k}")
+            elif kind in ("step", "test"):
+                lines.append(f"  %t{tmp} = load i64, i64* %i{k}")
+                if kind == "step":
+                    lines.append(f"  %t{tmp + 1} = add i64 %t{tmp}, 1")
+                    lines.append(f"  store i64 %t{tmp + 1}, i64* %i{k}")
+                else:
+                    v = f"%t{tmp}"
+                tmp += 2
+            t = b.term
+            if t[0] == "jmp":
+                lines.append(f"  br label %{t[1].name}")
+            elif t[0] == "br":
+                lines.append(f"  %t{tmp} = icmp slt i64 {v}, %n")
+                lines.append(f"  br i1 %t{tmp}, label %{t[1].name}, label %{t[2].name}")
+                tmp += 1
+            elif t[0] == "switch":
+                lines.append(f"  %t{tmp} = urem i64 {v}, {fanout}")
+                cases = " ".join(f"i64 {c}, label %{e.name}" for c, e in enumerate(t[1]) if c)
+                lines.append(f"  switch i64 %t{tmp}, label %{t[1][0].name} [ {cases} ]")
+                tmp += 1
+            else:
+                lines.append(f"  ret i64 {v}")
+        lines.append("}")
+        lines.append("")
+
+    lines.append("define i32 @main() {")
+    lines.append("entry:")
+    for i, f in enumerate(functions):
+        lines.append(f"  %r{i} = call i64 @{f.name}(i64 10)")
+    lines.append("  ret i32 0")
+    lines.append("}")
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--blocks", type=int, default=100, help="blocks per function (approximate)")
+    parser.add_argument("--depth", type=int, default=2, help="deepest loop nesting")
+    parser.add_argument("--irreducible", type=int, default=0, help="irreducible cycles per function")
+    parser.add_argument("--fanout", type=int, default=0, help="cases per switch, 0 for no switches")
+    parser.add_argument("--functions", type=int, default=1, help="functions in the program")
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--format", choices=["bril", "llvm"], default="bril")
+    parser.add_argument("-o", "--output", help="output file (default stdout)")
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    functions = [build(f"f{i}", args, rng) for i in range(args.functions)]
+    text = to_bril(functions, args.fanout) if args.format == "bril" else to_llvm(functions, args.fanout)
+    if args.output:
+        with open(args.output, "w") as out:
+            out.write(text)
+    else:
+        sys.stdout.write(text)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,142 @@
+"""
+Scaling benchmark for the CFG and dominator analyses: generates programs of
+growing size with gen_cfg.py, runs every analysis on each, and records wall
+time and peak memory (max RSS of the analysis process).
+
+Each analysis is a shell command with {input} standing for the generated
+file, in either Bril JSON or LLVM IR.  The LLVM ones are built in when
+--plugin (the global-analysis SkeletonPass.so) is given; Bril tools are
+added with --analysis, e.g.
+
+  python3 scaling.py --plugin ../global-analysis/build/skeleton/SkeletonPass.so \
+      --analysis 'bril-dom:bril:../dominance-tree/dom < {input}' \
+      --sizes 100,400,1600,6400 --depth 3 --irreducible 2 --fanout 8
+
+An analysis that exceeds --timeout at one size is not run at larger ones.
+Results go to a CSV file, a table on stdout, and, when matplotlib is
+installed, time and memory plots against block count.
+"""
+import argparse
+import csv
+import os
+import shutil
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def measure(command, timeout):
+    """Runs command in a shell; returns (status, seconds, max RSS in KiB)."""
+    start = time.monotonic()
+    proc = subprocess.Popen(command, shell=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL,
+                            start_new_session=True)
+    while True:
+        pid, status, usage = os.wait4(proc.pid, os.WNOHANG)
+        elapsed = time.monotonic() - start
+        if pid:
+            proc.returncode = status
+            ok = os.WIFEXITED(status) and os.WEXITSTATUS(status) == 0
+            return ("ok" if ok else "failed"), elapsed, usage.ru_maxrss
+        if elapsed > timeout:
+            os.killpg(proc.pid, signal.SIGKILL)
+            os.wait4(proc.pid, 0)
+            return "timeout", elapsed, 0
+        time.sleep(0.002)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--sizes", default="100,200,400,800,1600,3200", help="blocks per function, comma separated")
+    parser.add_argument("--depth", type=int, default=2)
+    parser.add_argument("--irreducible", type=int, default=0)
+    parser.add_argument("--fanout", type=int, default=0)
+    parser.add_argument("--functions", type=int, default=1)
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--plugin", help="global-analysis SkeletonPass.so, enables the LLVM analyses")
+    parser.add_argument("--opt", default=os.environ.get("OPT", "opt"))
+    parser.add_argument("--analysis", action="append", default=[], metavar="NAME:FORMAT:COMMAND",
+                        help="extra analysis; FORMAT is bril or llvm, COMMAND uses {input}")
+    parser.add_argument("--timeout", type=float, default=60.0, help="seconds before an analysis is given up on")
+    parser.add_argument("--csv", default="scaling.csv")
+    parser.add_argument("--plot", default="scaling", help="prefix of the plot files")
+    parser.add_argument("--keep", help="keep the generated programs in this directory")
+    args = parser.parse_args()
+
+    analyses = []
+    if args.plugin:
+        load = f"{args.opt} -load-pass-plugin {args.plugin} -disable-output"
+        analyses += [
+            ("llvm-parse", "llvm", f"{args.opt} -passes=verify -disable-output {{input}}"),
+            ("llvm-dom", "llvm", f"{args.opt} -passes='require<domtree>,require<domfrontier>' -disable-output {{input}}"),
+            ("llvm-postdom", "llvm", f"{args.opt} -passes='require<postdomtree>' -disable-output {{input}}"),
+            ("my-dom", "llvm", f"{load} -passes='require<my-dom>' {{input}}"),
+            ("my-postdom", "llvm", f"{load} -passes='require<my-postdom>' {{input}}"),
+        ]
+    for spec in args.analysis:
+        name, fmt, command = spec.split(":", 2)
+        analyses.append((name, fmt, command))
+    if not analyses:
+        parser.error("nothing to run: give --plugin and/or --analysis")
+
+    workdir = args.keep or tempfile.mkdtemp(prefix="cfg-scaling-")
+    os.makedirs(workdir, exist_ok=True)
+    given_up = set()
+    rows = []
+    try:
+        for size in [int(s) for s in args.sizes.split(",")]:
+            inputs = {}
+            for fmt in {fmt for _, fmt, _ in analyses}:
+                path = os.path.join(workdir, f"cfg{size}.{'json' if fmt == 'bril' else 'll'}")
+                subprocess.run([sys.executable, os.path.join(HERE, "gen_cfg.py"), "--blocks", str(size),
+                                "--depth", str(args.depth), "--irreducible", str(args.irreducible),
+                                "--fanout", str(args.fanout), "--functions", str(args.functions),
+                                "--seed", str(args.seed), "--format", fmt, "-o", path], check=True)
+                inputs[fmt] = path
+            for name, fmt, command in analyses:
+                if name in given_up:
+                    continue
+                status, seconds, rss = measure(command.format(input=inputs[fmt]), args.timeout)
+                if status == "timeout":
+                    given_up.add(name)
+                rows.append({"analysis": name, "blocks": size, "seconds": f"{seconds:.4f}", "max_rss_kb": rss,
+                             "status": status})
+                print(f"{name:<16} {size:>8} blocks  {seconds:>9.3f} s  {rss / 1024:>9.1f} MiB  {status}", flush=True)
+    finally:
+        if not args.keep:
+            shutil.rmtree(workdir)
+
+    with open(args.csv, "w", newline="") as out:
+        writer = csv.DictWriter(out, fieldnames=["analysis", "blocks", "seconds", "max_rss_kb", "status"])
+        writer.writeheader()
+        writer.writerows(rows)
+
+    try:
+        import matplotlib
+        matplotlib.use("Agg")
+        import matplotlib.pyplot as plt
+    except ImportError:
+        print(f"results in {args.csv} (install matplotlib for plots)")
+        return
+
+    for metric, label, scale in [("seconds", "time (s)", 1), ("max_rss_kb", "peak memory (MiB)", 1 / 1024)]:
+        fig, ax = plt.subplots()
+        for name, _, _ in analyses:
+            points = [(r["blocks"], float(r[metric]) * scale) for r in rows
+                      if r["analysis"] == name and r["status"] == "ok"]
+            if points:
+                ax.plot(*zip(*points), marker="o", label=name)
+        ax.set_xscale("log")
+        ax.set_yscale("log")
+        ax.set_xlabel("blocks per function")
+        ax.set_ylabel(label)
+        ax.legend()
+        fig.savefig(f"{args.plot}-{'time' if metric == 'seconds' else 'memory'}.png", dpi=120)
+    print(f"results in {args.csv}, plots in {args.plot}-time.png and {args.plot}-memory.png")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,115 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+/**
+ * @brief A monotonic bump allocator for per-function analysis state.
+ *
+ * Hand it to `std::pmr` containers; allocations are carved out of large
+ * chunks and never freed one by one.  `reset()` drops everything at once and
+ * keeps the memory for the next function, so a tool that reuses one arena
+ * across functions stops calling malloc once the first few are done.
+ * (`std::pmr::monotonic_buffer_resource::release` hands its chunks back
+ * instead, which is the traffic this is meant to avoid.)
+ */
+class Arena : public std::pmr::memory_resource {
+public:
+  explicit Arena(size_t first_chunk = 4096) : next_chunk(first_chunk) {}
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  ~Arena()
+  {
+    for (const Chunk &chunk : chunks)
+    {
+      std::free(chunk.start);
+    }
+  }
+
+  /**
+   * @brief Frees everything allocated so far, in one go.
+   *
+   * Containers still using the arena must not be touched afterwards.  If
+   * the last function needed more than one chunk, the chunks are merged into
+   * one that big, so the next function of the same size fits in it.
+   */
+  void reset()
+  {
+    if (chunks.size() > 1)
+    {
+      size_t total = 0;
+      for (const Chunk &chunk : chunks)
+      {
+        total += chunk.size;
+        std::free(chunk.start);
+      }
+      chunks.clear();
+      add_chunk(total);
+    }
+    if (!chunks.empty())
+    {
+      cursor = chunks.front().start;
+      limit = cursor + chunks.front().size;
+    }
+    used = 0;
+  }
+
+  /// Bytes handed out since the last reset.
+  size_t bytes_used() const { return used; }
+
+private:
+  struct Chunk {
+    char *start;
+    size_t size;
+  };
+
+  void *do_allocate(size_t bytes, size_t alignment) override
+  {
+    char *p = align(cursor, alignment);
+    if (!cursor || p + bytes > limit)
+    {
+      // Chunks double in size, so a function needs O(log size) of them
+      add_chunk(std::max(bytes + alignment, next_chunk));
+      next_chunk *= 2;
+      p = align(cursor, alignment);
+    }
+    cursor = p + bytes;
+    used += bytes;
+    return p;
+  }
+
+  void do_deallocate(void *, size_t, size_t) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+  static char *align(char *p, size_t alignment)
+  {
+    return reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(p) + alignment - 1) & ~(uintptr_t(alignment) - 1));
+  }
+
+  void add_chunk(size_t size)
+  {
+    char *start = static_cast<char *>(std::malloc(size));
+    if (!start)
+    {
+      throw std::bad_alloc();
+    }
+    chunks.push_back({start, size});
+    cursor = start;
+    limit = start + size;
+  }
+
+  std::vector<Chunk> chunks;
+  char *cursor = nullptr;
+  char *limit = nullptr;
+  size_t next_chunk;
+  size_t used = 0;
+};
+
+#endif // ARENA_H
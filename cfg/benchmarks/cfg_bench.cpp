@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../arena.h"
+#include "../block_graph.h"
+#include "../form_blocks.h"
+#include "../form_cfg.h"
+#include "../../dominance-tree/dominance_utilities.h"
+#include "../../dominance-tree/dominator_tree.h"
+
+using json = nlohmann::json;
+
+/*
+ * Microbenchmarks for every stage of the CFG code and for the dominator
+ * computations built on it.
+ *
+ * Usage: cfg_bench [--min-time SECONDS] [--blocks N] [program.json ...]
+ *
+ * Each stage runs over every function of every program, repeatedly, until
+ * --min-time has passed.  Only the stage itself is timed and counted; the
+ * copies of its inputs it consumes are made outside the measurement (stages
+ * that take their instructions by value get a fresh copy moved in).  Without
+ * programs, a built-in function of --blocks if/else diamonds is used
+ * (cfg-scaling/gen_cfg.py makes bigger and more varied ones).
+ *
+ * Reported per stage: time per pass over the input, throughput in Bril
+ * instructions per second, and heap allocations and bytes per instruction.
+ * The index-form stages share one arena, reset after every function the way
+ * a tool would, so its chunks are counted once and then reused.
+ */
+
+namespace {
+
+// Heap traffic while a measurement is running
+bool counting = false;
+size_t allocations = 0;
+size_t allocated_bytes = 0;
+
+void *allocate(size_t size)
+{
+  if (counting)
+  {
+    allocations++;
+    allocated_bytes += size;
+  }
+  if (void *p = std::malloc(size ? size : 1))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+/// Result of one stage: a row of the report.
+struct Measurement {
+  std::string name;
+  double seconds_per_pass;
+  double instrs_per_second;
+  double allocs_per_instr;
+  double bytes_per_instr;
+};
+
+/**
+ * @brief Times a stage over all functions until min_time has passed.
+ *
+ * @param setup Makes a fresh input for function i, untimed.
+ * @param run Runs the stage on that input, timed.
+ */
+template <typename Input>
+Measurement measure(const std::string &name, size_t functions, size_t instrs, double min_time,
+                    const std::function<Input(size_t)> &setup, const std::function<void(Input &)> &run)
+{
+  using clock = std::chrono::steady_clock;
+  clock::duration timed{};
+  size_t passes = 0;
+  allocations = allocated_bytes = 0;
+
+  while (passes == 0 || std::chrono::duration<double>(timed).count() < min_time)
+  {
+    for (size_t f = 0; f < functions; f++)
+    {
+      Input input = setup(f);
+      counting = true;
+      auto start = clock::now();
+      run(input);
+      timed += clock::now() - start;
+      counting = false;
+    }
+    passes++;
+  }
+
+  double seconds = std::chrono::duration<double>(timed).count();
+  double total = double(instrs) * passes;
+  return {name, seconds / passes, total / seconds, allocations / total, allocated_bytes / total};
+}
+
+/// A function of `blocks` if/else diamonds in a row, for when no program is given.
+json diamonds(unsigned blocks)
+{
+  json instrs = json::array();
+  instrs.push_back({{"op", "const"}, {"dest", "v"}, {"type", "int"}, {"value", 0}});
+  instrs.push_back({{"op", "const"}, {"dest", "one"}, {"type", "int"}, {"value", 1}});
+  for (unsigned d = 0; d * 4 < blocks; d++)
+  {
+    std::string n = std::to_string(d);
+    instrs.push_back({{"op", "lt"}, {"dest", "c"}, {"type", "bool"}, {"args", {"v", "one"}}});
+    instrs.push_back({{"op", "br"}, {"args", {"c"}}, {"labels", {"then" + n, "else" + n}}});
+    instrs.push_back({{"label", "then" + n}});
+    instrs.push_back({{"op", "add"}, {"dest", "v"}, {"type", "int"}, {"args", {"v", "one"}}});
+    instrs.push_back({{"op", "jmp"}, {"labels", {"join" + n}}});
+    instrs.push_back({{"label", "else" + n}});
+    instrs.push_back({{"op", "sub"}, {"dest", "v"}, {"type", "int"}, {"args", {"v", "one"}}});
+    instrs.push_back({{"label", "join" + n}});
+  }
+  instrs.push_back({{"op", "ret"}, {"args", {"v"}}});
+  return {{"functions", {{{"name", "main"}, {"instrs", instrs}}}}};
+}
+
+} // namespace
+
+void *operator new(size_t size) { return allocate(size); }
+void *operator new[](size_t size) { return allocate(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+int main(int argc, char **argv)
+{
+  double min_time = 0.5;
+  unsigned blocks = 1000;
+  std::vector<json> programs;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (arg == "--min-time" && i + 1 < argc)
+    {
+      min_time = std::stod(argv[++i]);
+    }
+    else if (arg == "--blocks" && i + 1 < argc)
+    {
+      blocks = std::stoul(argv[++i]);
+    }
+    else
+    {
+      std::ifstream in(arg);
+      if (!in)
+      {
+        std::cerr << "cfg_bench: cannot open " << arg << "\n";
+        return 1;
+      }
+      programs.push_back(json::parse(in));
+    }
+  }
+  if (programs.empty())
+  {
+    programs.push_back(diamonds(blocks));
+  }
+
+  // Every function's instructions, and the output of each stage, as inputs to the next
+  using block_map_t = std::pair<std::unordered_map<std::string, std::vector<json>>, std::vector<std::string>>;
+  std::vector<std::vector<json>> funcs;
+  std::vector<std::vector<std::vector<json>>> blocks_of;
+  std::vector<block_map_t> maps, terminated;
+  std::vector<BlockGraph> graphs;
+  size_t instrs = 0;
+  for (const json &program : programs)
+  {
+    for (const json &func : program["functions"])
+    {
+      funcs.push_back(func["instrs"].get<std::vector<json>>());
+      instrs += funcs.back().size();
+      blocks_of.push_back(form_blocks(funcs.back()));
+      auto copy = blocks_of.back();
+      maps.push_back(form_block_map(copy));
+      terminated.push_back(add_terminators(maps.back()));
+      graphs.push_back(form_block_graph(funcs.back()));
+    }
+  }
+  size_t n = funcs.size();
+  std::cout << n << " functions, " << instrs << " instructions\n\n";
+
+  Arena arena;
+  std::vector<Measurement> rows;
+  rows.push_back(measure<std::vector<json>>(
+      "form_blocks", n, instrs, min_time, [&](size_t f) { return funcs[f]; },
+      [](auto &func) { form_blocks(std::move(func)); }));
+  rows.push_back(measure<std::vector<std::vector<json>>>(
+      "form_block_map", n, instrs, min_time, [&](size_t f) { return blocks_of[f]; },
+      [](auto &b) { form_block_map(b); }));
+  rows.push_back(measure<block_map_t>(
+      "add_terminators", n, instrs, min_time, [&](size_t f) { return maps[f]; },
+      [](auto &m) { add_terminators(m); }));
+  rows.push_back(measure<block_map_t *>(
+      "edges", n, instrs, min_time, [&](size_t f) { return &terminated[f]; },
+      [](auto &m) { edges(*m); }));
+  rows.push_back(measure<std::vector<json>>(
+      "find_dominators", n, instrs, min_time, [&](size_t f) { return funcs[f]; },
+      [](auto &func) { find_dominators(std::move(func)); }));
+  rows.push_back(measure<int>(
+      "form_block_graph", n, instrs, min_time, [](size_t) { return 0; },
+      [&, f = size_t(0)](int &) mutable {
+        form_block_graph(funcs[f++ % n], &arena);
+        arena.reset();
+      }));
+  rows.push_back(measure<int>(
+      "compute_dominators", n, instrs, min_time, [](size_t) { return 0; },
+      [&, f = size_t(0)](int &) mutable {
+        compute_dominators(graphs[f++ % n], &arena);
+        arena.reset();
+      }));
+  rows.push_back(measure<int>(
+      "compute_post_dominators", n, instrs, min_time, [](size_t) { return 0; },
+      [&, f = size_t(0)](int &) mutable {
+        compute_post_dominators(graphs[f++ % n], &arena);
+        arena.reset();
+      }));
+
+  std::printf("%-24s %14s %14s %14s %14s\n", "stage", "time/pass", "instrs/s", "allocs/instr", "bytes/instr");
+  for (const Measurement &m : rows)
+  {
+    std::printf("%-24s %12.3fms %14.3g %14.2f %14.1f\n", m.name.c_str(), m.seconds_per_pass * 1e3,
+                m.instrs_per_second, m.allocs_per_instr, m.bytes_per_instr);
+  }
+  return 0;
+}
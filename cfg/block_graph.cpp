@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <memory_resource>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "form_blocks.h"
+#include "form_cfg.h"
+#include "block_graph.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+// True if the instruction ends a basic block
+bool is_terminator(const json &instr)
+{
+  return instr.contains("op") &&
+         (instr["op"] == "jmp" || instr["op"] == "br" || instr["op"] == "ret");
+}
+
+} // namespace
+
+unsigned BlockGraph::add_block(const std::string &prefix, unsigned before)
+{
+  // Pick a name that does not clash with an existing block
+  std::string name = generate_new_name(prefix);
+  while (indices.count(name))
+  {
+    name = generate_new_name(prefix);
+  }
+
+  unsigned idx = names.size();
+  names.push_back(name);
+  indices[name] = idx;
+  blocks.emplace_back();
+  preds.emplace_back();
+  succs.emplace_back();
+  explicit_label.push_back(false);
+  implicit_terminator.push_back(false);
+
+  auto pos = layout.end();
+  if (before != NONE)
+  {
+    pos = std::find(layout.begin(), layout.end(), before);
+  }
+  layout.insert(pos, idx);
+
+  return idx;
+}
+
+void BlockGraph::recompute_edges()
+{
+  preds.assign(size(), {});
+  succs.assign(size(), {});
+
+  for (unsigned idx = 0; idx < size(); idx++)
+  {
+    // Every block ends in a terminator, so its successors are the terminator's labels
+    for (const std::string &succ_name : get_successors(blocks[idx].back()))
+    {
+      auto it = indices.find(succ_name);
+      if (it == indices.end())
+      {
+        throw std::runtime_error("Branch to unknown label '" + succ_name + "'.");
+      }
+      succs[idx].push_back(it->second);
+      preds[it->second].push_back(idx);
+    }
+  }
+}
+
+BlockGraph form_block_graph(const std::vector<json> &func, Arena *scratch)
+{
+  BlockGraph graph;
+  Arena local;
+  std::pmr::memory_resource *mem = scratch ? scratch : &local;
+
+  // Split and name the blocks with the same stages form_blocks and form_block_map use
+  std::vector<BlockSpan> spans = block_spans(func);
+  if (spans.empty())
+  {
+    return graph;
+  }
+  std::vector<const std::string *> labels;
+  labels.reserve(spans.size());
+  for (const BlockSpan &span : spans)
+  {
+    const json &head = func[span.first];
+    labels.push_back(head.contains("label") ? &head["label"].get_ref<const std::string &>() : nullptr);
+  }
+  std::vector<std::string> names = name_blocks(labels);
+  std::pmr::unordered_set<std::string_view> taken(names.begin(), names.end(), 0, mem);
+
+  // Put an unlabeled entry in front if anything branches back to the first block, so the entry has no preds
+  bool needs_entry = false;
+  for (const json &instr : func)
+  {
+    if (instr.contains("labels"))
+    {
+      for (const auto &label : instr["labels"])
+      {
+        needs_entry = needs_entry || label == names.front();
+      }
+    }
+  }
+  unsigned N = spans.size() + needs_entry;
+  graph.names.reserve(N);
+  graph.blocks.reserve(N);
+  if (needs_entry)
+  {
+    std::string entry_name = generate_new_name("entry");
+    while (taken.count(entry_name))
+    {
+      entry_name = generate_new_name("entry");
+    }
+    graph.names.push_back(std::move(entry_name));
+    graph.blocks.push_back({json{{"op", "jmp"}, {"labels", json::array({names.front()})}}});
+    graph.explicit_label.push_back(false);
+    graph.implicit_terminator.push_back(true);
+  }
+
+  // Copy each block's instructions over once, without its label, and make fall-through explicit
+  for (size_t b = 0; b < spans.size(); b++)
+  {
+    bool labeled = labels[b] != nullptr;
+    std::vector<json> block(func.begin() + spans[b].first + labeled, func.begin() + spans[b].last);
+    bool terminated = !block.empty() && is_terminator(block.back());
+    if (!terminated && b + 1 < spans.size())
+    {
+      block.push_back(json{{"op", "jmp"}, {"labels", json::array({names[b + 1]})}});
+    }
+    else if (!terminated)
+    {
+      block.push_back(json{{"op", "ret"}, {"args", json::array()}});
+    }
+    graph.blocks.push_back(std::move(block));
+    graph.explicit_label.push_back(labeled);
+    graph.implicit_terminator.push_back(!terminated);
+  }
+  graph.names.insert(graph.names.end(), std::make_move_iterator(names.begin()), std::make_move_iterator(names.end()));
+
+  // Number the blocks in program order
+  for (unsigned idx = 0; idx < N; idx++)
+  {
+    graph.indices[graph.names[idx]] = idx;
+    graph.layout.push_back(idx);
+  }
+
+  graph.recompute_edges();
+
+  return graph;
+}
+
+std::vector<json> reassemble(const BlockGraph &graph)
+{
+  unsigned N = graph.size();
+  const std::vector<unsigned> &layout = graph.layout;
+
+  // Decide which synthesized terminators can be dropped because the fall-through still holds
+  std::vector<bool> drop_terminator(N, false);
+  for (size_t pos = 0; pos < layout.size(); pos++)
+  {
+    unsigned idx = layout[pos];
+    if (!graph.implicit_terminator[idx] || graph.blocks[idx].empty())
+    {
+      continue;
+    }
+    const json &term = graph.blocks[idx].back();
+    if (term["op"] == "jmp" && pos + 1 < layout.size() && term["labels"][0] == graph.names[layout[pos + 1]])
+    {
+      drop_terminator[idx] = true;
+    }
+    else if (term["op"] == "ret" && pos + 1 == layout.size())
+    {
+      drop_terminator[idx] = true;
+    }
+  }
+
+  // Collect every label that a remaining instruction still refers to
+  std::unordered_set<std::string> referenced;
+  for (unsigned idx : layout)
+  {
+    const std::vector<json> &block = graph.blocks[idx];
+    size_t count = drop_terminator[idx] ? block.size() - 1 : block.size();
+    for (size_t i = 0; i < count; i++)
+    {
+      if (block[i].contains("labels"))
+      {
+        for (const auto &label : block[i]["labels"])
+        {
+          referenced.insert(label.get<std::string>());
+        }
+      }
+    }
+  }
+
+  std::vector<json> instrs;
+  for (unsigned idx : layout)
+  {
+    if (graph.explicit_label[idx] || referenced.count(graph.names[idx]))
+    {
+      instrs.push_back(json{{"label", graph.names[idx]}});
+    }
+    const std::vector<json> &block = graph.blocks[idx];
+    size_t count = drop_terminator[idx] ? block.size() - 1 : block.size();
+    instrs.insert(instrs.end(), block.begin(), block.begin() + count);
+  }
+
+  return instrs;
+}
+
+std::vector<unsigned> reverse_postorder(const BlockGraph &graph)
+{
+  std::vector<unsigned> order;
+  if (graph.size() == 0)
+  {
+    return order;
+  }
+
+  // Iterative DFS so deep CFGs cannot overflow the stack; each frame is (block, next successor)
+  std::vector<bool> visited(graph.size(), false);
+  std::vector<std::pair<unsigned, size_t>> stack;
+  stack.push_back({0, 0});
+  visited[0] = true;
+
+  while (!stack.empty())
+  {
+    auto &[block, next] = stack.back();
+    if (next < graph.succs[block].size())
+    {
+      unsigned succ = graph.succs[block][next++];
+      if (!visited[succ])
+      {
+        visited[succ] = true;
+        stack.push_back({succ, 0});
+      }
+    }
+    else
+    {
+      order.push_back(block);
+      stack.pop_back();
+    }
+  }
+
+  // Postorder reversed is reverse postorder
+  return std::vector<unsigned>(order.rbegin(), order.rend());
+}
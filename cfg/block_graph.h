@@ -0,0 +1,105 @@
+#ifndef BLOCK_GRAPH_H
+#define BLOCK_GRAPH_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "arena.h"
+
+using json = nlohmann::json;
+
+/**
+ * @brief A Bril function's CFG in compact index form.
+ *
+ * Blocks are numbered 0..N-1 in program order and every edge is stored as
+ * a block index, so analyses can keep their facts in plain vectors instead
+ * of string-keyed maps.  Block 0 is always the entry and never has
+ * predecessors; every block ends in an explicit terminator.
+ */
+struct BlockGraph {
+  /// Block names in program order.  `names[i]` is the name of block i.
+  std::vector<std::string> names;
+
+  /// Maps a block name back to its index.
+  std::unordered_map<std::string, unsigned> indices;
+
+  /// Instructions of each block, without the leading label.
+  std::vector<std::vector<json>> blocks;
+
+  /// Predecessor and successor block indices of each block.
+  std::vector<std::vector<unsigned>> preds;
+  std::vector<std::vector<unsigned>> succs;
+
+  /// Order in which `reassemble` emits the blocks.  Starts out as program
+  /// order; blocks added later can be slotted in anywhere without
+  /// renumbering the existing ones.
+  std::vector<unsigned> layout;
+
+  /// True if the block's label appeared in the source and must be emitted
+  /// even if nothing branches to it.
+  std::vector<bool> explicit_label;
+
+  /// True if the block's terminator was synthesized to make a fall-through
+  /// explicit.  `reassemble` drops it again when the fall-through still holds.
+  std::vector<bool> implicit_terminator;
+
+  /// Number of blocks in the graph.
+  unsigned size() const { return names.size(); }
+
+  /// Sentinel for "no block".
+  static constexpr unsigned NONE = ~0u;
+
+  /**
+   * @brief Adds a new, empty block with a fresh name starting with `prefix`.
+   *
+   * The block gets the next free index and is placed in the layout right
+   * before block `before` (or at the end for `NONE`).  Edges are not
+   * touched; call `recompute_edges` once the new block and its neighbours
+   * have their final terminators.
+   *
+   * @return The index of the new block.
+   */
+  unsigned add_block(const std::string& prefix, unsigned before = NONE);
+
+  /**
+   * @brief Rebuilds `preds` and `succs` from the blocks' terminators.
+   *
+   * @throws std::runtime_error if a terminator names an unknown label.
+   */
+  void recompute_edges();
+};
+
+/**
+ * @brief Builds the index-form CFG of a Bril function.
+ *
+ * Splits and names blocks with the same `block_spans` and `name_blocks`
+ * stages as the `form_blocks` → `form_block_map` → `add_terminators` →
+ * `edges` pipeline, numbered in program order, but copies each instruction
+ * only once.  If anything branches back to the first block, a fresh entry
+ * block is put in front so the entry has no predecessors.
+ *
+ * @param func The function's instruction list (`func["instrs"]`).
+ * @param scratch Arena for the intermediate state, if the caller keeps one
+ *                per function; otherwise a temporary one is used.
+ * @return The CFG.  An empty function produces an empty graph.
+ */
+BlockGraph form_block_graph(const std::vector<json>& func, Arena* scratch = nullptr);
+
+/**
+ * @brief Flattens a CFG back into an instruction list.
+ *
+ * Blocks are emitted in `layout` order.  Labels are only emitted for blocks
+ * with `explicit_label` set or that some instruction still branches to, and
+ * synthesized terminators are dropped when they just fall through to the
+ * next block (or return from the last one), so an unmodified graph
+ * round-trips to the original instructions.
+ */
+std::vector<json> reassemble(const BlockGraph& graph);
+
+/**
+ * @brief Returns the blocks reachable from the entry in reverse postorder.
+ */
+std::vector<unsigned> reverse_postorder(const BlockGraph& graph);
+
+#endif // BLOCK_GRAPH_H
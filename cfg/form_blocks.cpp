@@ -1,4 +1,5 @@
 #include <iostream>
+#include <iterator>
 #include <unordered_map>
 #include <list>
 #include <vector>
@@ -7,52 +8,65 @@
 
 using json = nlohmann::json;
 
-std::vector<std::vector<json>> form_blocks(std::vector<json> func)
+std::vector<BlockSpan> block_spans(const std::vector<json>& func)
 {
-  // Initialize the list of blocks
-  std::vector<std::vector<json>> blocks;
+  std::vector<BlockSpan> spans;
 
-  // Start with an empty block and add instructions to it
-  std::vector<json> block;
+  // Start of the block being built, if one is open
+  size_t first = 0;
+  bool open = false;
 
   // Loop through all the instructions in this function
-  for (auto instr : func)
+  for (size_t i = 0; i < func.size(); i++)
   {
 
-    // If it is an instruction, just add it to the block
-    if (instr.contains("op"))
+    // If it is an instruction, it joins the open block (or opens one)
+    if (func[i].contains("op"))
     {
-      block.push_back(instr);
+      if (!open)
+      {
+        first = i;
+        open = true;
+      }
 
       // If this instruction changes the control flow, end current block
-      if (instr["op"] == "jmp" || instr["op"] == "br" || instr["op"] == "ret")
+      if (func[i]["op"] == "jmp" || func[i]["op"] == "br" || func[i]["op"] == "ret")
       {
-
-        blocks.push_back(block);
-
-        // Start a new block
-        block.clear();
+        spans.push_back({first, i + 1});
+        open = false;
       }
     }
     // If it is not an instruction, it must be a label, so it must begin its own block
     else
     {
-      if (!block.empty()) {
-        blocks.push_back(block);
-    }
-
-      // Start a new block
-      block.clear();
-
-      // Append the label to the top of the block
-      block.push_back(instr);
+      if (open)
+      {
+        spans.push_back({first, i});
+      }
+      first = i;
+      open = true;
     }
   }
 
   // Add final block if needed
-  if (!(block.empty()))
+  if (open)
+  {
+    spans.push_back({first, func.size()});
+  }
+
+  return spans;
+}
+
+std::vector<std::vector<json>> form_blocks(std::vector<json> func)
+{
+  // Initialize the list of blocks
+  std::vector<std::vector<json>> blocks;
+
+  // Move each block's instructions out of the (by-value) function
+  for (const BlockSpan &span : block_spans(func))
   {
-    blocks.push_back(block);
+    blocks.emplace_back(std::make_move_iterator(func.begin() + span.first),
+                        std::make_move_iterator(func.begin() + span.last));
   }
 
   return blocks;
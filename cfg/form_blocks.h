@@ -9,6 +9,14 @@
 
 using json = nlohmann::json;
 
+// A basic block as a [first, last) range of a function's instructions, label included
+struct BlockSpan {
+  size_t first, last;
+};
+
+// Function to find where a function splits into basic blocks, without copying it
+std::vector<BlockSpan> block_spans(const std::vector<json>& func);
+
 // Function to form basic blocks from a function
 std::vector<std::vector<json>> form_blocks(std::vector<json> func);
 
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <unordered_map>
 #include <list>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
 #include <nlohmann/json.hpp>
 #include "form_blocks.h"
@@ -22,6 +24,42 @@ std::string generate_new_name(const std::string &prefix)
   return name;
 }
 
+std::vector<std::string> name_blocks(const std::vector<const std::string *> &labels)
+{
+  // Collect the source labels first, so a generated name never takes one of them
+  std::unordered_set<std::string_view> taken;
+  for (const std::string *label : labels)
+  {
+    if (label)
+    {
+      taken.insert(*label);
+    }
+  }
+
+  std::vector<std::string> names;
+  names.reserve(labels.size());
+  for (const std::string *label : labels)
+  {
+    // A labeled block is named after its label
+    if (label)
+    {
+      names.push_back(*label);
+      continue;
+    }
+
+    // Otherwise give it a unique name
+    std::string name = generate_new_name("b");
+    while (taken.count(name))
+    {
+      name = generate_new_name("b");
+    }
+    names.push_back(std::move(name));
+    taken.insert(names.back());
+  }
+
+  return names;
+}
+
 std::pair<std::unordered_map<std::string, std::vector<json>>, std::vector<std::string>>
 form_block_map(std::vector<std::vector<json>> &blocks)
 {
@@ -30,32 +68,32 @@ form_block_map(std::vector<std::vector<json>> &blocks)
   std::unordered_map<std::string, std::vector<json>> block_map;
   std::vector<std::string> block_insertion_order;
 
-  // Iterate through the blocks
-  for (auto &block : blocks)
+  // Name every block before touching any of them
+  std::vector<const std::string *> labels;
+  labels.reserve(blocks.size());
+  for (const auto &block : blocks)
   {
+    bool labeled = !block.empty() && block[0].contains("label");
+    labels.push_back(labeled ? &block[0]["label"].get_ref<const std::string &>() : nullptr);
+  }
+  std::vector<std::string> names = name_blocks(labels);
 
-    // Initialize the name for this block
-    std::string name;
+  // Iterate through the blocks
+  for (size_t k = 0; k < blocks.size(); k++)
+  {
+    std::vector<json> &block = blocks[k];
 
-    // If this block starts with a label, use the label as the block name and remove the label
-    if (!block.empty() && block[0].contains("label"))
+    // If this block starts with a label, remove it since the name already carries it
+    if (labels[k])
     {
-      name = block[0]["label"];
-
-      // Remove the first instruction since it is just a label
       block.erase(block.begin());
     }
-    // If this block does not start with a label, give it a unique name
-    else
-    {
-      name = generate_new_name("b"); // idk what I should feeed into this
-    }
 
     // Store the block in the block map with its new name
-    block_map[name] = block;
+    block_map[names[k]] = block;
 
     // Insert its name (key) into the insertion order tracking vector
-    block_insertion_order.push_back(name);
+    block_insertion_order.push_back(names[k]);
   }
 
   return {block_map, block_insertion_order};
@@ -91,11 +129,12 @@ add_terminators(std::pair<std::unordered_map<std::string, std::vector<json>>, st
 {
 
   // Initialize counter to know where I am in the loop
-  int i = 0;
+  size_t i = 0;
 
-  // Loop through all basic blocks (access the first element of the pair passed in)
-  for (auto &[block_name, block] : ordered_block_map.first)
+  // Loop through all basic blocks in insertion order (the map itself is unordered, so use the order vector)
+  for (const auto &block_name : ordered_block_map.second)
   {
+    std::vector<json> &block = ordered_block_map.first[block_name];
 
     // Case 1: if the basic block is empty
     if (block.empty())
@@ -147,9 +186,18 @@ edges(std::pair<std::unordered_map<std::string, std::vector<json>>,
   std::unordered_map<std::string, std::vector<std::string>> predecessors;
   std::unordered_map<std::string, std::vector<std::string>> successors;
 
-  // Through through all the blocks
-  for (auto &[block_name, block] : ordered_block_map.first)
+  // Every block gets an entry, even if it has no predecessors or successors
+  for (const auto &block_name : ordered_block_map.second)
+  {
+    predecessors[block_name];
+    successors[block_name];
+  }
+
+  // Through through all the blocks in insertion order
+  for (const auto &block_name : ordered_block_map.second)
   {
+    const std::vector<json> &block = ordered_block_map.first[block_name];
+
     // Through through all the successors of the current block by checking successors of the last instr
     for (auto &succ : get_successors(block.back()))
     {
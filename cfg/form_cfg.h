@@ -13,6 +13,10 @@ using json = nlohmann::json;
 // Function to generate a unique block name
 std::string generate_new_name(const std::string& prefix);
 
+// Function to name blocks as form_block_map does: a block's label (nullptr if it has none),
+// or a fresh name that no label uses
+std::vector<std::string> name_blocks(const std::vector<const std::string*>& labels);
+
 // Function to map blocks with insertion order
 std::pair<std::unordered_map<std::string, std::vector<json>>, std::vector<std::string>> 
 form_block_map(std::vector<std::vector<json>>& blocks);
@@ -0,0 +1,133 @@
+#ifndef BIT_VECTOR_H
+#define BIT_VECTOR_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief A fixed-size set of bits packed into 64-bit words.
+ *
+ * Modeled on the parts of `llvm::BitVector` the LLVM passes in this repo
+ * use, so the Bril dataflow analyses can do their meets and transfers a
+ * word at a time instead of a bit at a time.
+ */
+class BitVector {
+public:
+  BitVector() = default;
+
+  /// Creates `size` bits, all set to `value`.
+  explicit BitVector(unsigned size, bool value = false)
+      : bits(size), words((size + 63) / 64, value ? ~uint64_t(0) : 0)
+  {
+    clear_unused_bits();
+  }
+
+  unsigned size() const { return bits; }
+
+  bool test(unsigned i) const { return (words[i / 64] >> (i % 64)) & 1; }
+  bool operator[](unsigned i) const { return test(i); }
+
+  void set(unsigned i) { words[i / 64] |= uint64_t(1) << (i % 64); }
+  void reset(unsigned i) { words[i / 64] &= ~(uint64_t(1) << (i % 64)); }
+
+  /// Sets or clears every bit.
+  void set()
+  {
+    for (uint64_t &w : words)
+    {
+      w = ~uint64_t(0);
+    }
+    clear_unused_bits();
+  }
+  void reset()
+  {
+    for (uint64_t &w : words)
+    {
+      w = 0;
+    }
+  }
+
+  /// Clears every bit that is set in `other` (set difference).
+  BitVector &reset(const BitVector &other)
+  {
+    for (size_t i = 0; i < words.size(); i++)
+    {
+      words[i] &= ~other.words[i];
+    }
+    return *this;
+  }
+
+  BitVector &operator&=(const BitVector &other)
+  {
+    for (size_t i = 0; i < words.size(); i++)
+    {
+      words[i] &= other.words[i];
+    }
+    return *this;
+  }
+
+  BitVector &operator|=(const BitVector &other)
+  {
+    for (size_t i = 0; i < words.size(); i++)
+    {
+      words[i] |= other.words[i];
+    }
+    return *this;
+  }
+
+  BitVector operator~() const
+  {
+    BitVector result(*this);
+    for (uint64_t &w : result.words)
+    {
+      w = ~w;
+    }
+    result.clear_unused_bits();
+    return result;
+  }
+
+  friend BitVector operator&(BitVector a, const BitVector &b) { return a &= b; }
+  friend BitVector operator|(BitVector a, const BitVector &b) { return a |= b; }
+
+  bool operator==(const BitVector &other) const { return bits == other.bits && words == other.words; }
+  bool operator!=(const BitVector &other) const { return !(*this == other); }
+
+  /// True if any bit is set.
+  bool any() const
+  {
+    for (uint64_t w : words)
+    {
+      if (w)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Number of set bits.
+  unsigned count() const
+  {
+    unsigned total = 0;
+    for (uint64_t w : words)
+    {
+      total += __builtin_popcountll(w);
+    }
+    return total;
+  }
+
+private:
+  unsigned bits = 0;
+  std::vector<uint64_t> words;
+
+  // Keep the bits past `size` in the last word zero so == and count() stay exact
+  void clear_unused_bits()
+  {
+    if (bits % 64 != 0)
+    {
+      words.back() &= (uint64_t(1) << (bits % 64)) - 1;
+    }
+  }
+};
+
+#endif // BIT_VECTOR_H
@@ -0,0 +1,118 @@
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../cfg/block_graph.h"
+#include "live_variables.h"
+
+using json = nlohmann::json;
+
+bool LiveVariables::is_live_in(unsigned block, const std::string &var) const
+{
+  auto it = var_ids.find(var);
+  return it != var_ids.end() && live_in[block][it->second];
+}
+
+LiveVariables compute_live_variables(const BlockGraph &graph)
+{
+  LiveVariables lv;
+  unsigned N = graph.size();
+
+  // Number the variables
+  for (const auto &block : graph.blocks)
+  {
+    for (const auto &instr : block)
+    {
+      if (instr.contains("dest"))
+      {
+        lv.var_ids.emplace(instr["dest"].get<std::string>(), lv.var_ids.size());
+      }
+      if (instr.contains("args"))
+      {
+        for (const auto &arg : instr["args"])
+        {
+          lv.var_ids.emplace(arg.get<std::string>(), lv.var_ids.size());
+        }
+      }
+    }
+  }
+  unsigned V = lv.var_ids.size();
+
+  // use = read before being written in the block, def = written in the block
+  std::vector<std::vector<bool>> use(N, std::vector<bool>(V, false));
+  std::vector<std::vector<bool>> def(N, std::vector<bool>(V, false));
+  for (unsigned block = 0; block < N; block++)
+  {
+    for (const auto &instr : graph.blocks[block])
+    {
+      if (instr.contains("args"))
+      {
+        for (const auto &arg : instr["args"])
+        {
+          unsigned v = lv.var_ids.at(arg.get<std::string>());
+          if (!def[block][v])
+          {
+            use[block][v] = true;
+          }
+        }
+      }
+      if (instr.contains("dest"))
+      {
+        def[block][lv.var_ids.at(instr["dest"].get<std::string>())] = true;
+      }
+    }
+  }
+
+  lv.live_in.assign(N, std::vector<bool>(V, false));
+  lv.live_out.assign(N, std::vector<bool>(V, false));
+
+  // Backward worklist, seeded in postorder
+  std::vector<unsigned> worklist = reverse_postorder(graph);
+  std::vector<bool> queued(N, false);
+  for (unsigned block : worklist)
+  {
+    queued[block] = true;
+  }
+
+  while (!worklist.empty())
+  {
+    unsigned block = worklist.back();
+    worklist.pop_back();
+    queued[block] = false;
+
+    // Out = union of the successors' ins
+    std::vector<bool> &out = lv.live_out[block];
+    for (unsigned succ : graph.succs[block])
+    {
+      for (unsigned v = 0; v < V; v++)
+      {
+        if (lv.live_in[succ][v])
+        {
+          out[v] = true;
+        }
+      }
+    }
+
+    // In = use ∪ (out − def)
+    std::vector<bool> in(V, false);
+    for (unsigned v = 0; v < V; v++)
+    {
+      in[v] = use[block][v] || (out[v] && !def[block][v]);
+    }
+
+    if (in != lv.live_in[block])
+    {
+      lv.live_in[block] = std::move(in);
+      for (unsigned pred : graph.preds[block])
+      {
+        if (!queued[pred])
+        {
+          queued[pred] = true;
+          worklist.push_back(pred);
+        }
+      }
+    }
+  }
+
+  return lv;
+}
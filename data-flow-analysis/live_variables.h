@@ -0,0 +1,32 @@
+#ifndef LIVE_VARIABLES_H
+#define LIVE_VARIABLES_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../cfg/block_graph.h"
+
+/**
+ * @brief Live variables of a Bril function, in index form.
+ *
+ * Every variable that is defined or read gets a dense id; the analysis
+ * records which variables are live at the top and bottom of each block.
+ */
+struct LiveVariables {
+  /// Dense id of each variable.
+  std::unordered_map<std::string, unsigned> var_ids;
+
+  /// For each block, bit `v` is set if variable `v` is live at its top/bottom.
+  std::vector<std::vector<bool>> live_in;
+  std::vector<std::vector<bool>> live_out;
+
+  /// True if `var` is live on entry to `block`.
+  bool is_live_in(unsigned block, const std::string& var) const;
+};
+
+/**
+ * @brief Runs the classic backward liveness analysis over a function's CFG.
+ */
+LiveVariables compute_live_variables(const BlockGraph& graph);
+
+#endif // LIVE_VARIABLES_H
@@ -0,0 +1,164 @@
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../cfg/block_graph.h"
+#include "reaching_definitions.h"
+
+using json = nlohmann::json;
+
+std::vector<unsigned> ReachingDefinitions::reaching(unsigned block, unsigned index, const std::string &var) const
+{
+  std::vector<unsigned> result;
+
+  auto it = defs_of_var.find(var);
+  if (it == defs_of_var.end())
+  {
+    return result;
+  }
+
+  // The last definition of var above the use in this block wins outright
+  for (unsigned i = index; i-- > 0;)
+  {
+    unsigned def = def_ids[block][i];
+    if (def != NONE && defs[def].var == var)
+    {
+      result.push_back(def);
+      return result;
+    }
+  }
+
+  // Otherwise every definition of var that reaches the top of the block
+  for (unsigned def : it->second)
+  {
+    if (reach_in[block][def])
+    {
+      result.push_back(def);
+    }
+  }
+
+  return result;
+}
+
+ReachingDefinitions compute_reaching_definitions(const BlockGraph &graph, const json &args)
+{
+  ReachingDefinitions rd;
+  unsigned N = graph.size();
+
+  // Number the function arguments first, then every instruction with a dest
+  if (args.is_array())
+  {
+    for (const auto &arg : args)
+    {
+      std::string name = arg["name"].get<std::string>();
+      rd.defs_of_var[name].push_back(rd.defs.size());
+      rd.defs.push_back({ReachingDefinitions::ARGUMENT, ReachingDefinitions::ARGUMENT, name});
+    }
+  }
+  unsigned num_args = rd.defs.size();
+
+  rd.def_ids.resize(N);
+  for (unsigned block = 0; block < N; block++)
+  {
+    const std::vector<json> &instrs = graph.blocks[block];
+    rd.def_ids[block].assign(instrs.size(), ReachingDefinitions::NONE);
+    for (unsigned i = 0; i < instrs.size(); i++)
+    {
+      if (instrs[i].contains("dest"))
+      {
+        std::string name = instrs[i]["dest"].get<std::string>();
+        rd.def_ids[block][i] = rd.defs.size();
+        rd.defs_of_var[name].push_back(rd.defs.size());
+        rd.defs.push_back({block, i, name});
+      }
+    }
+  }
+  unsigned D = rd.defs.size();
+
+  // gen = last definition of each variable in the block, kill = every definition of the variables it defines
+  std::vector<std::vector<bool>> gen(N, std::vector<bool>(D, false));
+  std::vector<std::vector<bool>> kill(N, std::vector<bool>(D, false));
+  for (unsigned block = 0; block < N; block++)
+  {
+    std::unordered_map<std::string, unsigned> last_def;
+    for (unsigned def : rd.def_ids[block])
+    {
+      if (def != ReachingDefinitions::NONE)
+      {
+        last_def[rd.defs[def].var] = def;
+      }
+    }
+    for (const auto &[var, def] : last_def)
+    {
+      gen[block][def] = true;
+      for (unsigned other : rd.defs_of_var[var])
+      {
+        kill[block][other] = true;
+      }
+    }
+  }
+
+  rd.reach_in.assign(N, std::vector<bool>(D, false));
+  rd.reach_out.assign(N, std::vector<bool>(D, false));
+  if (N == 0)
+  {
+    return rd;
+  }
+
+  // Arguments reach the top of the entry block
+  for (unsigned def = 0; def < num_args; def++)
+  {
+    rd.reach_in[0][def] = true;
+  }
+
+  // Forward worklist in reverse postorder
+  std::vector<unsigned> order = reverse_postorder(graph);
+  std::vector<unsigned> worklist(order.rbegin(), order.rend());
+  std::vector<bool> queued(N, false);
+  for (unsigned block : worklist)
+  {
+    queued[block] = true;
+  }
+
+  while (!worklist.empty())
+  {
+    unsigned block = worklist.back();
+    worklist.pop_back();
+    queued[block] = false;
+
+    // In = union of the predecessors' outs (plus the arguments for the entry)
+    std::vector<bool> &in = rd.reach_in[block];
+    for (unsigned pred : graph.preds[block])
+    {
+      for (unsigned d = 0; d < D; d++)
+      {
+        if (rd.reach_out[pred][d])
+        {
+          in[d] = true;
+        }
+      }
+    }
+
+    // Out = gen ∪ (in − kill)
+    std::vector<bool> out(D, false);
+    for (unsigned d = 0; d < D; d++)
+    {
+      out[d] = gen[block][d] || (in[d] && !kill[block][d]);
+    }
+
+    if (out != rd.reach_out[block])
+    {
+      rd.reach_out[block] = std::move(out);
+      for (unsigned succ : graph.succs[block])
+      {
+        if (!queued[succ])
+        {
+          queued[succ] = true;
+          worklist.push_back(succ);
+        }
+      }
+    }
+  }
+
+  return rd;
+}
@@ -0,0 +1,70 @@
+#ifndef REACHING_DEFINITIONS_H
+#define REACHING_DEFINITIONS_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../cfg/block_graph.h"
+
+using json = nlohmann::json;
+
+/**
+ * @brief Reaching definitions of a Bril function, in index form.
+ *
+ * Every instruction with a `dest`, and every function argument, is a
+ * definition with a dense id.  The analysis records which definitions reach
+ * the top and bottom of each block; `reaching` narrows that down to a single
+ * use inside a block.
+ */
+struct ReachingDefinitions {
+  /// One definition site.
+  struct Definition {
+    /// Block and position of the defining instruction.  Both are
+    /// `ARGUMENT` for a function argument.
+    unsigned block;
+    unsigned index;
+
+    /// The variable being defined.
+    std::string var;
+  };
+
+  /// Sentinel block/index of function-argument definitions.
+  static constexpr unsigned ARGUMENT = ~0u;
+
+  /// Sentinel stored in `def_ids` for instructions without a `dest`.
+  static constexpr unsigned NONE = ~0u;
+
+  /// All definitions, indexed by definition id.
+  std::vector<Definition> defs;
+
+  /// Definition ids of each variable.
+  std::unordered_map<std::string, std::vector<unsigned>> defs_of_var;
+
+  /// Definition ids of each instruction, parallel to the graph's blocks
+  /// (`NONE` where the instruction defines nothing).
+  std::vector<std::vector<unsigned>> def_ids;
+
+  /// For each block, bit `d` is set if definition `d` reaches its top/bottom.
+  std::vector<std::vector<bool>> reach_in;
+  std::vector<std::vector<bool>> reach_out;
+
+  /**
+   * @brief Returns the definitions of `var` that reach instruction `index` of `block`.
+   *
+   * Definitions earlier in the same block kill the ones flowing in from
+   * predecessors, so the result is exact for that program point.
+   */
+  std::vector<unsigned> reaching(unsigned block, unsigned index, const std::string& var) const;
+};
+
+/**
+ * @brief Runs reaching definitions over a function's CFG.
+ *
+ * @param graph The function's CFG.
+ * @param args  The function's `args` array (may be empty or null); each
+ *              argument is a definition that reaches the entry block.
+ */
+ReachingDefinitions compute_reaching_definitions(const BlockGraph& graph, const json& args);
+
+#endif // REACHING_DEFINITIONS_H
@@ -0,0 +1,274 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../analysis-cache/analysis_cache.h"
+#include "../cfg/block_graph.h"
+#include "../dominance-tree/dominator_tree.h"
+#include "../data-flow-analysis/reaching_definitions.h"
+
+using json = nlohmann::json;
+
+// Kind of the cached results; bump it whenever aggressive_dce's output changes
+const std::string CACHE_KIND = "adce-2";
+
+// Opcodes that are live no matter what; branches and jumps are only live if something depends on them
+const std::unordered_set<std::string> CRITICAL_OPS = {
+    "ret", "call", "print", "store", "alloc", "free",
+    "speculate", "commit", "guard"};
+
+/**
+ * @brief Aggressive dead code elimination.
+ *
+ * Starts from the opposite assumption to `dce`: nothing is live until proven
+ * otherwise.  Critical instructions are marked live; a live instruction
+ * makes the definitions reaching its arguments live, and a block containing
+ * a live instruction makes the branches it is control dependent on live.
+ * Everything left unmarked is deleted, and each dead branch is replaced by a
+ * jump to its nearest live post-dominator, so whole if/else diamonds whose
+ * results are unused disappear.  Blocks no longer reachable from the entry
+ * are dropped before the function is reassembled.
+ *
+ * Loops are kept: the terminator of every block with a retreating edge is
+ * treated as critical, so a loop that might not terminate is never removed.
+ *
+ * @param func Bril function object; its "instrs" are rewritten in place.
+ * @param scratch Arena for the CFG and post-dominator working state.
+ * @return True if the function changed.
+ */
+bool aggressive_dce(json &func, Arena &scratch)
+{
+  if (!func.contains("instrs"))
+  {
+    return false;
+  }
+
+  BlockGraph graph = form_block_graph(func["instrs"].get<std::vector<json>>(), &scratch);
+  unsigned N = graph.size();
+  if (N == 0)
+  {
+    return false;
+  }
+
+  DominatorTree pdom = compute_post_dominators(graph, &scratch);
+  ControlDependence cdg = compute_control_dependence(graph, pdom);
+  ReachingDefinitions rd = compute_reaching_definitions(graph, func.contains("args") ? func["args"] : json());
+
+  std::vector<std::vector<bool>> live(N);
+  std::vector<bool> useful(N, false);
+  std::vector<std::pair<unsigned, unsigned>> worklist;
+
+  auto mark = [&](unsigned block, unsigned index) {
+    if (!live[block][index])
+    {
+      live[block][index] = true;
+      worklist.push_back({block, index});
+    }
+  };
+
+  for (unsigned block = 0; block < N; block++)
+  {
+    live[block].assign(graph.blocks[block].size(), false);
+  }
+
+  // Seed with the critical instructions
+  for (unsigned block = 0; block < N; block++)
+  {
+    const std::vector<json> &instrs = graph.blocks[block];
+    for (unsigned i = 0; i < instrs.size(); i++)
+    {
+      if (CRITICAL_OPS.count(instrs[i]["op"].get<std::string>()))
+      {
+        mark(block, i);
+      }
+    }
+  }
+
+  // Keep every loop: the source of a retreating edge keeps its terminator
+  std::vector<unsigned> order = reverse_postorder(graph);
+  std::vector<unsigned> rpo_number(N, N);
+  for (unsigned i = 0; i < order.size(); i++)
+  {
+    rpo_number[order[i]] = i;
+  }
+  for (unsigned block : order)
+  {
+    for (unsigned succ : graph.succs[block])
+    {
+      if (rpo_number[succ] <= rpo_number[block])
+      {
+        mark(block, graph.blocks[block].size() - 1);
+      }
+    }
+  }
+
+  // Nearest useful block on the post-dominator chain above `block`, or N if there is none
+  auto nearest_useful_post_dominator = [&](unsigned block) {
+    unsigned target = pdom.idoms[block];
+    while (target < N && !useful[target])
+    {
+      target = pdom.idoms[target];
+    }
+    return target;
+  };
+
+  bool stable = false;
+  while (!stable)
+  {
+    // Propagate liveness through data and control dependences
+    while (!worklist.empty())
+    {
+      auto [block, index] = worklist.back();
+      worklist.pop_back();
+      const json &instr = graph.blocks[block][index];
+
+      // The definitions this instruction reads are live
+      if (instr.contains("args"))
+      {
+        for (const auto &arg : instr["args"])
+        {
+          for (unsigned def : rd.reaching(block, index, arg.get<std::string>()))
+          {
+            const auto &site = rd.defs[def];
+            if (site.block != ReachingDefinitions::ARGUMENT)
+            {
+              mark(site.block, site.index);
+            }
+          }
+        }
+      }
+
+      // The branches that decide whether this block runs are live
+      if (!useful[block])
+      {
+        useful[block] = true;
+        for (unsigned dep : cdg.depends_on[block])
+        {
+          mark(dep, graph.blocks[dep].size() - 1);
+        }
+      }
+    }
+
+    // A dead branch with nowhere useful to jump to has to stay, along with whatever it reads
+    stable = true;
+    for (unsigned block = 0; block < N; block++)
+    {
+      unsigned last = graph.blocks[block].size() - 1;
+      if (graph.blocks[block][last]["op"] == "br" && !live[block][last] && nearest_useful_post_dominator(block) >= N)
+      {
+        mark(block, last);
+        stable = false;
+      }
+    }
+  }
+
+  // Sweep the dead instructions and redirect dead branches
+  bool changed = false;
+  for (unsigned block = 0; block < N; block++)
+  {
+    std::vector<json> &instrs = graph.blocks[block];
+    std::vector<json> kept;
+    kept.reserve(instrs.size());
+
+    for (unsigned i = 0; i + 1 < instrs.size(); i++)
+    {
+      if (live[block][i])
+      {
+        kept.push_back(std::move(instrs[i]));
+      }
+      else
+      {
+        changed = true;
+      }
+    }
+
+    // Jumps and returns are never removed; a dead branch goes straight to the nearest useful post-dominator
+    json &term = instrs.back();
+    if (term["op"] == "br" && !live[block][instrs.size() - 1])
+    {
+      unsigned target = nearest_useful_post_dominator(block);
+      term = json{{"op", "jmp"}, {"labels", json::array({graph.names[target]})}};
+      graph.implicit_terminator[block] = false;
+      changed = true;
+    }
+    kept.push_back(std::move(term));
+    instrs = std::move(kept);
+  }
+
+  // A redirected branch can leave the blocks it used to reach unreachable, so drop those
+  graph.recompute_edges();
+  std::vector<bool> reachable(N, false);
+  for (unsigned block : reverse_postorder(graph))
+  {
+    reachable[block] = true;
+  }
+  std::vector<unsigned> layout;
+  layout.reserve(N);
+  for (unsigned block : graph.layout)
+  {
+    if (reachable[block])
+    {
+      layout.push_back(block);
+    }
+    else
+    {
+      changed = true;
+    }
+  }
+  graph.layout = std::move(layout);
+
+  if (changed)
+  {
+    func["instrs"] = reassemble(graph);
+  }
+
+  return changed;
+}
+
+int main()
+{
+  // Read JSON input
+  json program;
+  std::cin >> program;
+
+  // Check if "functions" exists and is an array
+  if (!program.contains("functions") || !program["functions"].is_array())
+  {
+    std::cerr << "Error: Expected a 'functions' key with an array of functions.\n";
+    return 1;
+  }
+
+  // With BRIL_CACHE_DIR set, functions optimized before get their stored result
+  std::unique_ptr<AnalysisCache> cache = AnalysisCache::from_env();
+
+  // One arena for all functions, emptied after each
+  Arena scratch;
+  for (auto &func : program["functions"])
+  {
+    std::string digest;
+    if (cache && func.contains("instrs"))
+    {
+      digest = AnalysisCache::digest(func);
+      if (std::optional<json> stored = cache->lookup(CACHE_KIND, digest))
+      {
+        func["instrs"] = std::move(*stored);
+        continue;
+      }
+    }
+
+    aggressive_dce(func, scratch);
+    scratch.reset();
+
+    if (!digest.empty())
+    {
+      cache->store(CACHE_KIND, digest, func["instrs"]);
+    }
+  }
+
+  std::cout << program.dump(2) << "\n";
+
+  return 0;
+}
@@ -0,0 +1,226 @@
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../cfg/block_graph.h"
+
+using json = nlohmann::json;
+
+// Opcodes that must be kept even if their destination is never read
+const std::unordered_set<std::string> EFFECT_OPS = {
+    "br", "jmp", "ret", "call", "print", "store", "alloc", "free",
+    "speculate", "commit", "guard"};
+
+/**
+ * @brief Checks whether an instruction has to stay regardless of liveness.
+ *
+ * Anything without a destination only exists for its effect, and effect
+ * operations with a destination (e.g. `call`) must run even if the result
+ * is ignored.
+ */
+bool is_critical(const json &instr)
+{
+  return !instr.contains("dest") || EFFECT_OPS.count(instr["op"].get<std::string>());
+}
+
+/**
+ * @brief Numbers every variable that is defined or read in the function.
+ */
+std::unordered_map<std::string, unsigned> number_variables(const BlockGraph &graph)
+{
+  std::unordered_map<std::string, unsigned> var_ids;
+
+  for (const auto &block : graph.blocks)
+  {
+    for (const auto &instr : block)
+    {
+      if (instr.contains("dest"))
+      {
+        var_ids.emplace(instr["dest"].get<std::string>(), var_ids.size());
+      }
+      if (instr.contains("args"))
+      {
+        for (const auto &arg : instr["args"])
+        {
+          var_ids.emplace(arg.get<std::string>(), var_ids.size());
+        }
+      }
+    }
+  }
+
+  return var_ids;
+}
+
+/**
+ * @brief Applies the strong-liveness transfer function of one instruction.
+ *
+ * Unlike ordinary liveness, the arguments of an instruction only become live
+ * if the instruction itself is needed, i.e. it is critical or its destination
+ * is live afterwards.  That way a chain of dead definitions is discovered in
+ * a single analysis instead of one DCE round per link.
+ *
+ * @return True if the instruction is needed.
+ */
+bool transfer(const json &instr, const std::unordered_map<std::string, unsigned> &var_ids, std::vector<bool> &live)
+{
+  bool needed = is_critical(instr);
+
+  if (instr.contains("dest"))
+  {
+    unsigned dest = var_ids.at(instr["dest"].get<std::string>());
+    needed = needed || live[dest];
+    live[dest] = false;
+  }
+
+  if (needed && instr.contains("args"))
+  {
+    for (const auto &arg : instr["args"])
+    {
+      live[var_ids.at(arg.get<std::string>())] = true;
+    }
+  }
+
+  return needed;
+}
+
+/**
+ * @brief Removes every dead definition from a function.
+ *
+ * Computes strongly-live variables over the CFG with a backward worklist,
+ * then sweeps each block once from bottom to top, dropping instructions that
+ * the analysis found unneeded.
+ *
+ * @param func Bril function object; its "instrs" are rewritten in place.
+ * @return True if any instruction was removed.
+ */
+bool liveness_dce(json &func)
+{
+  if (!func.contains("instrs"))
+  {
+    return false;
+  }
+
+  BlockGraph graph = form_block_graph(func["instrs"].get<std::vector<json>>());
+  unsigned N = graph.size();
+  if (N == 0)
+  {
+    return false;
+  }
+
+  std::unordered_map<std::string, unsigned> var_ids = number_variables(graph);
+  unsigned V = var_ids.size();
+
+  std::vector<std::vector<bool>> live_in(N, std::vector<bool>(V, false));
+  std::vector<std::vector<bool>> live_out(N, std::vector<bool>(V, false));
+
+  // Seed the worklist in postorder so most blocks see their successors' facts first
+  std::vector<unsigned> order = reverse_postorder(graph);
+  std::vector<unsigned> worklist(order.begin(), order.end());
+  std::vector<bool> queued(N, false);
+  for (unsigned block : worklist)
+  {
+    queued[block] = true;
+  }
+
+  while (!worklist.empty())
+  {
+    unsigned block = worklist.back();
+    worklist.pop_back();
+    queued[block] = false;
+
+    // Live-out is the union of the successors' live-in sets
+    std::vector<bool> live(V, false);
+    for (unsigned succ : graph.succs[block])
+    {
+      for (unsigned v = 0; v < V; v++)
+      {
+        if (live_in[succ][v])
+        {
+          live[v] = true;
+        }
+      }
+    }
+    live_out[block] = live;
+
+    // Walk the block bottom-up to get its live-in set
+    for (auto it = graph.blocks[block].rbegin(); it != graph.blocks[block].rend(); ++it)
+    {
+      transfer(*it, var_ids, live);
+    }
+
+    // If live-in grew, every predecessor has to be revisited
+    if (live != live_in[block])
+    {
+      live_in[block] = std::move(live);
+      for (unsigned pred : graph.preds[block])
+      {
+        if (!queued[pred])
+        {
+          queued[pred] = true;
+          worklist.push_back(pred);
+        }
+      }
+    }
+  }
+
+  // Sweep: one backward pass per block, keeping only the needed instructions
+  bool changed = false;
+  for (unsigned block = 0; block < N; block++)
+  {
+    std::vector<bool> live = live_out[block];
+    std::vector<json> &instrs = graph.blocks[block];
+    std::vector<bool> keep(instrs.size(), true);
+
+    for (size_t i = instrs.size(); i-- > 0;)
+    {
+      keep[i] = transfer(instrs[i], var_ids, live);
+    }
+
+    std::vector<json> kept;
+    kept.reserve(instrs.size());
+    for (size_t i = 0; i < instrs.size(); i++)
+    {
+      if (keep[i])
+      {
+        kept.push_back(std::move(instrs[i]));
+      }
+      else
+      {
+        changed = true;
+      }
+    }
+    instrs = std::move(kept);
+  }
+
+  if (changed)
+  {
+    func["instrs"] = reassemble(graph);
+  }
+
+  return changed;
+}
+
+int main()
+{
+  // Read JSON input
+  json program;
+  std::cin >> program;
+
+  // Check if "functions" exists and is an array
+  if (!program.contains("functions") || !program["functions"].is_array())
+  {
+    std::cerr << "Error: Expected a 'functions' key with an array of functions.\n";
+    return 1;
+  }
+
+  for (auto &func : program["functions"])
+  {
+    liveness_dce(func);
+  }
+
+  std::cout << program.dump(2) << "\n";
+
+  return 0;
+}
@@ -1,17 +1,22 @@
 #include <iostream>
 #include <unordered_map>
 #include <list>
+#include <memory_resource>
+#include <string_view>
 #include <vector>
-#include "../lesson2/form_cfg.h"
-#include "../lesson2/form_blocks.h"
+#include "../cfg/arena.h"
+#include "../cfg/form_cfg.h"
+#include "../cfg/form_blocks.h"
+#include "dominance_utilities.h"
 
 
 std::vector<std::string> find_common_dominators(const std::vector<std::string> &predecessors, 
-  const std::unordered_map<std::string, std::vector<std::string>>& dominators_list_list)
+  const std::unordered_map<std::string, std::vector<std::string>>& dominators_list_list,
+  std::pmr::memory_resource *scratch)
 {
 
-  // Initialize counts map
-  std::unordered_map<std::string, int> counts;
+  // Initialize counts map; its keys point into dominators_list_list, which outlives it
+  std::pmr::unordered_map<std::string_view, size_t> counts(scratch);
 
   // Initialize common map
   std::vector<std::string> common;
@@ -21,7 +26,7 @@ std::vector<std::string> find_common_dominators(const std::vector<std::string> &
   {
 
     // Loop through each predecessor and increment dominator count in dominator count matrix
-    for (auto dominator : dominators_list_list.at(predecessors[i]))
+    for (const std::string &dominator : dominators_list_list.at(predecessors[i]))
     {
       // If the dominator is also in count, add it
       if (counts.count(dominator))
@@ -40,7 +45,7 @@ std::vector<std::string> find_common_dominators(const std::vector<std::string> &
     {
       if (dominator_count == predecessors.size())
       {
-        common.push_back(dominator_name);
+        common.emplace_back(dominator_name);
       }
     }
 
@@ -65,7 +70,6 @@ std::unordered_map<std::string, std::vector<std::string>> find_dominators(std::v
 
   // Break the first function down into basic blocks
   std::vector<std::vector<json>> blocks = form_blocks(func);
-  std::cout << "This is working ";
 
   // Turn into full cfg
   std::pair<std::unordered_map<std::string, std::vector<json>>, std::vector<std::string>>
@@ -87,6 +91,9 @@ std::unordered_map<std::string, std::vector<std::string>> find_dominators(std::v
     dominators_list_list[block_name] = {block_name};
   }
 
+  // The counts for each block's intersection are thrown away as soon as it is done
+  Arena scratch;
+
   // Initialize changing flag
   bool changing = true;
 
@@ -101,7 +108,8 @@ std::unordered_map<std::string, std::vector<std::string>> find_dominators(std::v
     {
 
       // compute dominators inherited from predecessors
-      std::vector<std::string> new_dominators = find_common_dominators(preds_succs.first[block_name], dominators_list_list); // fix this
+      std::vector<std::string> new_dominators = find_common_dominators(preds_succs.first[block_name], dominators_list_list, &scratch); // fix this
+      scratch.reset();
 
       // Add this vertex and the intersection of all the dominators of this vertex's predecessors
       new_dominators.push_back(block_name);
@@ -117,46 +125,3 @@ std::unordered_map<std::string, std::vector<std::string>> find_dominators(std::v
 
   return dominators_list_list;
 }
-
-
-int main()
-{
-    // Read JSON input
-    json program;
-    std::cin >> program;
-
-    // Check if "functions" exists and is an array
-    if (!program.contains("functions") || !program["functions"].is_array())
-    {
-        std::cerr << "Error: Expected a 'functions' key with an array of functions.\n";
-        return 1;
-    }
-
-    for (auto& [func_name, func] : program["functions"].items()) {
-      std::cout << "Processing function: " << func_name << "\n";
-      // Form basic blocks out of the function
-      std::vector<std::vector<json>> blocks = form_blocks(func["instrs"]);
-      std::cout << "Failing before here";
-
-        std::string function_name = func["name"];
-
-        // Compute dominators for the current function
-        std::unordered_map<std::string, std::vector<std::string>> dominators = find_dominators(func["instrs"]);
-
-        // Print function name
-        std::cout << "Function: " << func_name << "\n";
-
-        // Print each block with its list of dominators
-        for (const auto& [block, dominator_list] : dominators)
-        {
-            std::cout << "  Block: " << block << "\n  Dominators: ";
-            for (const auto& dominator : dominator_list)
-            {
-                std::cout << dominator << " ";
-            }
-            std::cout << "\n\n";
-        }
-    }
-
-    return 0;
-}
@@ -0,0 +1,34 @@
+#ifndef DOMINANCE_UTILITIES_H
+#define DOMINANCE_UTILITIES_H
+
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+/**
+ * @brief Returns the dominators shared by every predecessor.
+ *
+ * @param predecessors Names of the predecessor blocks.
+ * @param dominators_list_list The current dominator lists of all blocks.
+ * @param scratch Where the per-call counts are allocated.
+ * @return The names that appear in the dominator list of every predecessor.
+ */
+std::vector<std::string> find_common_dominators(const std::vector<std::string> &predecessors,
+  const std::unordered_map<std::string, std::vector<std::string>>& dominators_list_list,
+  std::pmr::memory_resource *scratch = std::pmr::get_default_resource());
+
+/**
+ * @brief Finds the dominators in a function.
+ *
+ * This function takes a BRIL function and returns the dominators.
+ *
+ * @param func BRIL function to analyze.
+ * @return a map that maps block names to names of blocks that dominate that block.
+ */
+std::unordered_map<std::string, std::vector<std::string>> find_dominators(std::vector<json> func);
+
+#endif // DOMINANCE_UTILITIES_H
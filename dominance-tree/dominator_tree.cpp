@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <memory_resource>
+#include <vector>
+#include "../cfg/block_graph.h"
+#include "dominator_tree.h"
+
+namespace {
+
+// Reverse postorder of the nodes reachable from `root`, following `succs`
+template <typename Lists>
+std::pmr::vector<unsigned> rpo_from(unsigned root, const Lists &succs, std::pmr::memory_resource *mem)
+{
+  std::pmr::vector<unsigned> order(mem);
+  std::pmr::vector<bool> visited(succs.size(), false, mem);
+  std::pmr::vector<std::pair<unsigned, size_t>> stack(mem);
+  stack.push_back({root, 0});
+  visited[root] = true;
+
+  while (!stack.empty())
+  {
+    auto &[node, next] = stack.back();
+    if (next < succs[node].size())
+    {
+      unsigned succ = succs[node][next++];
+      if (!visited[succ])
+      {
+        visited[succ] = true;
+        stack.push_back({succ, 0});
+      }
+    }
+    else
+    {
+      order.push_back(node);
+      stack.pop_back();
+    }
+  }
+
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+/**
+ * Builds a dominator tree for an arbitrary graph given as successor and
+ * predecessor lists.  The post-dominator tree is this with the lists swapped.
+ * Working state goes in `mem`; only the tree itself is on the heap.
+ */
+template <typename Lists>
+DominatorTree build_tree(unsigned root, const Lists &succs, const Lists &preds, std::pmr::memory_resource *mem)
+{
+  unsigned N = succs.size();
+  DominatorTree tree;
+  tree.root = root;
+  tree.idoms.assign(N, DominatorTree::NONE);
+  tree.children.assign(N, {});
+  tree.frontier.assign(N, {});
+  tree.pre.assign(N, 0);
+  tree.post.assign(N, 0);
+
+  std::pmr::vector<unsigned> order = rpo_from(root, succs, mem);
+  std::pmr::vector<unsigned> rpo_number(N, DominatorTree::NONE, mem);
+  for (unsigned i = 0; i < order.size(); i++)
+  {
+    rpo_number[order[i]] = i;
+  }
+
+  // Cooper-Harvey-Kennedy: walk both fingers up the partial tree until they meet
+  auto intersect = [&](unsigned a, unsigned b) {
+    while (a != b)
+    {
+      while (rpo_number[a] > rpo_number[b])
+      {
+        a = tree.idoms[a];
+      }
+      while (rpo_number[b] > rpo_number[a])
+      {
+        b = tree.idoms[b];
+      }
+    }
+    return a;
+  };
+
+  tree.idoms[root] = root;
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (unsigned i = 1; i < order.size(); i++)
+    {
+      unsigned node = order[i];
+      unsigned new_idom = DominatorTree::NONE;
+      for (unsigned pred : preds[node])
+      {
+        // Skip predecessors that are unreachable or not processed yet
+        if (tree.idoms[pred] == DominatorTree::NONE)
+        {
+          continue;
+        }
+        new_idom = new_idom == DominatorTree::NONE ? pred : intersect(pred, new_idom);
+      }
+      if (tree.idoms[node] != new_idom)
+      {
+        tree.idoms[node] = new_idom;
+        changed = true;
+      }
+    }
+  }
+  tree.idoms[root] = DominatorTree::NONE;
+
+  // Children lists, in reverse postorder so the tree walk below is deterministic
+  for (unsigned node : order)
+  {
+    if (node != root)
+    {
+      tree.children[tree.idoms[node]].push_back(node);
+    }
+  }
+
+  // Number the tree in preorder/postorder for constant-time dominance queries
+  unsigned counter = 0;
+  std::pmr::vector<std::pair<unsigned, size_t>> stack(mem);
+  stack.push_back({root, 0});
+  tree.pre[root] = counter++;
+  while (!stack.empty())
+  {
+    auto &[node, next] = stack.back();
+    if (next < tree.children[node].size())
+    {
+      unsigned child = tree.children[node][next++];
+      tree.pre[child] = counter++;
+      stack.push_back({child, 0});
+    }
+    else
+    {
+      tree.post[node] = counter++;
+      stack.pop_back();
+    }
+  }
+
+  // Dominance frontier: walk up from each join point's predecessors to its idom
+  for (unsigned node : order)
+  {
+    if (preds[node].size() < 2)
+    {
+      continue;
+    }
+    for (unsigned pred : preds[node])
+    {
+      if (!tree.contains(pred))
+      {
+        continue;
+      }
+      unsigned runner = pred;
+      while (runner != tree.idoms[node] && runner != DominatorTree::NONE)
+      {
+        tree.frontier[runner].push_back(node);
+        runner = tree.idoms[runner];
+      }
+    }
+  }
+  for (auto &df : tree.frontier)
+  {
+    std::sort(df.begin(), df.end());
+    df.erase(std::unique(df.begin(), df.end()), df.end());
+  }
+
+  return tree;
+}
+
+} // namespace
+
+DominatorTree compute_dominators(const BlockGraph &graph, Arena *scratch)
+{
+  if (graph.size() == 0)
+  {
+    return DominatorTree{};
+  }
+  Arena local;
+  return build_tree(0, graph.succs, graph.preds, scratch ? scratch : &local);
+}
+
+DominatorTree compute_post_dominators(const BlockGraph &graph, Arena *scratch)
+{
+  unsigned N = graph.size();
+  unsigned exit = N;
+  Arena local;
+  std::pmr::memory_resource *mem = scratch ? scratch : &local;
+
+  // Reverse the CFG and add the virtual exit, which every returning block flows into
+  std::pmr::vector<std::pmr::vector<unsigned>> rsuccs(N + 1, mem), rpreds(N + 1, mem);
+  for (unsigned block = 0; block < N; block++)
+  {
+    rsuccs[block].assign(graph.preds[block].begin(), graph.preds[block].end());
+    rpreds[block].assign(graph.succs[block].begin(), graph.succs[block].end());
+    if (graph.succs[block].empty())
+    {
+      rsuccs[exit].push_back(block);
+      rpreds[block].push_back(exit);
+    }
+  }
+
+  // Blocks stuck in an infinite loop never reach a ret; treat the last such block of each loop as an exit
+  std::pmr::vector<bool> reaches_exit(N + 1, false, mem);
+  for (unsigned node : rpo_from(exit, rsuccs, mem))
+  {
+    reaches_exit[node] = true;
+  }
+  for (unsigned block = N; block-- > 0;)
+  {
+    if (reaches_exit[block])
+    {
+      continue;
+    }
+    rsuccs[exit].push_back(block);
+    rpreds[block].push_back(exit);
+    for (unsigned node : rpo_from(block, rsuccs, mem))
+    {
+      reaches_exit[node] = true;
+    }
+  }
+
+  return build_tree(exit, rsuccs, rpreds, mem);
+}
+
+ControlDependence compute_control_dependence(const BlockGraph &graph, const DominatorTree &post_dominators)
+{
+  unsigned N = graph.size();
+  ControlDependence cdg;
+  cdg.depends_on.assign(N, {});
+  cdg.dependents.assign(N, {});
+
+  for (unsigned block = 0; block < N; block++)
+  {
+    // A block with a single successor decides nothing
+    if (graph.succs[block].size() < 2)
+    {
+      continue;
+    }
+    unsigned stop = post_dominators.idoms[block];
+    for (unsigned succ : graph.succs[block])
+    {
+      for (unsigned runner = succ; runner != stop && runner < N; runner = post_dominators.idoms[runner])
+      {
+        cdg.depends_on[runner].push_back(block);
+        cdg.dependents[block].push_back(runner);
+      }
+    }
+  }
+
+  for (unsigned block = 0; block < N; block++)
+  {
+    auto &deps = cdg.depends_on[block];
+    std::sort(deps.begin(), deps.end());
+    deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+    auto &dependents = cdg.dependents[block];
+    std::sort(dependents.begin(), dependents.end());
+    dependents.erase(std::unique(dependents.begin(), dependents.end()), dependents.end());
+  }
+
+  return cdg;
+}
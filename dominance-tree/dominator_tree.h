@@ -0,0 +1,88 @@
+#ifndef DOMINATOR_TREE_H
+#define DOMINATOR_TREE_H
+
+#include <vector>
+#include "../cfg/block_graph.h"
+
+/**
+ * @brief A (post-)dominator tree over a BlockGraph in index form.
+ *
+ * Nodes are the graph's block indices.  For post-dominator trees there is
+ * one extra node, index `graph.size()`, standing for a virtual exit that
+ * every returning block flows into; it is the root of the tree.
+ */
+struct DominatorTree {
+  /// Index of the root (the entry block, or the virtual exit).
+  unsigned root = 0;
+
+  /// Immediate dominator of each node.  `NONE` for the root and for blocks
+  /// that are unreachable (from the entry, or to the exit).
+  std::vector<unsigned> idoms;
+
+  /// Children of each node in the tree, i.e. the nodes it immediately dominates.
+  std::vector<std::vector<unsigned>> children;
+
+  /// (Post-)dominance frontier of each node, sorted and deduplicated.
+  std::vector<std::vector<unsigned>> frontier;
+
+  /// Preorder entry/exit numbers of each node, used for O(1) dominance queries.
+  std::vector<unsigned> pre;
+  std::vector<unsigned> post;
+
+  /// Sentinel stored in `idoms` when a node has no immediate dominator.
+  static constexpr unsigned NONE = ~0u;
+
+  /// True if the node is part of the tree.
+  bool contains(unsigned node) const { return node == root || idoms[node] != NONE; }
+
+  /// True if `a` (post-)dominates `b`.  Every node dominates itself.
+  bool dominates(unsigned a, unsigned b) const
+  {
+    return contains(a) && contains(b) && pre[a] <= pre[b] && post[b] <= post[a];
+  }
+};
+
+/**
+ * @brief Computes the dominator tree of a function's CFG.
+ *
+ * Uses the Cooper–Harvey–Kennedy iterative algorithm over reverse
+ * postorder, which runs in near-linear time on real CFGs.  Its working
+ * state goes in `scratch` if given, or in a temporary arena.
+ */
+DominatorTree compute_dominators(const BlockGraph& graph, Arena* scratch = nullptr);
+
+/**
+ * @brief Computes the post-dominator tree of a function's CFG.
+ *
+ * Runs the same algorithm on the reversed CFG, rooted at a virtual exit
+ * (node `graph.size()`) that every `ret` block leads to.  Blocks that can
+ * never reach a `ret` (infinite loops) are connected to the virtual exit as
+ * well, so every block is part of the tree.  The reversed CFG and other
+ * working state go in `scratch` if given, or in a temporary arena.
+ */
+DominatorTree compute_post_dominators(const BlockGraph& graph, Arena* scratch = nullptr);
+
+/**
+ * @brief The control dependence graph of a function.
+ *
+ * Block `b` is control dependent on block `a` if `a` ends in a branch that
+ * decides whether `b` runs: one of `a`'s successors is post-dominated by
+ * `b`, but `a` itself is not.
+ */
+struct ControlDependence {
+  /// For each block, the blocks whose terminators it depends on.
+  std::vector<std::vector<unsigned>> depends_on;
+
+  /// For each block, the blocks that depend on its terminator.
+  std::vector<std::vector<unsigned>> dependents;
+};
+
+/**
+ * @brief Builds the control dependence graph from a post-dominator tree.
+ *
+ * For each CFG edge `a → s`, every node on the post-dominator tree path from
+ * `s` up to (but excluding) `ipdom(a)` is control dependent on `a`.
+ */
+ControlDependence compute_control_dependence(const BlockGraph& graph, const DominatorTree& post_dominators);
+
+#endif // DOMINATOR_TREE_H
@@ -0,0 +1,46 @@
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "dominance_utilities.h"
+
+using json = nlohmann::json;
+
+int main()
+{
+    // Read JSON input
+    json program;
+    std::cin >> program;
+
+    // Check if "functions" exists and is an array
+    if (!program.contains("functions") || !program["functions"].is_array())
+    {
+        std::cerr << "Error: Expected a 'functions' key with an array of functions.\n";
+        return 1;
+    }
+
+    for (auto& [func_name, func] : program["functions"].items()) {
+      std::cout << "Processing function: " << func_name << "\n";
+        std::string function_name = func["name"];
+
+        // Compute dominators for the current function
+        std::unordered_map<std::string, std::vector<std::string>> dominators = find_dominators(func["instrs"]);
+
+        // Print function name
+        std::cout << "Function: " << func_name << "\n";
+
+        // Print each block with its list of dominators
+        for (const auto& [block, dominator_list] : dominators)
+        {
+            std::cout << "  Block: " << block << "\n  Dominators: ";
+            for (const auto& dominator : dominator_list)
+            {
+                std::cout << dominator << " ";
+            }
+            std::cout << "\n\n";
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,30 @@
+#!/bin/sh
+# Runs the verify-dom pass over every .ll file under a directory and prints one
+# table: per function, its block count, the time to build MyDomAnalysis and
+# LLVM's tree plus frontier, and how many idoms, child lists and frontiers
+# disagree.  Details of the first few disagreements go to stderr.
+# Usage: ./verify-dom.sh <dir> [path/to/SkeletonPass.so]
+set -e
+DIR=${1:?usage: $0 <dir> [plugin]}
+PLUGIN=${2:-$(dirname "$0")/../build/skeleton/SkeletonPass.so}
+OPT=${OPT:-opt}
+
+find "$DIR" -name '*.ll' | sort | while read -r f; do
+  "$OPT" -load-pass-plugin "$PLUGIN" -passes=verify-dom -disable-output "$f" ||
+    printf '%s\t-\t-\t-\t-\t-\t-\t-\n' "$f"
+done | awk -F '\t' '
+  BEGIN {
+    printf "%-32s %-24s %8s %12s %12s %7s %5s %5s %5s\n", "module", "function", "blocks", "mine(us)", "llvm(us)", "ratio", "idom", "kids", "df"
+  }
+  {
+    ratio = ($5 > 0 && $4 != "-") ? sprintf("%.1fx", $4 / $5) : "-"
+    printf "%-32s %-24s %8s %12s %12s %7s %5s %5s %5s\n", $1, $2, $3, $4, $5, ratio, $6, $7, $8
+    if ($4 == "-") { failed++; next }
+    functions++; blocks += $3; mine += $4; llvm += $5
+    if ($6 + $7 + $8 > 0) mismatched++
+  }
+  END {
+    printf "\n%d functions, %d blocks: %.0f us ours, %.0f us LLVM", functions, blocks, mine, llvm
+    printf ", %d functions disagree, %d modules failed\n", mismatched, failed
+    exit (mismatched + failed > 0)
+  }'
@@ -2,6 +2,7 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Analysis/ScalarEvolutionExpressions.h"
 #include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
@@ -9,9 +10,11 @@
 #include "llvm/ADT/BitVector.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/Analysis/DominanceFrontier.h"
+#include "llvm/Analysis/PostDominators.h"
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <chrono>
 
 
 using namespace llvm;
@@ -213,71 +216,73 @@ namespace
                 // Erase the duplicates
                 DFb.erase(std::unique(DFb.begin(), DFb.end()), DFb.end());
                 }
+            }
 
+            // Dump everything the constructor computed
+            void print(raw_ostream &OS) const {
+                unsigned N = Blocks.size();
+                unsigned entryIdx = 0; // the entry block always comes first
 
-
-                errs() << "=== Dominator Analysis Results ===\n";
+                OS << "=== Dominator Analysis Results ===\n";
 
                 // 1) Print the Blocks vector
-                errs() << "Blocks (" << Blocks.size() << "):\n";
+                OS << "Blocks (" << Blocks.size() << "):\n";
                 for (auto *BB : Blocks) {
-                errs() << "  [" << BlockIndices[BB] << "] " << BB->getName() << "\n";
+                OS << "  [" << BlockIndices.lookup(BB) << "] " << BB->getName() << "\n";
                 }
 
                 // 2) Print the BlockIndex map
-                errs() << "BlockIndex map:\n";
+                OS << "BlockIndex map:\n";
                 for (auto &KV : BlockIndices) {
-                errs() << "  " << KV.first->getName() << " -> " << KV.second << "\n";
+                OS << "  " << KV.first->getName() << " -> " << KV.second << "\n";
                 }
 
                 // 3) Print the DomSets
-                errs() << "DomSets (dominator lists):\n";
+                OS << "DomSets (dominator lists):\n";
                 for (unsigned i = 0; i < Blocks.size(); ++i) {
                 BasicBlock *BB = Blocks[i];
-                unsigned idx = BlockIndices[BB];
-                errs() << "  " << idx<< " dominated by: ";
+                unsigned idx = BlockIndices.lookup(BB);
+                OS << "  " << idx<< " dominated by: ";
                 bool first = true;
                 for (unsigned j = 0; j < Blocks.size(); ++j) {
                     if (DomSets[i].test(j)) {
-                    if (!first) errs() << ", ";
+                    if (!first) OS << ", ";
                     BasicBlock *BB = Blocks[j];
-                    errs() << BlockIndices[BB];
+                    OS << BlockIndices.lookup(BB);
                     first = false;
                     }
                 }
-                errs() << "\n";
+                OS << "\n";
                 }
 
-                errs() << "===============================\n";
+                OS << "===============================\n";
 
-                errs() << "--- Immediate Dominators ---\n";
+                OS << "--- Immediate Dominators ---\n";
                 for (unsigned i = 0; i < N; ++i) {
-                errs() << "[" << i << "] idom = ";
+                OS << "[" << i << "] idom = ";
                 if (i == entryIdx)
-                    errs() << "none\n";
+                    OS << "none\n";
                 else
-                    errs() << idoms[i] << "\n";
+                    OS << idoms[i] << "\n";
                 }
 
-                errs() << "--- Dominator Tree (Children) ---\n";
+                OS << "--- Dominator Tree (Children) ---\n";
                 for (unsigned i = 0; i < N; ++i) {
-                errs() << "[" << i << "] children:";
+                OS << "[" << i << "] children:";
                 for (unsigned c : Children[i])
-                    errs() << " " << c;
-                errs() << "\n";
+                    OS << " " << c;
+                OS << "\n";
                 }
 
-                errs() << "--- Dominance Frontier ---\n";
+                OS << "--- Dominance Frontier ---\n";
                 for (unsigned i = 0; i < N; ++i) {
-                errs() << "[" << i << "] DF:";
+                OS << "[" << i << "] DF:";
                 for (unsigned w : DominanceFrontier[i])
-                    errs() << " " << w;
-                errs() << "\n";
+                    OS << " " << w;
+                OS << "\n";
                 }
 
-                errs() << "===============================\n";
-
-            
+                OS << "===============================\n";
             }
 
         };
@@ -305,9 +310,7 @@ namespace
     // Printer pass to consume MyDomAnalysis
     struct MyDomPrinter : public PassInfoMixin<MyDomPrinter> {
     PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM) {
-        // Trigger the analysis, which prints results in its Result constructor
-        FAM.getResult<MyDomAnalysis>(F);
-        errs() << "runninnngng";
+        FAM.getResult<MyDomAnalysis>(F).print(errs());
         return PreservedAnalyses::all();
   }
 };
@@ -392,6 +395,333 @@ namespace
     return PreservedAnalyses::all();
   }
 };
+
+    // Builds MyDomAnalysis and LLVM's dominator tree and frontier side by side, silently,
+    // and checks idoms, children and frontiers against each other.  Prints one
+    // tab-separated row per function: module, function, blocks, microseconds to build
+    // ours, microseconds to build LLVM's, then the idom, children and frontier mismatches.
+    // Blocks unreachable from the entry are left out; LLVM gives them no tree node
+    struct DomVerifier : PassInfoMixin<DomVerifier> {
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM) {
+    using Clock = std::chrono::steady_clock;
+    auto micros = [](Clock::duration d) {
+      return std::chrono::duration<double, std::micro>(d).count();
+    };
+
+    for (Function &F : M) {
+      if (F.isDeclaration())
+        continue;
+
+      auto t0 = Clock::now();
+      MyDomAnalysis::Result Mine(F);
+      auto t1 = Clock::now();
+      DominatorTree DT(F);
+      DominanceFrontier DF;
+      DF.analyze(DT);
+      auto t2 = Clock::now();
+
+      const auto &Blocks = Mine.Blocks;
+      unsigned N = Blocks.size();
+      auto reachable = [&](unsigned i) { return DT.isReachableFromEntry(Blocks[i]); };
+      auto sorted = [&](std::vector<unsigned> v) {
+        v.erase(std::remove_if(v.begin(), v.end(), [&](unsigned i) { return !reachable(i); }), v.end());
+        std::sort(v.begin(), v.end());
+        return v;
+      };
+
+      unsigned idomMismatch = 0, childMismatch = 0, frontierMismatch = 0;
+      auto report = [&](unsigned &count, const char *what, unsigned i) {
+        if (count++ < 5)
+          errs() << "verify-dom: " << F.getName() << ": " << what << " of block " << i << " ("
+                 << Blocks[i]->getName() << ") differs\n";
+      };
+
+      for (unsigned i = 0; i < N; ++i) {
+        if (!reachable(i))
+          continue;
+        DomTreeNode *Node = DT.getNode(Blocks[i]);
+
+        if (Node->getIDom() && Mine.idoms[i] != Mine.BlockIndices.lookup(Node->getIDom()->getBlock()))
+          report(idomMismatch, "idom", i);
+
+        std::vector<unsigned> llvmChildren;
+        for (DomTreeNode *Child : Node->children())
+          llvmChildren.push_back(Mine.BlockIndices.lookup(Child->getBlock()));
+        if (sorted(Mine.Children[i]) != sorted(llvmChildren))
+          report(childMismatch, "children", i);
+
+        std::vector<unsigned> llvmFrontier;
+        auto it = DF.find(Blocks[i]);
+        if (it != DF.end())
+          for (BasicBlock *S : it->second)
+            llvmFrontier.push_back(Mine.BlockIndices.lookup(S));
+        if (sorted(Mine.DominanceFrontier[i]) != sorted(llvmFrontier))
+          report(frontierMismatch, "frontier", i);
+      }
+
+      outs() << M.getModuleIdentifier() << "\t" << F.getName() << "\t" << N << "\t"
+             << format("%.1f\t%.1f", micros(t1 - t0), micros(t2 - t1)) << "\t" << idomMismatch << "\t"
+             << childMismatch << "\t" << frontierMismatch << "\n";
+    }
+    return PreservedAnalyses::all();
+  }
+};
+
+    // Post-dominator analysis: the same bit-vector formulation as MyDomAnalysis, run on the reversed CFG
+    struct MyPostDomAnalysis : public AnalysisInfoMixin<MyPostDomAnalysis>
+    {
+
+        struct Result {
+            DenseMap<BasicBlock*, unsigned> BlockIndices;
+
+            std::vector<BasicBlock*> Blocks;
+
+            // Index of the virtual exit node that every returning block flows into (== Blocks.size())
+            unsigned ExitIdx;
+
+            // For each node (blocks plus the virtual exit), bit i is true if node i post-dominates it
+            std::vector<BitVector> PostDomSets;
+
+            // Immediate post-dominator of each node (ExitIdx has none and points to itself)
+            std::vector<unsigned> ipdoms;
+
+            // Children of each node in the post-dominator tree
+            std::vector<std::vector<unsigned>> Children;
+
+            // Successors of each node in the CFG, with exiting blocks pointing at the virtual exit
+            std::vector<std::vector<unsigned>> Succs;
+
+            Result(Function &F){
+                unsigned idx = 0;
+                for (BasicBlock &BB: F){
+                    BlockIndices[&BB] = idx;
+                    Blocks.push_back(&BB);
+                    idx = idx + 1;
+                }
+
+                unsigned N = Blocks.size();
+                ExitIdx = N;
+
+                // Build successor lists, sending every block without successors to the virtual exit
+                Succs.assign(N + 1, {});
+                std::vector<std::vector<unsigned>> Preds(N + 1);
+                for (BasicBlock *BB: Blocks){
+                    unsigned blockIdx = BlockIndices[BB];
+                    for (BasicBlock *succ: successors(BB)){
+                        Succs[blockIdx].push_back(BlockIndices[succ]);
+                        Preds[BlockIndices[succ]].push_back(blockIdx);
+                    }
+                    if (Succs[blockIdx].empty()){
+                        Succs[blockIdx].push_back(ExitIdx);
+                        Preds[ExitIdx].push_back(blockIdx);
+                    }
+                }
+
+                // Blocks that can never reach the exit (infinite loops) get an edge to it as well,
+                // one per loop, so that every block ends up in the tree
+                BitVector ReachesExit(N + 1, false);
+                auto markReaching = [&](unsigned start) {
+                    std::vector<unsigned> stack{start};
+                    ReachesExit.set(start);
+                    while (!stack.empty()){
+                        unsigned node = stack.back();
+                        stack.pop_back();
+                        for (unsigned pred: Preds[node]){
+                            if (!ReachesExit.test(pred)){
+                                ReachesExit.set(pred);
+                                stack.push_back(pred);
+                            }
+                        }
+                    }
+                };
+                markReaching(ExitIdx);
+                for (unsigned i = N; i-- > 0;){
+                    if (!ReachesExit.test(i)){
+                        Succs[i].push_back(ExitIdx);
+                        Preds[ExitIdx].push_back(i);
+                        markReaching(i);
+                    }
+                }
+
+                // Every node starts out post-dominated by everything, except the exit
+                PostDomSets.assign(N + 1, BitVector(N + 1, true));
+                PostDomSets[ExitIdx].reset();
+                PostDomSets[ExitIdx].set(ExitIdx);
+
+                // Refine until convergence, walking the blocks bottom-up
+                bool changed = true;
+                while (changed) {
+                    changed = false;
+                    for (unsigned i = N; i-- > 0;){
+                        BitVector newPostDom(N + 1, true);
+
+                        // Take the intersection of the post-dominators of all successors
+                        for (unsigned succ: Succs[i]){
+                            newPostDom &= PostDomSets[succ];
+                        }
+                        newPostDom.set(i);
+
+                        if (PostDomSets[i] != newPostDom){
+                            changed = true;
+                            PostDomSets[i] = newPostDom;
+                        }
+                    }
+                }
+
+                // The immediate post-dominator is the strict post-dominator with the most post-dominators
+                ipdoms.assign(N + 1, ExitIdx);
+                Children.assign(N + 1, {});
+                for (unsigned i = 0; i < N; i++){
+                    BitVector strict = PostDomSets[i];
+                    strict.reset(i);
+
+                    unsigned bestIdx = ExitIdx;
+                    for (unsigned p: strict.set_bits()){
+                        if (PostDomSets[p].count() > PostDomSets[bestIdx].count()){
+                            bestIdx = p;
+                        }
+                    }
+
+                    ipdoms[i] = bestIdx;
+                    Children[bestIdx].push_back(i);
+                }
+            }
+        };
+
+    Result run(Function &F, FunctionAnalysisManager &AM){
+        return Result(F);
+    }
+
+    static llvm::AnalysisKey Key;
+
+    friend struct AnalysisInfoMixin<MyPostDomAnalysis>;
+
+    };
+
+    AnalysisKey MyPostDomAnalysis::Key;
+
+
+    // Control dependence graph built from MyPostDomAnalysis
+    struct MyControlDependenceAnalysis : public AnalysisInfoMixin<MyControlDependenceAnalysis>
+    {
+
+        struct Result {
+            // For each block, the blocks whose terminators decide whether it runs
+            std::vector<std::vector<unsigned>> DependsOn;
+
+            // For each block, the blocks that depend on its terminator
+            std::vector<std::vector<unsigned>> Dependents;
+
+            Result(const MyPostDomAnalysis::Result &PDT){
+                unsigned N = PDT.Blocks.size();
+                DependsOn.assign(N, {});
+                Dependents.assign(N, {});
+
+                // For each edge a -> s, everything on the tree path from s up to ipdom(a) depends on a
+                for (unsigned a = 0; a < N; a++){
+                    if (PDT.Succs[a].size() < 2){
+                        continue;
+                    }
+                    unsigned stop = PDT.ipdoms[a];
+                    for (unsigned s: PDT.Succs[a]){
+                        for (unsigned runner = s; runner != stop && runner != PDT.ExitIdx; runner = PDT.ipdoms[runner]){
+                            DependsOn[runner].push_back(a);
+                            Dependents[a].push_back(runner);
+                        }
+                    }
+                }
+
+                // Deduplicate each list
+                for (auto *Lists: {&DependsOn, &Dependents}){
+                    for (auto &L: *Lists){
+                        std::sort(L.begin(), L.end());
+                        L.erase(std::unique(L.begin(), L.end()), L.end());
+                    }
+                }
+            }
+        };
+
+    Result run(Function &F, FunctionAnalysisManager &AM){
+        return Result(AM.getResult<MyPostDomAnalysis>(F));
+    }
+
+    static llvm::AnalysisKey Key;
+
+    friend struct AnalysisInfoMixin<MyControlDependenceAnalysis>;
+
+    };
+
+    AnalysisKey MyControlDependenceAnalysis::Key;
+
+
+    // Printer pass to consume MyPostDomAnalysis and MyControlDependenceAnalysis
+    struct MyPostDomPrinter : public PassInfoMixin<MyPostDomPrinter> {
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM) {
+        auto &PDT = FAM.getResult<MyPostDomAnalysis>(F);
+        auto &CDG = FAM.getResult<MyControlDependenceAnalysis>(F);
+        unsigned N = PDT.Blocks.size();
+
+        errs() << "=== Post-Dominator Analysis Results (" << F.getName() << ") ===\n";
+        errs() << "--- Immediate Post-Dominators ---\n";
+        for (unsigned i = 0; i < N; ++i) {
+            errs() << "[" << i << "] ipdom = ";
+            if (PDT.ipdoms[i] == PDT.ExitIdx)
+                errs() << "exit\n";
+            else
+                errs() << PDT.ipdoms[i] << "\n";
+        }
+
+        errs() << "--- Post-Dominator Tree (Children) ---\n";
+        for (unsigned i = 0; i <= N; ++i) {
+            if (i == PDT.ExitIdx)
+                errs() << "[exit] children:";
+            else
+                errs() << "[" << i << "] children:";
+            for (unsigned c : PDT.Children[i])
+                errs() << " " << c;
+            errs() << "\n";
+        }
+
+        errs() << "--- Control Dependences ---\n";
+        for (unsigned i = 0; i < N; ++i) {
+            errs() << "[" << i << "] depends on:";
+            for (unsigned d : CDG.DependsOn[i])
+                errs() << " " << d;
+            errs() << "\n";
+        }
+        errs() << "===============================\n";
+        return PreservedAnalyses::all();
+  }
+};
+
+   // Prints LLVM's own post-dominator tree in the same format, for comparison with MyPostDomPrinter
+   struct LlvmPostDomPrinter : PassInfoMixin<LlvmPostDomPrinter> {
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
+    std::vector<BasicBlock*> Blocks;
+    DenseMap<BasicBlock*, unsigned> Idx;
+    unsigned counter = 0;
+    for (BasicBlock &BB : F) {
+      Idx[&BB] = counter;
+      Blocks.push_back(&BB);
+      ++counter;
+    }
+
+    auto &PDT = AM.getResult<PostDominatorTreeAnalysis>(F);
+
+    errs() << "--- Immediate Post-Dominators ---\n";
+    for (unsigned i = 0; i < Blocks.size(); ++i) {
+      auto *Node = PDT.getNode(Blocks[i]);
+      errs() << "[" << i << "] ipdom = ";
+      // LLVM's virtual root has a null block
+      if (!Node || !Node->getIDom() || !Node->getIDom()->getBlock())
+        errs() << "exit\n";
+      else
+        errs() << Idx[Node->getIDom()->getBlock()] << "\n";
+    }
+    errs() << "========================================\n\n";
+    return PreservedAnalyses::all();
+  }
+};
 }
 
 
@@ -407,6 +737,8 @@ llvmGetPassPluginInfo()
             PB.registerAnalysisRegistrationCallback(
             [](FunctionAnalysisManager &FAM) {
               FAM.registerPass([]() { return MyDomAnalysis(); });
+              FAM.registerPass([]() { return MyPostDomAnalysis(); });
+              FAM.registerPass([]() { return MyControlDependenceAnalysis(); });
             });
 
 
@@ -421,6 +753,21 @@ llvmGetPassPluginInfo()
               return false;
             });
 
+        // Let -passes="require<my-dom>" (and my-postdom) build an analysis on its own, for timing
+        PB.registerPipelineParsingCallback(
+            [](StringRef Name, FunctionPassManager &FPM,
+               ArrayRef<PassBuilder::PipelineElement>) {
+              if (Name == "require<my-dom>") {
+                FPM.addPass(RequireAnalysisPass<MyDomAnalysis, Function>());
+                return true;
+              }
+              if (Name == "require<my-postdom>") {
+                FPM.addPass(RequireAnalysisPass<MyPostDomAnalysis, Function>());
+                return true;
+              }
+              return false;
+            });
+
         // Register the printer pass for LLVM's dom analysis
         PB.registerPipelineParsingCallback(
             [](StringRef Name, FunctionPassManager &FPM,
@@ -431,5 +778,31 @@ llvmGetPassPluginInfo()
               }
               return false;
             });
+
+        // Register the differential checker for -passes="verify-dom"
+        PB.registerPipelineParsingCallback(
+            [](StringRef Name, ModulePassManager &MPM,
+               ArrayRef<PassBuilder::PipelineElement>) {
+              if (Name == "verify-dom") {
+                MPM.addPass(DomVerifier());
+                return true;
+              }
+              return false;
+            });
+
+        // Register the post-dominator / control dependence printer for -passes="my-postdom-analysis"
+        PB.registerPipelineParsingCallback(
+            [](StringRef Name, FunctionPassManager &FPM,
+               ArrayRef<PassBuilder::PipelineElement>) {
+              if (Name == "my-postdom-analysis") {
+                FPM.addPass(MyPostDomPrinter());
+                return true;
+              }
+              if (Name == "print-llvm-postdom") {
+                FPM.addPass(LlvmPostDomPrinter());
+                return true;
+              }
+              return false;
+            });
       }};
 }
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <utility>
+#include "call_graph.h"
+
+CallGraph build_call_graph(const json &program)
+{
+  CallGraph graph;
+  const json &functions = program["functions"];
+  for (const json &func : functions)
+  {
+    graph.indices[func["name"].get<std::string>()] = graph.names.size();
+    graph.names.push_back(func["name"].get<std::string>());
+  }
+
+  unsigned N = graph.names.size();
+  graph.callees.assign(N, {});
+  for (unsigned f = 0; f < N; f++)
+  {
+    if (!functions[f].contains("instrs"))
+    {
+      continue;
+    }
+    for (const json &instr : functions[f]["instrs"])
+    {
+      if (!instr.contains("op") || instr["op"] != "call" || !instr.contains("funcs"))
+      {
+        continue;
+      }
+      auto it = graph.indices.find(instr["funcs"][0].get<std::string>());
+      std::vector<unsigned> &callees = graph.callees[f];
+      if (it != graph.indices.end() && std::find(callees.begin(), callees.end(), it->second) == callees.end())
+      {
+        callees.push_back(it->second);
+      }
+    }
+  }
+
+  // Tarjan's algorithm, iteratively so deep call chains cannot overflow the stack.  It
+  // completes components callees-first, which is exactly the bottom-up order we want
+  const unsigned UNVISITED = ~0u;
+  std::vector<unsigned> number(N, UNVISITED), lowlink(N, 0);
+  std::vector<bool> on_stack(N, false);
+  std::vector<unsigned> stack;
+  std::vector<std::pair<unsigned, size_t>> frames;
+  unsigned counter = 0;
+  graph.scc_of.assign(N, 0);
+
+  for (unsigned root = 0; root < N; root++)
+  {
+    if (number[root] != UNVISITED)
+    {
+      continue;
+    }
+    frames.push_back({root, 0});
+    number[root] = lowlink[root] = counter++;
+    stack.push_back(root);
+    on_stack[root] = true;
+
+    while (!frames.empty())
+    {
+      auto &[f, next] = frames.back();
+      if (next < graph.callees[f].size())
+      {
+        unsigned callee = graph.callees[f][next++];
+        if (number[callee] == UNVISITED)
+        {
+          number[callee] = lowlink[callee] = counter++;
+          stack.push_back(callee);
+          on_stack[callee] = true;
+          frames.push_back({callee, 0});
+        }
+        else if (on_stack[callee])
+        {
+          lowlink[f] = std::min(lowlink[f], number[callee]);
+        }
+        continue;
+      }
+
+      // f is done: if it is the root of a component, pop the component off the stack
+      unsigned done = f;
+      frames.pop_back();
+      if (!frames.empty())
+      {
+        unsigned parent = frames.back().first;
+        lowlink[parent] = std::min(lowlink[parent], lowlink[done]);
+      }
+      if (lowlink[done] == number[done])
+      {
+        std::vector<unsigned> scc;
+        unsigned member;
+        do
+        {
+          member = stack.back();
+          stack.pop_back();
+          on_stack[member] = false;
+          graph.scc_of[member] = graph.sccs.size();
+          scc.push_back(member);
+        } while (member != done);
+        std::sort(scc.begin(), scc.end());
+        graph.sccs.push_back(std::move(scc));
+      }
+    }
+  }
+
+  return graph;
+}
@@ -0,0 +1,46 @@
+#ifndef CALL_GRAPH_H
+#define CALL_GRAPH_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+/**
+ * @brief Which functions of a Bril program call which, grouped into SCCs.
+ *
+ * Functions are numbered in program order.  Each strongly connected
+ * component is a set of mutually recursive functions (or a single function,
+ * recursive or not), and the components are listed bottom-up: every function
+ * a component calls outside itself is in an earlier component.
+ */
+struct CallGraph {
+  /// Function names in program order, and the reverse mapping.
+  std::vector<std::string> names;
+  std::unordered_map<std::string, unsigned> indices;
+
+  /// Functions each function calls, deduplicated, in order of first call.
+  /// Calls to functions the program does not define are left out.
+  std::vector<std::vector<unsigned>> callees;
+
+  /// Strongly connected components, callees before callers.
+  std::vector<std::vector<unsigned>> sccs;
+
+  /// Index into `sccs` of each function's component.
+  std::vector<unsigned> scc_of;
+
+  /// True if `caller` and `callee` are in the same component, i.e. inlining
+  /// one into the other would never bottom out.
+  bool recursive(unsigned caller, unsigned callee) const { return scc_of[caller] == scc_of[callee]; }
+};
+
+/**
+ * @brief Builds the call graph of a program and finds its SCCs (Tarjan).
+ *
+ * @param program Bril program with a "functions" array.
+ */
+CallGraph build_call_graph(const json& program);
+
+#endif // CALL_GRAPH_H
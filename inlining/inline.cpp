@@ -0,0 +1,72 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "inliner.h"
+
+using json = nlohmann::json;
+
+/*
+ * Usage: inline [-p call_profile.json] [-t threshold] [-v] < program.json
+ *
+ * Reads a Bril program, inlines the calls the cost model in inliner.h picks
+ * and writes the program back out.  The profile is what
+ * `brili --call-profile` writes for a run of the same program; without one,
+ * calls are inlined by callee size and constant arguments alone.  -v
+ * reports every decision on stderr.
+ */
+int main(int argc, char **argv)
+{
+  InlineOptions options;
+  std::unique_ptr<CallProfile> profile;
+  bool verbose = false;
+  for (int k = 1; k < argc; k++)
+  {
+    if (std::strcmp(argv[k], "-p") == 0 && k + 1 < argc)
+    {
+      std::ifstream in(argv[++k]);
+      if (!in)
+      {
+        std::cerr << "inline: cannot open " << argv[k] << "\n";
+        return 1;
+      }
+      profile = std::make_unique<CallProfile>(read_call_profile(in));
+    }
+    else if (std::strcmp(argv[k], "-t") == 0 && k + 1 < argc)
+    {
+      options.threshold = std::stoul(argv[++k]);
+    }
+    else if (std::strcmp(argv[k], "-v") == 0)
+    {
+      verbose = true;
+    }
+    else
+    {
+      std::cerr << "usage: inline [-p call_profile.json] [-t threshold] [-v] < program.json\n";
+      return 1;
+    }
+  }
+
+  // Read JSON input
+  json program;
+  std::cin >> program;
+
+  // Check if "functions" exists and is an array
+  if (!program.contains("functions") || !program["functions"].is_array())
+  {
+    std::cerr << "Error: Expected a 'functions' key with an array of functions.\n";
+    return 1;
+  }
+
+  InlineStats stats = inline_calls(program, profile.get(), options, verbose ? &std::cerr : nullptr);
+  if (verbose)
+  {
+    std::cerr << stats.inlined << " calls inlined, " << stats.too_big << " too big, " << stats.recursive
+              << " recursive\n";
+  }
+
+  std::cout << program.dump(2) << "\n";
+  return 0;
+}
@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "call_graph.h"
+#include "inliner.h"
+
+uint64_t CallProfile::count(const std::string &caller, const std::string &callee) const
+{
+  auto it = counts.find({caller, callee});
+  return it == counts.end() ? 0 : it->second;
+}
+
+CallProfile read_call_profile(std::istream &in)
+{
+  CallProfile profile;
+  json calls = json::parse(in);
+  for (const json &entry : calls)
+  {
+    uint64_t count = entry.at("count").get<uint64_t>();
+    profile.counts[{entry.at("caller").get<std::string>(), entry.at("callee").get<std::string>()}] += count;
+    profile.total += count;
+  }
+  return profile;
+}
+
+namespace
+{
+
+// Instructions that do work, i.e. everything but labels
+size_t body_size(const json &instrs)
+{
+  size_t size = 0;
+  for (const json &instr : instrs)
+  {
+    if (!instr.contains("label"))
+    {
+      size++;
+    }
+  }
+  return size;
+}
+
+// Every variable and label a function mentions, so a prefix can be checked against them
+std::set<std::string> names_in(const json &func)
+{
+  std::set<std::string> names;
+  if (func.contains("args"))
+  {
+    for (const json &arg : func["args"])
+    {
+      names.insert(arg["name"].get<std::string>());
+    }
+  }
+  for (const json &instr : func["instrs"])
+  {
+    if (instr.contains("label"))
+    {
+      names.insert(instr["label"].get<std::string>());
+    }
+    if (instr.contains("dest"))
+    {
+      names.insert(instr["dest"].get<std::string>());
+    }
+    for (const char *field : {"args", "labels"})
+    {
+      if (instr.contains(field))
+      {
+        for (const json &name : instr[field])
+        {
+          names.insert(name.get<std::string>());
+        }
+      }
+    }
+  }
+  return names;
+}
+
+// True if no name is `prefix` itself or starts with `prefix.`
+bool fresh(const std::set<std::string> &names, const std::string &prefix)
+{
+  if (names.count(prefix))
+  {
+    return false;
+  }
+  auto it = names.lower_bound(prefix + ".");
+  return it == names.end() || it->compare(0, prefix.size() + 1, prefix + ".") != 0;
+}
+
+/// Appends a renamed copy of `callee` in place of `call` to `out`, under `prefix`.
+void expand_call(const json &call, const json &callee, const std::string &prefix, json &out)
+{
+  auto rename = [&](const json &name) { return prefix + "." + name.get<std::string>(); };
+
+  // Bind the parameters to the arguments
+  if (callee.contains("args"))
+  {
+    for (size_t k = 0; k < callee["args"].size(); k++)
+    {
+      const json &param = callee["args"][k];
+      out.push_back({{"op", "id"}, {"dest", rename(param["name"])}, {"type", param["type"]},
+                     {"args", {call["args"][k]}}});
+    }
+  }
+
+  const json &body = callee["instrs"];
+  for (size_t i = 0; i < body.size(); i++)
+  {
+    const json &instr = body[i];
+    if (instr.contains("label"))
+    {
+      json copy = instr;
+      copy["label"] = rename(instr["label"]);
+      out.push_back(std::move(copy));
+      continue;
+    }
+    if (instr["op"] == "ret")
+    {
+      if (call.contains("dest") && instr.contains("args") && !instr["args"].empty())
+      {
+        out.push_back({{"op", "id"}, {"dest", call["dest"]}, {"type", call["type"]},
+                       {"args", {rename(instr["args"][0])}}});
+      }
+      // The last instruction falls through to the return label anyway
+      if (i + 1 < body.size())
+      {
+        out.push_back({{"op", "jmp"}, {"labels", {prefix}}});
+      }
+      continue;
+    }
+
+    json copy = instr;
+    if (instr.contains("dest"))
+    {
+      copy["dest"] = rename(instr["dest"]);
+    }
+    for (const char *field : {"args", "labels"})
+    {
+      if (instr.contains(field))
+      {
+        for (size_t k = 0; k < instr[field].size(); k++)
+        {
+          copy[field][k] = rename(instr[field][k]);
+        }
+      }
+    }
+    out.push_back(std::move(copy));
+  }
+
+  // Falling off the end of the callee returns as well
+  out.push_back({{"label", prefix}});
+}
+
+} // namespace
+
+InlineStats inline_calls(json &program, const CallProfile *profile, const InlineOptions &options, std::ostream *log)
+{
+  InlineStats stats;
+  CallGraph graph = build_call_graph(program);
+  json &functions = program["functions"];
+
+  for (const std::vector<unsigned> &scc : graph.sccs)
+  {
+    for (unsigned f : scc)
+    {
+      json &caller = functions[f];
+      if (!caller.contains("instrs"))
+      {
+        continue;
+      }
+      const std::string &caller_name = graph.names[f];
+      const json &instrs = caller["instrs"];
+
+      // Static sites per callee, to split the profile's per-pair counts between them,
+      // and which variables are only ever assigned a constant
+      std::unordered_map<std::string, unsigned> sites;
+      std::unordered_map<std::string, unsigned> defs;
+      std::unordered_map<std::string, bool> const_def;
+      for (const json &instr : instrs)
+      {
+        if (instr.contains("op") && instr["op"] == "call" && instr.contains("funcs"))
+        {
+          sites[instr["funcs"][0].get<std::string>()]++;
+        }
+        if (instr.contains("dest"))
+        {
+          std::string dest = instr["dest"].get<std::string>();
+          defs[dest]++;
+          const_def[dest] = instr["op"] == "const";
+        }
+      }
+      auto is_constant = [&](const std::string &var) {
+        auto it = defs.find(var);
+        return it != defs.end() && it->second == 1 && const_def[var];
+      };
+
+      std::set<std::string> names = names_in(caller);
+      size_t size = body_size(instrs);
+      unsigned copies = 0;
+      json rewritten = json::array();
+
+      for (const json &instr : instrs)
+      {
+        auto target = instr.contains("op") && instr["op"] == "call" && instr.contains("funcs")
+                          ? graph.indices.find(instr["funcs"][0].get<std::string>())
+                          : graph.indices.end();
+        if (target == graph.indices.end() || !functions[target->second].contains("instrs"))
+        {
+          rewritten.push_back(instr);
+          continue;
+        }
+        unsigned c = target->second;
+        const std::string &callee_name = graph.names[c];
+        const json &callee = functions[c];
+        if (graph.recursive(f, c))
+        {
+          stats.recursive++;
+          rewritten.push_back(instr);
+          continue;
+        }
+
+        // Cost model: see InlineOptions
+        size_t callee_size = body_size(callee["instrs"]);
+        size_t nargs = instr.contains("args") ? instr["args"].size() : 0;
+        double limit = options.threshold;
+        for (size_t k = 0; k < nargs && callee.contains("args") && k < callee["args"].size(); k++)
+        {
+          if (!is_constant(instr["args"][k].get<std::string>()))
+          {
+            continue;
+          }
+          const json &param = callee["args"][k]["name"];
+          for (const json &use : callee["instrs"])
+          {
+            if (use.contains("args"))
+            {
+              for (const json &arg : use["args"])
+              {
+                limit += arg == param ? options.const_arg_bonus : 0;
+              }
+            }
+          }
+        }
+        uint64_t site_count = 0;
+        if (profile)
+        {
+          site_count = profile->count(caller_name, callee_name) / sites[callee_name];
+          if (site_count == 0)
+          {
+            limit = std::min(limit, double(nargs + 2));
+          }
+          else if (site_count >= options.hot_fraction * profile->total)
+          {
+            limit *= options.hot_multiplier;
+          }
+        }
+
+        if (callee_size > limit || size + callee_size > options.max_caller_size)
+        {
+          stats.too_big++;
+          if (log)
+          {
+            *log << caller_name << ": not inlining " << callee_name << " (size " << callee_size << ", limit "
+                 << limit << (profile ? ", calls " + std::to_string(site_count) : "") << ")\n";
+          }
+          rewritten.push_back(instr);
+          continue;
+        }
+
+        std::string prefix;
+        do
+        {
+          prefix = callee_name + ".inl" + std::to_string(copies++);
+        } while (!fresh(names, prefix));
+
+        size_t start = rewritten.size();
+        expand_call(instr, callee, prefix, rewritten);
+        // Later prefixes must not clash with the names the copy just brought in
+        names.insert(prefix);
+        for (size_t k = start; k < rewritten.size(); k++)
+        {
+          if (rewritten[k].contains("dest"))
+          {
+            names.insert(rewritten[k]["dest"].get<std::string>());
+          }
+          if (rewritten[k].contains("label"))
+          {
+            names.insert(rewritten[k]["label"].get<std::string>());
+          }
+        }
+        size += callee_size + 1;
+        stats.inlined++;
+        if (log)
+        {
+          *log << caller_name << ": inlined " << callee_name << " as " << prefix << " (size " << callee_size
+               << ", limit " << limit << (profile ? ", calls " + std::to_string(site_count) : "") << ")\n";
+        }
+      }
+
+      caller["instrs"] = std::move(rewritten);
+    }
+  }
+
+  return stats;
+}
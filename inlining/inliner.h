@@ -0,0 +1,87 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <utility>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+/**
+ * @brief Dynamic call counts between pairs of functions.
+ *
+ * What `brili --call-profile` writes: one count per (caller, callee) pair,
+ * summed over all the call sites in the caller that go to that callee.
+ */
+struct CallProfile {
+  std::map<std::pair<std::string, std::string>, uint64_t> counts;
+
+  /// All calls in the run.
+  uint64_t total = 0;
+
+  /// Calls from `caller` to `callee`, 0 if there were none.
+  uint64_t count(const std::string &caller, const std::string &callee) const;
+};
+
+/**
+ * @brief Reads a call profile in the format `brili --call-profile` writes.
+ *
+ * @throws nlohmann::json::exception if the profile is malformed.
+ */
+CallProfile read_call_profile(std::istream &in);
+
+/**
+ * @brief Knobs of the inlining cost model.
+ *
+ * A call site is inlined if the callee's size (its instructions, not
+ * counting labels) is at most a limit.  The limit starts at `threshold`,
+ * grows by `const_arg_bonus` for every use in the callee of a parameter
+ * the call passes a constant to, since those uses are likely to fold, and,
+ * with a profile, is multiplied by `hot_multiplier` at sites that make at
+ * least `hot_fraction` of all calls.  A site the profile saw no calls from
+ * is only inlined if that does not grow the caller, i.e. the callee is no
+ * bigger than the call sequence it replaces.
+ */
+struct InlineOptions {
+  unsigned threshold = 24;
+  unsigned const_arg_bonus = 2;
+  double hot_fraction = 0.01;
+  unsigned hot_multiplier = 4;
+
+  /// Stop inlining into a function once it has grown this big.
+  size_t max_caller_size = 5000;
+};
+
+/// What `inline_calls` did, for reporting.
+struct InlineStats {
+  unsigned inlined = 0;
+  unsigned recursive = 0;
+  unsigned too_big = 0;
+};
+
+/**
+ * @brief Inlines the call sites of a program the cost model picks.
+ *
+ * Functions are visited bottom-up over the call graph's SCCs, so a callee
+ * has already had its own calls inlined by the time it is copied into its
+ * callers, and inlining is transitive without revisiting anything.  Calls
+ * within an SCC (recursion) are left alone.
+ *
+ * Each copy of a callee gets a fresh prefix `<callee>.inl<k>`, chosen so
+ * that no name in the caller equals it or starts with it followed by a dot.
+ * All the callee's variables and labels are renamed under that prefix, the
+ * parameters are bound to the call's arguments with `id`, every `ret`
+ * becomes an `id` into the call's destination and a jump to a label named
+ * after the prefix, which follows the copy.
+ *
+ * @param program Bril program, rewritten in place.
+ * @param profile Call counts to weigh sites by, or nullptr to go by size alone.
+ * @param log Where to describe each decision, or nullptr.
+ */
+InlineStats inline_calls(json &program, const CallProfile *profile, const InlineOptions &options,
+                         std::ostream *log = nullptr);
+
+#endif // INLINER_H
@@ -0,0 +1,61 @@
+/*
+ * Runtime for the instr-looper edge profile; see edge_profile.h.
+ *
+ * Counters are plain globals the instrumented code bumps directly, so all
+ * this file does is remember the modules and print their counters at exit.
+ */
+#include "edge_profile.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct registration
+{
+  const struct edgeprof_module *module;
+  struct registration *next;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct registration *modules;
+
+static void dump(void)
+{
+  pthread_mutex_lock(&lock);
+  const char *path = getenv("EDGEPROF_FILE");
+  FILE *out = fopen(path ? path : "edgeprof.txt", "a");
+  if (!out)
+  {
+    perror("edgeprof");
+    pthread_mutex_unlock(&lock);
+    return;
+  }
+
+  fputs("edgeprof 1\n", out);
+  for (struct registration *r = modules; r; r = r->next)
+  {
+    for (uint64_t f = 0; f < r->module->num_functions; f++)
+    {
+      const struct edgeprof_function *fn = &r->module->functions[f];
+      fprintf(out, "function %s %llu %u\n", fn->name, (unsigned long long)fn->hash, fn->count);
+      for (uint32_t c = 0; c < fn->count; c++)
+        fprintf(out, "%s%llu", c ? " " : "", (unsigned long long)r->module->counters[fn->first + c]);
+      fputc('\n', out);
+    }
+  }
+
+  fclose(out);
+  pthread_mutex_unlock(&lock);
+}
+
+void __edgeprof_register(const struct edgeprof_module *module)
+{
+  pthread_mutex_lock(&lock);
+  if (!modules)
+    atexit(dump);
+  struct registration *r = malloc(sizeof *r);
+  r->module = module;
+  r->next = modules;
+  modules = r;
+  pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,51 @@
+/*
+ * Runtime interface for the edge profile the instr-looper edge pass inserts.
+ *
+ * Each instrumented module carries one array of counters, one per CFG edge
+ * outside the spanning tree the pass chose, and a constant table saying
+ * which of them belong to which function.  A constructor registers the
+ * module; the counts are appended to the profile when the process exits.
+ *
+ * Output goes to $EDGEPROF_FILE (default edgeprof.txt).  Every run appends
+ * a header line "edgeprof 1", then per function:
+ *   function <name> <cfg hash> <n>
+ *   <count 0> ... <count n-1>
+ * The edge-profile-use pass adds up repeated records, so a file collected
+ * over several runs is read as their sum.
+ */
+#ifndef EDGE_PROFILE_H
+#define EDGE_PROFILE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  /** @brief One function's slice of its module's counters. */
+  struct edgeprof_function
+  {
+    const char *name;
+    uint64_t hash;
+    uint32_t first;
+    uint32_t count;
+  };
+
+  /** @brief The functions and counters of one instrumented module. */
+  struct edgeprof_module
+  {
+    const char *name;
+    const struct edgeprof_function *functions;
+    uint64_t num_functions;
+    uint64_t *counters;
+  };
+
+  /** @brief Registers module so its counters are written at exit; run from a constructor. */
+  void __edgeprof_register(const struct edgeprof_module *module);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Runtime for the instr-looper path profile; see path_profile.h.
+ *
+ * Array-mode functions never call in here.  Hash-mode functions do, once per
+ * path taken, and share one lock: they are the rare functions whose path
+ * count is too big for an array, and a program spends little of its time
+ * finishing paths in them compared to walking them.
+ */
+#include "path_profile.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Open addressing, keys stored as path + 1 so that 0 marks a free slot */
+struct table
+{
+  uint64_t capacity;
+  uint64_t used;
+  uint64_t *keys;
+  uint64_t *counts;
+};
+
+struct registration
+{
+  const struct pathprof_module *module;
+  struct registration *next;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct registration *modules;
+
+static uint64_t *slot(struct table *t, uint64_t key)
+{
+  uint64_t i = (key * 0x9E3779B97F4A7C15ull) & (t->capacity - 1);
+  while (t->keys[i] && t->keys[i] != key)
+    i = (i + 1) & (t->capacity - 1);
+  return &t->keys[i];
+}
+
+static void grow(struct table *t)
+{
+  struct table bigger = {t->capacity ? t->capacity * 2 : 1024, t->used, NULL, NULL};
+  bigger.keys = calloc(bigger.capacity, sizeof(uint64_t));
+  bigger.counts = calloc(bigger.capacity, sizeof(uint64_t));
+  for (uint64_t i = 0; i < t->capacity; i++)
+  {
+    if (!t->keys[i])
+      continue;
+    uint64_t *k = slot(&bigger, t->keys[i]);
+    *k = t->keys[i];
+    bigger.counts[k - bigger.keys] = t->counts[i];
+  }
+  free(t->keys);
+  free(t->counts);
+  *t = bigger;
+}
+
+void __pathprof_record(struct pathprof_function *function, uint64_t path)
+{
+  pthread_mutex_lock(&lock);
+  struct table *t = function->table;
+  if (!t)
+    t = function->table = calloc(1, sizeof *t);
+  if (2 * (t->used + 1) > t->capacity)
+    grow(t);
+  uint64_t *k = slot(t, path + 1);
+  if (!*k)
+  {
+    *k = path + 1;
+    t->used++;
+  }
+  t->counts[k - t->keys]++;
+  pthread_mutex_unlock(&lock);
+}
+
+static void dump(void)
+{
+  pthread_mutex_lock(&lock);
+  const char *path = getenv("PATHPROF_FILE");
+  FILE *out = fopen(path ? path : "pathprof.txt", "a");
+  if (!out)
+  {
+    perror("pathprof");
+    pthread_mutex_unlock(&lock);
+    return;
+  }
+
+  fputs("pathprof 1\n", out);
+  for (struct registration *r = modules; r; r = r->next)
+  {
+    for (uint64_t f = 0; f < r->module->num_functions; f++)
+    {
+      const struct pathprof_function *fn = &r->module->functions[f];
+      const struct table *t = fn->table;
+      uint64_t taken = 0;
+      if (fn->counters)
+      {
+        for (uint64_t p = 0; p < fn->num_paths; p++)
+          taken += fn->counters[p] != 0;
+      }
+      else if (t)
+      {
+        taken = t->used;
+      }
+      if (!taken)
+        continue;
+
+      fprintf(out, "function %s %llu %llu %llu\n", fn->name, (unsigned long long)fn->hash,
+              (unsigned long long)fn->num_paths, (unsigned long long)taken);
+      if (fn->counters)
+      {
+        for (uint64_t p = 0; p < fn->num_paths; p++)
+          if (fn->counters[p])
+            fprintf(out, "%llu %llu\n", (unsigned long long)p, (unsigned long long)fn->counters[p]);
+      }
+      else
+      {
+        for (uint64_t i = 0; i < t->capacity; i++)
+          if (t->keys[i])
+            fprintf(out, "%llu %llu\n", (unsigned long long)(t->keys[i] - 1), (unsigned long long)t->counts[i]);
+      }
+    }
+  }
+
+  fclose(out);
+  pthread_mutex_unlock(&lock);
+}
+
+void __pathprof_register(const struct pathprof_module *module)
+{
+  pthread_mutex_lock(&lock);
+  if (!modules)
+    atexit(dump);
+  struct registration *r = malloc(sizeof *r);
+  r->module = module;
+  r->next = modules;
+  modules = r;
+  pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,55 @@
+/*
+ * Runtime interface for the Ball-Larus path profile the instr-looper path
+ * pass inserts.
+ *
+ * Every instrumented function numbers its acyclic paths 0 .. num_paths - 1.
+ * Functions with few enough paths count into an array of num_paths counters
+ * the instrumented code bumps itself; the rest call __pathprof_record, which
+ * keeps a hash table of the paths that actually run.  A constructor registers
+ * each module; the counts are appended to the profile at exit.
+ *
+ * Output goes to $PATHPROF_FILE (default pathprof.txt).  Every run appends
+ * a header line "pathprof 1", then per function with any paths taken:
+ *   function <name> <cfg hash> <num paths> <n>
+ * followed by n lines "<path> <count>".  The path-profile-decode pass turns
+ * the numbers back into block sequences.
+ */
+#ifndef PATH_PROFILE_H
+#define PATH_PROFILE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  /** @brief One function's paths: an array of counters, or a table the runtime owns. */
+  struct pathprof_function
+  {
+    const char *name;
+    uint64_t hash;
+    uint64_t num_paths;
+    uint64_t *counters;
+    void *table;
+  };
+
+  /** @brief The functions of one instrumented module. */
+  struct pathprof_module
+  {
+    const char *name;
+    struct pathprof_function *functions;
+    uint64_t num_functions;
+  };
+
+  /** @brief Registers module so its paths are written at exit; run from a constructor. */
+  void __pathprof_register(const struct pathprof_module *module);
+
+  /** @brief Counts one run of path in a function too big for an array of counters. */
+  void __pathprof_record(struct pathprof_function *function, uint64_t path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
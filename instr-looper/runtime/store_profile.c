@@ -0,0 +1,194 @@
+/*
+ * Runtime for the instr-looper store profile; see store_profile.h.
+ *
+ * The hot path never gets here: instrumented code bumps its own thread-local
+ * counters.  This file only keeps track of which counter arrays exist and
+ * adds them up when their thread, or the whole process, ends.
+ */
+#include "store_profile.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* A module some thread has run, with the counts of threads that have ended */
+struct module_totals
+{
+  const struct storeprof_module *module;
+  uint64_t *totals;
+  struct module_totals *next;
+};
+
+/* One thread's counter array for one module */
+struct attachment
+{
+  struct module_totals *owner;
+  uint64_t *counters;
+  struct attachment *next_in_thread;
+  struct attachment *next_live;
+  struct attachment **prev_live;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_key;
+static struct module_totals *modules;
+static struct attachment *live;
+static int dumped;
+
+static void fold(struct attachment *a)
+{
+  for (uint64_t site = 0; site < a->owner->module->num_sites; site++)
+    a->owner->totals[site] += a->counters[site];
+}
+
+static void unlink_live(struct attachment *a)
+{
+  *a->prev_live = a->next_live;
+  if (a->next_live)
+    a->next_live->prev_live = a->prev_live;
+}
+
+/* pthread key destructor: the thread is ending, its counters are still valid */
+static void thread_exit(void *head)
+{
+  pthread_mutex_lock(&lock);
+  if (dumped)
+  {
+    // The process is already on its way out and has written the profile
+    pthread_mutex_unlock(&lock);
+    return;
+  }
+  for (struct attachment *a = head, *next; a; a = next)
+  {
+    next = a->next_in_thread;
+    fold(a);
+    unlink_live(a);
+    free(a);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+static void write_string(FILE *out, const char *s)
+{
+  uint16_t len = (uint16_t)strlen(s);
+  fwrite(&len, sizeof len, 1, out);
+  fwrite(s, 1, len, out);
+}
+
+static void write_csv_field(FILE *out, const char *s)
+{
+  fputc('"', out);
+  for (; *s; s++)
+  {
+    if (*s == '"')
+      fputc('"', out);
+    fputc(*s, out);
+  }
+  fputc('"', out);
+}
+
+static void dump(void)
+{
+  pthread_mutex_lock(&lock);
+
+  // Threads still running (at least this one) have not been folded yet
+  for (struct attachment *a = live; a; a = a->next_live)
+    fold(a);
+  live = NULL;
+  dumped = 1;
+
+  const char *path = getenv("STOREPROF_FILE");
+  const char *format = getenv("STOREPROF_FORMAT");
+  int binary = format && strcmp(format, "binary") == 0;
+  FILE *out = fopen(path ? path : "storeprof.csv", binary ? "wb" : "w");
+  if (!out)
+  {
+    perror("storeprof");
+    pthread_mutex_unlock(&lock);
+    return;
+  }
+
+  if (binary)
+  {
+    uint64_t records = 0;
+    for (struct module_totals *m = modules; m; m = m->next)
+      records += m->module->num_sites;
+    uint32_t version = 1;
+    fwrite("SPRF", 1, 4, out);
+    fwrite(&version, sizeof version, 1, out);
+    fwrite(&records, sizeof records, 1, out);
+  }
+  else
+  {
+    fputs("module,site,function,line,type,bits,count\n", out);
+  }
+
+  for (struct module_totals *m = modules; m; m = m->next)
+  {
+    for (uint64_t site = 0; site < m->module->num_sites; site++)
+    {
+      const struct storeprof_site *s = &m->module->sites[site];
+      if (binary)
+      {
+        uint32_t fields[3] = {(uint32_t)site, s->line, s->bits};
+        fwrite(&m->totals[site], sizeof(uint64_t), 1, out);
+        fwrite(fields, sizeof fields, 1, out);
+        write_string(out, m->module->name);
+        write_string(out, s->function);
+        write_string(out, s->type);
+      }
+      else
+      {
+        write_csv_field(out, m->module->name);
+        fprintf(out, ",%llu,", (unsigned long long)site);
+        write_csv_field(out, s->function);
+        fprintf(out, ",%u,", s->line);
+        write_csv_field(out, s->type);
+        fprintf(out, ",%u,%llu\n", s->bits, (unsigned long long)m->totals[site]);
+      }
+    }
+  }
+
+  fclose(out);
+  pthread_mutex_unlock(&lock);
+}
+
+static void init(void)
+{
+  pthread_key_create(&thread_key, thread_exit);
+  atexit(dump);
+}
+
+void __storeprof_attach(const struct storeprof_module *module, uint64_t *counters, uint8_t *attached)
+{
+  pthread_once(&once, init);
+
+  pthread_mutex_lock(&lock);
+  struct module_totals *m = modules;
+  while (m && m->module != module)
+    m = m->next;
+  if (!m)
+  {
+    m = malloc(sizeof *m);
+    m->module = module;
+    m->totals = calloc(module->num_sites, sizeof(uint64_t));
+    m->next = modules;
+    modules = m;
+  }
+
+  struct attachment *a = malloc(sizeof *a);
+  a->owner = m;
+  a->counters = counters;
+  a->next_in_thread = pthread_getspecific(thread_key);
+  a->next_live = live;
+  a->prev_live = &live;
+  if (live)
+    live->prev_live = &a->next_live;
+  live = a;
+  pthread_setspecific(thread_key, a);
+  pthread_mutex_unlock(&lock);
+
+  *attached = 1;
+}
@@ -0,0 +1,59 @@
+/*
+ * Runtime interface for the store profile the instr-looper pass inserts.
+ *
+ * Each instrumented module carries a constant table describing its store
+ * sites and a thread-local array of counters, one per site.  The first time
+ * a thread runs an instrumented function of a module it attaches that
+ * thread's counters; they are folded into the module totals when the thread
+ * exits, and everything is written out when the process exits.
+ *
+ * Output goes to $STOREPROF_FILE (default storeprof.csv) in the format named
+ * by $STOREPROF_FORMAT: "csv" (default) or "binary".
+ *
+ * CSV: a header line, then one line per site:
+ *   module,site,function,line,type,bits,count
+ *
+ * Binary, little endian:
+ *   char magic[4] = "SPRF"; uint32 version = 1; uint64 records;
+ *   then per record: uint64 count; uint32 site; uint32 line; uint32 bits;
+ *   then the module, function and type names, each as uint16 length + bytes.
+ */
+#ifndef STORE_PROFILE_H
+#define STORE_PROFILE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  /** @brief A store instruction: where it is and what it writes. */
+  struct storeprof_site
+  {
+    const char *function;
+    const char *type;
+    uint32_t line;
+    uint32_t bits;
+  };
+
+  /** @brief The sites of one instrumented module. */
+  struct storeprof_module
+  {
+    const char *name;
+    const struct storeprof_site *sites;
+    uint64_t num_sites;
+  };
+
+  /**
+   * @brief Hands the calling thread's counters for module to the runtime.
+   *
+   * Called by instrumented code when *attached is still zero; sets it.
+   */
+  void __storeprof_attach(const struct storeprof_module *module, uint64_t *counters, uint8_t *attached);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,383 @@
+#include "EdgeProfile.h"
+#include "ProfileSupport.h"
+
+#include "llvm/ADT/EquivalenceClasses.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/BranchProbabilityInfo.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+using namespace llvm;
+
+namespace looper
+{
+
+    namespace
+    {
+
+        // The CFG as the profile sees it: one node per block plus a virtual exit node,
+        // and one edge per distinct (source, destination) pair.  Edge 0 is the virtual
+        // exit -> entry edge, which closes every path into a cycle
+        struct ProfileCFG
+        {
+            struct Edge
+            {
+                unsigned Src, Dst;
+                uint64_t Weight;
+                bool InTree = false;
+            };
+
+            std::vector<BasicBlock *> Blocks;
+            DenseMap<BasicBlock *, unsigned> Index;
+            std::vector<Edge> Edges;
+            uint64_t Hash = 0;
+
+            unsigned exitNode() const { return Blocks.size(); }
+        };
+
+        ProfileCFG buildCFG(Function &F, BlockFrequencyInfo &BFI, BranchProbabilityInfo &BPI)
+        {
+            ProfileCFG G;
+            for (BasicBlock &B : F)
+            {
+                G.Index[&B] = G.Blocks.size();
+                G.Blocks.push_back(&B);
+            }
+            G.Edges.push_back({G.exitNode(), 0, UINT64_MAX});
+            G.Hash = cfgHash(F);
+
+            for (BasicBlock *B : G.Blocks)
+            {
+                unsigned Src = G.Index[B];
+                uint64_t Freq = BFI.getBlockFreq(B).getFrequency();
+                if (B->getTerminator()->getNumSuccessors() == 0)
+                {
+                    G.Edges.push_back({Src, G.exitNode(), Freq});
+                    continue;
+                }
+                SmallPtrSet<BasicBlock *, 4> Seen;
+                for (BasicBlock *Succ : successors(B))
+                {
+                    if (Seen.insert(Succ).second)
+                    {
+                        G.Edges.push_back({Src, G.Index[Succ], BPI.getEdgeProbability(B, Succ).scale(Freq)});
+                    }
+                }
+            }
+            return G;
+        }
+
+        // Kruskal: heaviest edges first, so the tree holds the hot edges and the counters
+        // end up on the cold ones.  Deterministic, since instrumentation and use must agree
+        void chooseTree(ProfileCFG &G)
+        {
+            std::vector<unsigned> Order(G.Edges.size());
+            std::iota(Order.begin(), Order.end(), 0);
+            std::stable_sort(Order.begin(), Order.end(), [&](unsigned A, unsigned B)
+                             { return G.Edges[A].Weight > G.Edges[B].Weight; });
+            EquivalenceClasses<unsigned> Components;
+            for (unsigned N = 0; N <= G.exitNode(); N++)
+            {
+                Components.insert(N);
+            }
+            for (unsigned E : Order)
+            {
+                auto &Edge = G.Edges[E];
+                if (!Components.isEquivalent(Edge.Src, Edge.Dst))
+                {
+                    Components.unionSets(Edge.Src, Edge.Dst);
+                    Edge.InTree = true;
+                }
+            }
+        }
+
+        // Builds the profile model of F exactly the same way for both passes
+        ProfileCFG modelFunction(Function &F, FunctionAnalysisManager &FAM)
+        {
+            ProfileCFG G = buildCFG(F, FAM.getResult<BlockFrequencyAnalysis>(F),
+                                    FAM.getResult<BranchProbabilityAnalysis>(F));
+            chooseTree(G);
+            return G;
+        }
+
+    } // namespace
+
+    PreservedAnalyses EdgeProfilePass::run(Module &M, ModuleAnalysisManager &AM)
+    {
+        LLVMContext &Ctx = M.getContext();
+        Type *I32 = Type::getInt32Ty(Ctx);
+        Type *I64 = Type::getInt64Ty(Ctx);
+        Type *I8Ptr = Type::getInt8PtrTy(Ctx);
+        FunctionAnalysisManager &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+
+        // Choose every function's counters before touching any CFG
+        struct Placement
+        {
+            Function *F;
+            uint64_t Hash;
+            unsigned First;
+            std::vector<std::pair<BasicBlock *, BasicBlock *>> Edges;
+        };
+        std::vector<Placement> Placements;
+        unsigned NumCounters = 0;
+        for (Function &F : M)
+        {
+            if (!isProfilable(F))
+            {
+                continue;
+            }
+            ProfileCFG G = modelFunction(F, FAM);
+            Placement P{&F, G.Hash, NumCounters, {}};
+            for (const auto &E : G.Edges)
+            {
+                if (!E.InTree)
+                {
+                    P.Edges.push_back({G.Blocks[E.Src], E.Dst == G.exitNode() ? nullptr : G.Blocks[E.Dst]});
+                }
+            }
+            NumCounters += P.Edges.size();
+            Placements.push_back(std::move(P));
+        }
+        if (Placements.empty())
+        {
+            return PreservedAnalyses::all();
+        }
+
+        ArrayType *CountersTy = ArrayType::get(I64, NumCounters);
+        auto *Counters = new GlobalVariable(M, CountersTy, false, GlobalValue::InternalLinkage,
+                                            ConstantAggregateZero::get(CountersTy), "edgeprof.counters");
+
+        // struct edgeprof_function { i8 *name; i64 hash; i32 first, count; }
+        StructType *FuncTy = StructType::create(Ctx, {I8Ptr, I64, I32, I32}, "edgeprof.function");
+        SmallVector<Constant *, 16> Descs;
+        for (Placement &P : Placements)
+        {
+            Descs.push_back(ConstantStruct::get(FuncTy, {makeString(M, P.F->getName(), "edgeprof.str"),
+                                                         ConstantInt::get(I64, P.Hash),
+                                                         ConstantInt::get(I32, P.First),
+                                                         ConstantInt::get(I32, P.Edges.size())}));
+
+            // Plain increments, like gcov: a racing thread may lose the odd count
+            for (size_t K = 0; K < P.Edges.size(); K++)
+            {
+                IRBuilder<> Builder(edgeInsertionPoint(P.Edges[K].first, P.Edges[K].second));
+                Value *Slot = Builder.CreateConstInBoundsGEP2_64(CountersTy, Counters, 0, P.First + K, "edgeprof.slot");
+                Value *Count = Builder.CreateLoad(I64, Slot, "edgeprof.count");
+                Builder.CreateStore(Builder.CreateAdd(Count, ConstantInt::get(I64, 1)), Slot);
+            }
+        }
+        ArrayType *FuncsTy = ArrayType::get(FuncTy, Descs.size());
+        auto *Funcs = new GlobalVariable(M, FuncsTy, true, GlobalValue::PrivateLinkage,
+                                         ConstantArray::get(FuncsTy, Descs), "edgeprof.functions");
+
+        // struct edgeprof_module { i8 *name; edgeprof_function *functions; i64 num_functions; i64 *counters; }
+        StructType *ModuleTy =
+            StructType::create(Ctx, {I8Ptr, Funcs->getType(), I64, PointerType::getUnqual(I64)}, "edgeprof.module");
+        auto *ModuleDesc = new GlobalVariable(
+            M, ModuleTy, true, GlobalValue::PrivateLinkage,
+            ConstantStruct::get(ModuleTy, {makeString(M, M.getModuleIdentifier(), "edgeprof.str"), Funcs,
+                                           ConstantInt::get(I64, Descs.size()),
+                                           ConstantExpr::getInBoundsGetElementPtr(
+                                               CountersTy, Counters,
+                                               ArrayRef<Constant *>{ConstantInt::get(I64, 0), ConstantInt::get(I64, 0)})}),
+            "edgeprof.module");
+
+        // A constructor hands the module to the runtime before main runs
+        FunctionCallee Register = M.getOrInsertFunction(
+            "__edgeprof_register", FunctionType::get(Type::getVoidTy(Ctx), {ModuleDesc->getType()}, false));
+        Function *Ctor = Function::Create(FunctionType::get(Type::getVoidTy(Ctx), false), GlobalValue::InternalLinkage,
+                                          "edgeprof.ctor", M);
+        IRBuilder<> Builder(BasicBlock::Create(Ctx, "entry", Ctor));
+        Builder.CreateCall(Register, {ModuleDesc});
+        Builder.CreateRetVoid();
+        appendToGlobalCtors(M, Ctor, 0);
+
+        return PreservedAnalyses::none();
+    }
+
+    PreservedAnalyses EdgeProfileUsePass::run(Module &M, ModuleAnalysisManager &AM)
+    {
+        auto Buffer = MemoryBuffer::getFile(Path);
+        if (!Buffer)
+        {
+            errs() << "edge-profile-use: cannot read " << Path << ": " << Buffer.getError().message() << "\n";
+            return PreservedAnalyses::all();
+        }
+
+        // Profile text: each run appends "edgeprof 1", then per function
+        // "function <name> <hash> <n>" followed by its n counter values
+        struct Record
+        {
+            uint64_t Hash;
+            std::vector<uint64_t> Counts;
+        };
+        StringMap<Record> Records;
+        SmallVector<StringRef, 0> Words;
+        SplitString((*Buffer)->getBuffer(), Words);
+        for (size_t K = 0; K < Words.size();)
+        {
+            if (Words[K] == "edgeprof" && K + 1 < Words.size() && Words[K + 1] == "1")
+            {
+                K += 2;
+                continue;
+            }
+            Record R;
+            uint64_t N = 0;
+            if (Words[K] != "function" || K + 3 >= Words.size() || Words[K + 2].getAsInteger(10, R.Hash) ||
+                Words[K + 3].getAsInteger(10, N) || K + 4 + N > Words.size())
+            {
+                errs() << "edge-profile-use: " << Path << " is not a valid edge profile\n";
+                return PreservedAnalyses::all();
+            }
+            for (uint64_t C = 0; C < N; C++)
+            {
+                uint64_t V = 0;
+                Words[K + 4 + C].getAsInteger(10, V);
+                R.Counts.push_back(V);
+            }
+            // Runs, and modules that share an inline function, add up
+            auto [It, Inserted] = Records.try_emplace(Words[K + 1], R);
+            if (!Inserted && It->second.Hash == R.Hash && It->second.Counts.size() == N)
+            {
+                for (uint64_t C = 0; C < N; C++)
+                {
+                    It->second.Counts[C] += R.Counts[C];
+                }
+            }
+            K += 4 + N;
+        }
+
+        FunctionAnalysisManager &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+        MDBuilder MDB(M.getContext());
+        bool Changed = false;
+        for (Function &F : M)
+        {
+            auto It = Records.find(F.getName());
+            if (It == Records.end() || !isProfilable(F))
+            {
+                continue;
+            }
+            ProfileCFG G = modelFunction(F, FAM);
+            std::vector<uint64_t> Count(G.Edges.size(), 0);
+            std::vector<bool> Known(G.Edges.size(), false);
+            size_t NextCounter = 0;
+            for (size_t E = 0; E < G.Edges.size(); E++)
+            {
+                if (!G.Edges[E].InTree && NextCounter < It->second.Counts.size())
+                {
+                    Count[E] = It->second.Counts[NextCounter++];
+                    Known[E] = true;
+                }
+            }
+            if (G.Hash != It->second.Hash || NextCounter != It->second.Counts.size() ||
+                std::count(Known.begin(), Known.end(), false) !=
+                    std::count_if(G.Edges.begin(), G.Edges.end(), [](const auto &E) { return E.InTree; }))
+            {
+                errs() << "edge-profile-use: profile for " << F.getName() << " does not match its CFG, skipped\n";
+                continue;
+            }
+
+            // Recover the tree edges: a node with one unknown edge left gets it from
+            // flow conservation (in = out), which the tree guarantees always finishes
+            std::vector<std::vector<unsigned>> In(G.exitNode() + 1), Out(G.exitNode() + 1);
+            for (unsigned E = 0; E < G.Edges.size(); E++)
+            {
+                Out[G.Edges[E].Src].push_back(E);
+                In[G.Edges[E].Dst].push_back(E);
+            }
+            bool Progress = true;
+            while (Progress)
+            {
+                Progress = false;
+                for (unsigned N = 0; N <= G.exitNode(); N++)
+                {
+                    int64_t Balance = 0;
+                    int Unknown = -1, Missing = 0;
+                    bool UnknownIsIn = false;
+                    for (bool Incoming : {true, false})
+                    {
+                        for (unsigned E : Incoming ? In[N] : Out[N])
+                        {
+                            if (Known[E])
+                            {
+                                Balance += Incoming ? Count[E] : -static_cast<int64_t>(Count[E]);
+                            }
+                            else if (Unknown != static_cast<int>(E))
+                            {
+                                Unknown = E;
+                                UnknownIsIn = Incoming;
+                                Missing++;
+                            }
+                        }
+                    }
+                    if (Missing == 1)
+                    {
+                        int64_t Value = UnknownIsIn ? -Balance : Balance;
+                        Count[Unknown] = Value > 0 ? Value : 0;
+                        Known[Unknown] = true;
+                        Progress = true;
+                    }
+                }
+            }
+
+            // Edge 0 is exit -> entry: how often the function ran
+            F.setEntryCount(Function::ProfileCount(Count[0], Function::PCT_Real));
+
+            // Branch weights per successor; a destination reached through several
+            // successor slots puts its whole count on the first
+            DenseMap<std::pair<unsigned, unsigned>, uint64_t> EdgeCount;
+            for (unsigned E = 0; E < G.Edges.size(); E++)
+            {
+                EdgeCount[{G.Edges[E].Src, G.Edges[E].Dst}] = Count[E];
+            }
+            for (BasicBlock *B : G.Blocks)
+            {
+                Instruction *T = B->getTerminator();
+                if (T->getNumSuccessors() < 2 || !(isa<BranchInst>(T) || isa<SwitchInst>(T)))
+                {
+                    continue;
+                }
+                SmallVector<uint64_t, 4> Weights;
+                SmallPtrSet<BasicBlock *, 4> Seen;
+                uint64_t Max = 0;
+                for (BasicBlock *Succ : successors(B))
+                {
+                    uint64_t W = Seen.insert(Succ).second ? EdgeCount[{G.Index[B], G.Index[Succ]}] : 0;
+                    Weights.push_back(W);
+                    Max = std::max(Max, W);
+                }
+                // Branch weights are 32 bits; scale big counts down, keeping their ratios
+                unsigned Shift = 0;
+                while ((Max >> Shift) > UINT32_MAX)
+                {
+                    Shift++;
+                }
+                SmallVector<uint32_t, 4> Weights32;
+                for (uint64_t W : Weights)
+                {
+                    Weights32.push_back(static_cast<uint32_t>(W >> Shift));
+                }
+                T->setMetadata(LLVMContext::MD_prof, MDB.createBranchWeights(Weights32));
+            }
+            Changed = true;
+        }
+
+        if (!Changed)
+        {
+            return PreservedAnalyses::all();
+        }
+        PreservedAnalyses PA;
+        PA.preserveSet<CFGAnalyses>();
+        return PA;
+    }
+
+}
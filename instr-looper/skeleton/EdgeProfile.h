@@ -0,0 +1,38 @@
+#ifndef INSTR_LOOPER_EDGE_PROFILE_H
+#define INSTR_LOOPER_EDGE_PROFILE_H
+
+#include "llvm/IR/PassManager.h"
+
+#include <string>
+
+namespace looper
+{
+
+    /**
+     * Edge profiling with Knuth's counter placement: counters go only on the
+     * edges outside a maximum spanning tree of the CFG (plus a virtual
+     * exit -> entry edge), weighted by estimated frequency so the hot edges
+     * are the ones left uncounted.  The runtime in runtime/edge_profile.c
+     * writes the counts out at exit.
+     */
+    struct EdgeProfilePass : public llvm::PassInfoMixin<EdgeProfilePass>
+    {
+        llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &AM);
+    };
+
+    /**
+     * Reads a profile written by an EdgeProfilePass build of the same code,
+     * recovers the counts of the spanning-tree edges from flow conservation,
+     * and attaches them as branch weights and function entry counts.
+     */
+    struct EdgeProfileUsePass : public llvm::PassInfoMixin<EdgeProfileUsePass>
+    {
+        explicit EdgeProfileUsePass(std::string Path) : Path(std::move(Path)) {}
+        llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &AM);
+
+        std::string Path;
+    };
+
+}
+
+#endif
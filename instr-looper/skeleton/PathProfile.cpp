@@ -0,0 +1,464 @@
+#include "PathProfile.h"
+#include "ProfileSupport.h"
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/CFG.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <vector>
+
+using namespace llvm;
+
+namespace looper
+{
+
+    namespace
+    {
+
+        // Path numbers stay well inside 64 bits, so that adding an edge value never wraps
+        constexpr uint64_t MaxPaths = 1ull << 62;
+
+        // The Ball-Larus DAG: the CFG plus a virtual exit node, with every backedge
+        // v -> w replaced by a pair of dummy edges entry -> w and v -> exit.  An edge's
+        // value is the number of paths leaving its source through earlier edges, so the
+        // values along a path add up to a unique number
+        struct PathDAG
+        {
+            enum class Kind
+            {
+                Real,
+                FromEntry,
+                ToExit
+            };
+            struct Edge
+            {
+                unsigned Src, Dst;
+                Kind K;
+                uint64_t Val = 0;
+            };
+
+            std::vector<BasicBlock *> Blocks;
+            DenseMap<BasicBlock *, unsigned> Index;
+            std::vector<Edge> Edges;
+            std::vector<std::vector<unsigned>> Out;
+            std::vector<uint64_t> NumPaths;
+            SmallVector<std::pair<BasicBlock *, BasicBlock *>, 8> Backedges;
+            DenseMap<unsigned, unsigned> EntryDummy, ExitDummy;
+            uint64_t Hash = 0;
+            bool TooManyPaths = false;
+
+            unsigned exitNode() const { return Blocks.size(); }
+            uint64_t numPaths() const { return NumPaths[0]; }
+        };
+
+        PathDAG buildDAG(Function &F)
+        {
+            PathDAG D;
+            for (BasicBlock &B : F)
+            {
+                D.Index[&B] = D.Blocks.size();
+                D.Blocks.push_back(&B);
+            }
+            D.Hash = cfgHash(F);
+            D.Out.resize(D.Blocks.size() + 1);
+            auto Add = [&](unsigned Src, unsigned Dst, PathDAG::Kind K)
+            {
+                D.Edges.push_back({Src, Dst, K});
+                D.Out[Src].push_back(D.Edges.size() - 1);
+                return D.Edges.size() - 1;
+            };
+
+            // Depth-first backedges; in an irreducible CFG these still leave a DAG
+            SmallVector<std::pair<const BasicBlock *, const BasicBlock *>, 8> Back;
+            FindFunctionBackedges(F, Back);
+            DenseSet<std::pair<const BasicBlock *, const BasicBlock *>> IsBack(Back.begin(), Back.end());
+
+            for (BasicBlock *B : D.Blocks)
+            {
+                unsigned Src = D.Index[B];
+                if (B->getTerminator()->getNumSuccessors() == 0)
+                {
+                    Add(Src, D.exitNode(), PathDAG::Kind::Real);
+                    continue;
+                }
+                SmallPtrSet<BasicBlock *, 4> Seen;
+                for (BasicBlock *Succ : successors(B))
+                {
+                    if (!Seen.insert(Succ).second)
+                    {
+                        continue;
+                    }
+                    unsigned Dst = D.Index[Succ];
+                    if (!IsBack.count({B, Succ}))
+                    {
+                        Add(Src, Dst, PathDAG::Kind::Real);
+                        continue;
+                    }
+                    // Every path into a header after any of its backedges is the same path,
+                    // as is every path out of a latch through any of its backedges
+                    if (!D.EntryDummy.count(Dst))
+                    {
+                        D.EntryDummy[Dst] = Add(0, Dst, PathDAG::Kind::FromEntry);
+                    }
+                    if (!D.ExitDummy.count(Src))
+                    {
+                        D.ExitDummy[Src] = Add(Src, D.exitNode(), PathDAG::Kind::ToExit);
+                    }
+                    D.Backedges.push_back({B, Succ});
+                }
+            }
+
+            // Number the paths in post-order, so every node's successors are done first
+            D.NumPaths.assign(D.Blocks.size() + 1, 0);
+            D.NumPaths[D.exitNode()] = 1;
+            std::vector<bool> Visited(D.Blocks.size() + 1, false);
+            std::vector<std::pair<unsigned, size_t>> Stack{{0, 0}};
+            Visited[0] = true;
+            while (!Stack.empty())
+            {
+                auto &[Node, Next] = Stack.back();
+                if (Next < D.Out[Node].size())
+                {
+                    unsigned Succ = D.Edges[D.Out[Node][Next++]].Dst;
+                    if (!Visited[Succ])
+                    {
+                        Visited[Succ] = true;
+                        Stack.push_back({Succ, 0});
+                    }
+                    continue;
+                }
+                if (Node != D.exitNode())
+                {
+                    uint64_t Sum = 0;
+                    for (unsigned E : D.Out[Node])
+                    {
+                        D.Edges[E].Val = Sum;
+                        Sum += D.NumPaths[D.Edges[E].Dst];
+                        if (Sum > MaxPaths)
+                        {
+                            D.TooManyPaths = true;
+                            Sum = MaxPaths;
+                        }
+                    }
+                    D.NumPaths[Node] = Sum;
+                }
+                Stack.pop_back();
+            }
+            return D;
+        }
+
+        // A path's blocks from its number: at each node take the last edge whose value
+        // still fits in what is left of the number
+        std::vector<BasicBlock *> decodePath(const PathDAG &D, uint64_t Id, bool &FromBackedge, bool &ToBackedge)
+        {
+            std::vector<BasicBlock *> Path{D.Blocks[0]};
+            FromBackedge = ToBackedge = false;
+            for (unsigned Node = 0; Node != D.exitNode();)
+            {
+                const PathDAG::Edge *Taken = nullptr;
+                for (unsigned E : D.Out[Node])
+                {
+                    if (D.Edges[E].Val <= Id)
+                    {
+                        Taken = &D.Edges[E];
+                    }
+                }
+                Id -= Taken->Val;
+                if (Taken->K == PathDAG::Kind::FromEntry)
+                {
+                    Path = {D.Blocks[Taken->Dst]};
+                    FromBackedge = true;
+                }
+                else if (Taken->K == PathDAG::Kind::ToExit)
+                {
+                    ToBackedge = true;
+                }
+                else if (Taken->Dst != D.exitNode())
+                {
+                    Path.push_back(D.Blocks[Taken->Dst]);
+                }
+                Node = Taken->Dst;
+            }
+            return Path;
+        }
+
+        std::string blockName(const BasicBlock *B)
+        {
+            if (B->hasName())
+            {
+                return B->getName().str();
+            }
+            std::string Name;
+            raw_string_ostream OS(Name);
+            B->printAsOperand(OS, false);
+            return OS.str();
+        }
+
+    } // namespace
+
+    PreservedAnalyses PathProfilePass::run(Module &M, ModuleAnalysisManager &AM)
+    {
+        LLVMContext &Ctx = M.getContext();
+        Type *I64 = Type::getInt64Ty(Ctx);
+        Type *I8Ptr = Type::getInt8PtrTy(Ctx);
+
+        // Number every function's paths before any edge is split
+        std::vector<std::pair<Function *, PathDAG>> Functions;
+        for (Function &F : M)
+        {
+            if (!isProfilable(F))
+            {
+                continue;
+            }
+            PathDAG D = buildDAG(F);
+            if (D.TooManyPaths)
+            {
+                errs() << "path-profile: " << F.getName() << " has too many paths to number, skipped\n";
+                continue;
+            }
+            Functions.push_back({&F, std::move(D)});
+        }
+        if (Functions.empty())
+        {
+            return PreservedAnalyses::all();
+        }
+
+        // struct pathprof_function { i8 *name; i64 hash, num_paths; i64 *counters; i8 *table; }
+        // Writable: the runtime hangs a hash-mode function's table off it
+        StructType *FuncTy =
+            StructType::create(Ctx, {I8Ptr, I64, I64, PointerType::getUnqual(I64), I8Ptr}, "pathprof.function");
+        ArrayType *FuncsTy = ArrayType::get(FuncTy, Functions.size());
+        auto *Funcs = new GlobalVariable(M, FuncsTy, false, GlobalValue::InternalLinkage, nullptr,
+                                         "pathprof.functions");
+        FunctionCallee RecordPath = M.getOrInsertFunction(
+            "__pathprof_record", FunctionType::get(Type::getVoidTy(Ctx), {PointerType::getUnqual(FuncTy), I64}, false));
+
+        SmallVector<Constant *, 16> Descs;
+        for (size_t K = 0; K < Functions.size(); K++)
+        {
+            Function &F = *Functions[K].first;
+            const PathDAG &D = Functions[K].second;
+            bool Hashed = D.numPaths() > MaxArrayPaths;
+
+            // One counter per path, or a call into the runtime's table for functions with too many
+            Constant *CounterBase = ConstantPointerNull::get(PointerType::getUnqual(I64));
+            GlobalVariable *Counters = nullptr;
+            ArrayType *CountersTy = ArrayType::get(I64, Hashed ? 0 : D.numPaths());
+            if (!Hashed)
+            {
+                Counters = new GlobalVariable(M, CountersTy, false, GlobalValue::InternalLinkage,
+                                              ConstantAggregateZero::get(CountersTy), "pathprof.counters");
+                CounterBase = ConstantExpr::getInBoundsGetElementPtr(
+                    CountersTy, Counters, ArrayRef<Constant *>{ConstantInt::get(I64, 0), ConstantInt::get(I64, 0)});
+            }
+            Descs.push_back(ConstantStruct::get(FuncTy, {makeString(M, F.getName(), "pathprof.str"),
+                                                         ConstantInt::get(I64, D.Hash),
+                                                         ConstantInt::get(I64, D.numPaths()), CounterBase,
+                                                         ConstantPointerNull::get(cast<PointerType>(I8Ptr))}));
+            Constant *Desc = ConstantExpr::getInBoundsGetElementPtr(
+                FuncsTy, Funcs, ArrayRef<Constant *>{ConstantInt::get(I64, 0), ConstantInt::get(I64, K)});
+
+            auto Count = [&](IRBuilder<> &Builder, Value *Path)
+            {
+                if (Hashed)
+                {
+                    Builder.CreateCall(RecordPath, {Desc, Path});
+                    return;
+                }
+                Value *Slot = Builder.CreateInBoundsGEP(CountersTy, Counters, {ConstantInt::get(I64, 0), Path},
+                                                        "pathprof.slot");
+                Value *Old = Builder.CreateLoad(I64, Slot, "pathprof.count");
+                Builder.CreateStore(Builder.CreateAdd(Old, ConstantInt::get(I64, 1)), Slot);
+            };
+
+            // The path register starts at 0; later passes promote it out of memory
+            IRBuilder<> EntryBuilder(&*F.getEntryBlock().getFirstInsertionPt());
+            AllocaInst *Reg = EntryBuilder.CreateAlloca(I64, nullptr, "pathprof.r");
+            EntryBuilder.CreateStore(ConstantInt::get(I64, 0), Reg);
+            auto Bump = [&](IRBuilder<> &Builder, uint64_t Val)
+            {
+                Value *R = Builder.CreateLoad(I64, Reg, "pathprof.r");
+                return Val ? Builder.CreateAdd(R, ConstantInt::get(I64, Val)) : R;
+            };
+
+            for (const PathDAG::Edge &E : D.Edges)
+            {
+                if (E.K != PathDAG::Kind::Real)
+                {
+                    continue;
+                }
+                BasicBlock *Src = D.Blocks[E.Src];
+                if (E.Dst == D.exitNode())
+                {
+                    // A path ends where the function returns; `unreachable' never gets there
+                    if (isa<ReturnInst>(Src->getTerminator()))
+                    {
+                        IRBuilder<> Builder(Src->getTerminator());
+                        Count(Builder, Bump(Builder, E.Val));
+                    }
+                }
+                else if (E.Val)
+                {
+                    IRBuilder<> Builder(edgeInsertionPoint(Src, D.Blocks[E.Dst]));
+                    Builder.CreateStore(Bump(Builder, E.Val), Reg);
+                }
+            }
+
+            // A backedge ends one path and starts the next at the header
+            for (auto [Latch, Header] : D.Backedges)
+            {
+                IRBuilder<> Builder(edgeInsertionPoint(Latch, Header));
+                Count(Builder, Bump(Builder, D.Edges[D.ExitDummy.lookup(D.Index.lookup(Latch))].Val));
+                Builder.CreateStore(ConstantInt::get(I64, D.Edges[D.EntryDummy.lookup(D.Index.lookup(Header))].Val),
+                                    Reg);
+            }
+        }
+        Funcs->setInitializer(ConstantArray::get(FuncsTy, Descs));
+
+        // struct pathprof_module { i8 *name; pathprof_function *functions; i64 num_functions; }
+        StructType *ModuleTy = StructType::create(Ctx, {I8Ptr, Funcs->getType(), I64}, "pathprof.module");
+        auto *ModuleDesc = new GlobalVariable(
+            M, ModuleTy, true, GlobalValue::PrivateLinkage,
+            ConstantStruct::get(ModuleTy, {makeString(M, M.getModuleIdentifier(), "pathprof.str"), Funcs,
+                                           ConstantInt::get(I64, Descs.size())}),
+            "pathprof.module");
+        FunctionCallee Register = M.getOrInsertFunction(
+            "__pathprof_register", FunctionType::get(Type::getVoidTy(Ctx), {ModuleDesc->getType()}, false));
+        Function *Ctor = Function::Create(FunctionType::get(Type::getVoidTy(Ctx), false), GlobalValue::InternalLinkage,
+                                          "pathprof.ctor", M);
+        IRBuilder<> Builder(BasicBlock::Create(Ctx, "entry", Ctor));
+        Builder.CreateCall(Register, {ModuleDesc});
+        Builder.CreateRetVoid();
+        appendToGlobalCtors(M, Ctor, 0);
+
+        return PreservedAnalyses::none();
+    }
+
+    PreservedAnalyses PathProfileDecodePass::run(Module &M, ModuleAnalysisManager &AM)
+    {
+        auto Buffer = MemoryBuffer::getFile(ProfilePath);
+        if (!Buffer)
+        {
+            errs() << "path-profile-decode: cannot read " << ProfilePath << ": " << Buffer.getError().message() << "\n";
+            return PreservedAnalyses::all();
+        }
+
+        // Profile text: each run appends "pathprof 1", then per function
+        // "function <name> <hash> <paths> <n>" followed by n "<path> <count>" pairs
+        struct Record
+        {
+            uint64_t Hash, NumPaths;
+            std::map<uint64_t, uint64_t> Counts;
+        };
+        StringMap<Record> Records;
+        SmallVector<StringRef, 0> Words;
+        SplitString((*Buffer)->getBuffer(), Words);
+        for (size_t K = 0; K < Words.size();)
+        {
+            if (Words[K] == "pathprof" && K + 1 < Words.size() && Words[K + 1] == "1")
+            {
+                K += 2;
+                continue;
+            }
+            uint64_t Hash = 0, NumPaths = 0, N = 0;
+            if (Words[K] != "function" || K + 4 >= Words.size() || Words[K + 2].getAsInteger(10, Hash) ||
+                Words[K + 3].getAsInteger(10, NumPaths) || Words[K + 4].getAsInteger(10, N) ||
+                K + 5 + 2 * N > Words.size())
+            {
+                errs() << "path-profile-decode: " << ProfilePath << " is not a valid path profile\n";
+                return PreservedAnalyses::all();
+            }
+            auto [It, Inserted] = Records.try_emplace(Words[K + 1], Record{Hash, NumPaths, {}});
+            bool Matches = It->second.Hash == Hash && It->second.NumPaths == NumPaths;
+            for (uint64_t P = 0; P < N; P++)
+            {
+                uint64_t Id = 0, Count = 0;
+                Words[K + 5 + 2 * P].getAsInteger(10, Id);
+                Words[K + 6 + 2 * P].getAsInteger(10, Count);
+                if (Matches)
+                {
+                    It->second.Counts[Id] += Count;
+                }
+            }
+            K += 5 + 2 * N;
+        }
+
+        // The hottest paths of the whole module, most frequent first
+        std::vector<std::tuple<uint64_t, Function *, uint64_t>> Hot;
+        std::map<Function *, PathDAG> DAGs;
+        for (Function &F : M)
+        {
+            auto It = Records.find(F.getName());
+            if (It == Records.end() || !isProfilable(F))
+            {
+                continue;
+            }
+            PathDAG D = buildDAG(F);
+            if (D.TooManyPaths || D.Hash != It->second.Hash || D.numPaths() != It->second.NumPaths)
+            {
+                errs() << "path-profile-decode: profile for " << F.getName() << " does not match its CFG, skipped\n";
+                continue;
+            }
+            for (auto [Id, Count] : It->second.Counts)
+            {
+                if (Id < D.numPaths())
+                {
+                    Hot.emplace_back(Count, &F, Id);
+                }
+            }
+            DAGs.emplace(&F, std::move(D));
+        }
+        std::stable_sort(Hot.begin(), Hot.end(), [](const auto &A, const auto &B)
+                         { return std::get<0>(A) > std::get<0>(B); });
+        if (Hot.size() > Top)
+        {
+            Hot.resize(Top);
+        }
+
+        std::error_code EC;
+        raw_fd_ostream File(TracePath, EC, sys::fs::OF_Text);
+        if (EC)
+        {
+            errs() << "path-profile-decode: cannot write " << TracePath << ": " << EC.message() << "\n";
+            return PreservedAnalyses::all();
+        }
+        json::OStream J(File, 2);
+        J.array([&]
+                {
+                    for (auto &[Count, F, Id] : Hot)
+                    {
+                        bool FromBackedge, ToBackedge;
+                        std::vector<BasicBlock *> Path = decodePath(DAGs.at(F), Id, FromBackedge, ToBackedge);
+                        J.object([&]
+                                 {
+                                     J.attribute("function", F->getName());
+                                     J.attribute("path", static_cast<int64_t>(Id));
+                                     J.attribute("count", static_cast<int64_t>(Count));
+                                     J.attribute("start", FromBackedge ? "backedge" : "entry");
+                                     J.attribute("end", ToBackedge ? "backedge" : "exit");
+                                     J.attributeArray("blocks", [&]
+                                                      {
+                                                          for (BasicBlock *B : Path)
+                                                          {
+                                                              J.value(blockName(B));
+                                                          }
+                                                      });
+                                 });
+                    }
+                });
+        File << "\n";
+
+        return PreservedAnalyses::all();
+    }
+
+}
@@ -0,0 +1,46 @@
+#ifndef INSTR_LOOPER_PATH_PROFILE_H
+#define INSTR_LOOPER_PATH_PROFILE_H
+
+#include "llvm/IR/PassManager.h"
+
+#include <string>
+
+namespace looper
+{
+
+    /**
+     * Ball-Larus path profiling: every acyclic path through a function (loop
+     * backedges cut, so a path ends at a backedge and the next one starts at
+     * its header) gets a number from 0 to NumPaths - 1, built up in a register
+     * by additions on some edges and counted where the path ends.  Functions
+     * with more than MaxArrayPaths paths count into a hash table in the
+     * runtime (runtime/path_profile.c) instead of an array.
+     */
+    struct PathProfilePass : public llvm::PassInfoMixin<PathProfilePass>
+    {
+        explicit PathProfilePass(uint64_t MaxArrayPaths) : MaxArrayPaths(MaxArrayPaths) {}
+        llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &AM);
+
+        uint64_t MaxArrayPaths;
+    };
+
+    /**
+     * Turns the hottest path numbers of a profile back into the block
+     * sequences they stand for and writes them as JSON, one trace per path:
+     * function, path number, count, block names, and whether the path starts
+     * and ends at a loop backedge.  Leaves the module untouched.
+     */
+    struct PathProfileDecodePass : public llvm::PassInfoMixin<PathProfileDecodePass>
+    {
+        PathProfileDecodePass(std::string ProfilePath, std::string TracePath, unsigned Top)
+            : ProfilePath(std::move(ProfilePath)), TracePath(std::move(TracePath)), Top(Top) {}
+        llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &AM);
+
+        std::string ProfilePath;
+        std::string TracePath;
+        unsigned Top;
+    };
+
+}
+
+#endif
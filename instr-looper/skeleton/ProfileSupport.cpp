@@ -0,0 +1,76 @@
+#include "ProfileSupport.h"
+
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+using namespace llvm;
+
+namespace looper
+{
+
+    bool isProfilable(const Function &F)
+    {
+        if (F.isDeclaration())
+        {
+            return false;
+        }
+        for (const BasicBlock &B : F)
+        {
+            const Instruction *T = B.getTerminator();
+            if (B.isEHPad() || isa<IndirectBrInst>(T) || isa<CallBrInst>(T))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint64_t cfgHash(const Function &F)
+    {
+        uint64_t Hash = 1469598103934665603ull;
+        auto Mix = [&](uint64_t V)
+        {
+            Hash = (Hash ^ V) * 1099511628211ull;
+        };
+        DenseMap<const BasicBlock *, unsigned> Index;
+        for (const BasicBlock &B : F)
+        {
+            Index[&B] = Index.size();
+        }
+        Mix(Index.size());
+        for (const BasicBlock &B : F)
+        {
+            Mix(B.getTerminator()->getNumSuccessors());
+            for (const BasicBlock *Succ : successors(&B))
+            {
+                Mix(Index[Succ]);
+            }
+        }
+        return Hash;
+    }
+
+    Constant *makeString(Module &M, StringRef S, const Twine &Name)
+    {
+        Constant *Data = ConstantDataArray::getString(M.getContext(), S);
+        auto *GV = new GlobalVariable(M, Data->getType(), true, GlobalValue::PrivateLinkage, Data, Name);
+        GV->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+        return ConstantExpr::getPointerCast(GV, Type::getInt8PtrTy(M.getContext()));
+    }
+
+    Instruction *edgeInsertionPoint(BasicBlock *Src, BasicBlock *Dst)
+    {
+        if (!Dst || Src->getUniqueSuccessor() == Dst)
+        {
+            return Src->getTerminator();
+        }
+        if (Dst->getUniquePredecessor() == Src)
+        {
+            return &*Dst->getFirstInsertionPt();
+        }
+        BasicBlock *Mid = SplitCriticalEdge(Src, Dst, CriticalEdgeSplittingOptions().setMergeIdenticalEdges());
+        return Mid->getTerminator();
+    }
+
+}
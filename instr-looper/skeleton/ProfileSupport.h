@@ -0,0 +1,28 @@
+#ifndef INSTR_LOOPER_PROFILE_SUPPORT_H
+#define INSTR_LOOPER_PROFILE_SUPPORT_H
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+
+namespace looper
+{
+
+    /** True if F has a body whose edges can all take a counter: no exception pads, no indirect branches. */
+    bool isProfilable(const llvm::Function &F);
+
+    /** FNV-1a over the shape of F's CFG, so a profile is never applied to different code. */
+    uint64_t cfgHash(const llvm::Function &F);
+
+    /** A private constant C string, as an i8* so it fits the runtimes' tables either pointer mode. */
+    llvm::Constant *makeString(llvm::Module &M, llvm::StringRef S, const llvm::Twine &Name);
+
+    /**
+     * Where code for the edge Src -> Dst can go: the end of Src if that is the
+     * only way out of it, the start of Dst if that is the only way in, a new
+     * block splitting the edge otherwise.  A null Dst means leaving the function.
+     */
+    llvm::Instruction *edgeInsertionPoint(llvm::BasicBlock *Src, llvm::BasicBlock *Dst);
+
+}
+
+#endif
@@ -1,47 +1,185 @@
+#include "EdgeProfile.h"
+#include "PathProfile.h"
+#include "ProfileSupport.h"
+
 #include "llvm/Pass.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Scalar/IndVarSimplify.h"
+#include "llvm/Transforms/Scalar/LICM.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 using namespace llvm;
 
+static cl::opt<std::string> Mode(
+    "instr-looper-mode", cl::init("stores"),
+    cl::desc("What the default pipeline instruments: stores, edges, paths, or none"));
+
+static cl::opt<std::string> EdgeProfileUse(
+    "edge-profile-use", cl::init(""), cl::value_desc("file"),
+    cl::desc("Annotate branches with the counts in this edge profile"));
+
+static cl::opt<uint64_t> PathProfileArrayMax(
+    "path-profile-array-max", cl::init(4096), cl::Hidden,
+    cl::desc("Most paths a function may have and still count them in an array rather than a hash table"));
+
+static cl::opt<std::string> PathProfileDecode(
+    "path-profile-decode", cl::init("pathprof.txt"), cl::value_desc("file"),
+    cl::desc("Path profile the path-profile-decode pass reads"));
+
+static cl::opt<std::string> PathProfileTraces(
+    "path-profile-traces", cl::init("-"), cl::value_desc("file"),
+    cl::desc("Where path-profile-decode writes the hot paths as JSON"));
+
+static cl::opt<unsigned> PathProfileTop(
+    "path-profile-top", cl::init(10),
+    cl::desc("How many of the hottest paths path-profile-decode writes"));
+
 namespace
 {
 
+    // Counters are padded out to whole cache lines so a thread's block never shares one
+    constexpr unsigned CacheLine = 64;
+
+    /**
+     * Instruments every store with a counter bump.  Counters live in a
+     * thread-local array, one slot per store site; a constant table next to
+     * it records each site's function, line, stored type and width.  The first
+     * instrumented function a thread runs hands its array to the runtime in
+     * runtime/store_profile.c, which sums the threads and writes the profile
+     * at exit.  Layouts must match runtime/store_profile.h.
+     */
     struct SkeletonPass : public PassInfoMixin<SkeletonPass>
     {
         PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM)
         {
+            LLVMContext &Ctx = M.getContext();
+            const DataLayout &DL = M.getDataLayout();
+            Type *I8 = Type::getInt8Ty(Ctx);
+            Type *I32 = Type::getInt32Ty(Ctx);
+            Type *I64 = Type::getInt64Ty(Ctx);
+            Type *I8Ptr = Type::getInt8PtrTy(Ctx);
+
+            // Collect the store sites first, so the counter updates added below are not counted
+            SmallVector<StoreInst *, 64> Stores;
+            SmallVector<Function *, 16> Functions;
             for (auto &F : M)
             {
+                if (F.isDeclaration())
+                {
+                    continue;
+                }
+                size_t Before = Stores.size();
                 for (auto &B : F)
                 {
                     for (auto &I : B)
                     {
                         // Check if the instruction is a store instruction
-                        if (I.getOpcode() == llvm::Instruction::Store)
+                        if (auto *SI = dyn_cast<StoreInst>(&I))
                         {
-                            // Cast the instruction to a store instruction to execute more specific methods
-                            StoreInst &SI = cast<StoreInst>(I);
+                            Stores.push_back(SI);
+                        }
+                    }
+                }
+                if (Stores.size() != Before)
+                {
+                    Functions.push_back(&F);
+                }
+            }
+            if (Stores.empty())
+            {
+                return PreservedAnalyses::all();
+            }
 
-                            // Get the value being stored
-                            Value *val = SI.getValueOperand();
+            // Describe each site: struct storeprof_site { i8 *function, *type; i32 line, bits; }
+            StructType *SiteTy = StructType::create(Ctx, {I8Ptr, I8Ptr, I32, I32}, "storeprof.site");
+            StringMap<Constant *> Strings;
+            auto Intern = [&](StringRef S)
+            {
+                Constant *&C = Strings[S];
+                if (!C)
+                {
+                    C = looper::makeString(M, S, "storeprof.str");
+                }
+                return C;
+            };
+            SmallVector<Constant *, 64> Sites;
+            for (StoreInst *SI : Stores)
+            {
+                // Get the type of the value being stored, and its width
+                Type *Typ = SI->getValueOperand()->getType();
+                std::string TypeName;
+                raw_string_ostream OS(TypeName);
+                Typ->print(OS);
+                unsigned Line = SI->getDebugLoc() ? SI->getDebugLoc().getLine() : 0;
+                Sites.push_back(ConstantStruct::get(
+                    SiteTy, {Intern(SI->getFunction()->getName()), Intern(OS.str()), ConstantInt::get(I32, Line),
+                             ConstantInt::get(I32, DL.getTypeStoreSizeInBits(Typ).getFixedSize())}));
+            }
+            ArrayType *SitesTy = ArrayType::get(SiteTy, Sites.size());
+            auto *SiteTable = new GlobalVariable(M, SitesTy, true, GlobalValue::PrivateLinkage,
+                                                 ConstantArray::get(SitesTy, Sites), "storeprof.sites");
 
-                            // Get the type of the value being stored
-                            Type *typ = val->getType();
+            // struct storeprof_module { i8 *name; storeprof_site *sites; i64 num_sites; }
+            StructType *ModuleTy = StructType::create(Ctx, {I8Ptr, SiteTable->getType(), I64}, "storeprof.module");
+            auto *ModuleDesc = new GlobalVariable(
+                M, ModuleTy, true, GlobalValue::PrivateLinkage,
+                ConstantStruct::get(ModuleTy, {looper::makeString(M, M.getModuleIdentifier(), "storeprof.name"),
+                                               SiteTable, ConstantInt::get(I64, Sites.size())}),
+                "storeprof.module");
 
-                            // Print the type to output
-                            typ->print(errs());
+            // This thread's counters, and whether the runtime has them yet
+            uint64_t Slots = alignTo(Sites.size(), CacheLine / sizeof(uint64_t));
+            ArrayType *CountersTy = ArrayType::get(I64, Slots);
+            auto *Counters = new GlobalVariable(M, CountersTy, false, GlobalValue::InternalLinkage,
+                                                ConstantAggregateZero::get(CountersTy), "storeprof.counters",
+                                                nullptr, GlobalValue::GeneralDynamicTLSModel);
+            Counters->setAlignment(Align(CacheLine));
+            auto *Attached = new GlobalVariable(M, I8, false, GlobalValue::InternalLinkage, ConstantInt::get(I8, 0),
+                                                "storeprof.attached", nullptr, GlobalValue::GeneralDynamicTLSModel);
 
-                            // Flush the output
-                            llvm::errs() << "\n";
-                        }
-                    }
+            // void __storeprof_attach(const storeprof_module *, uint64_t *counters, uint8_t *attached)
+            FunctionCallee Attach = M.getOrInsertFunction(
+                "__storeprof_attach", FunctionType::get(Type::getVoidTy(Ctx),
+                                                        {ModuleDesc->getType(), PointerType::getUnqual(I64),
+                                                         Attached->getType()},
+                                                        false));
+
+            // Every function with stores makes sure its thread is attached on entry:
+            // one thread-local load and a branch per call, the call itself once per thread
+            for (Function *F : Functions)
+            {
+                // After the allocas, so they stay static allocas of the entry block
+                BasicBlock::iterator Entry = F->getEntryBlock().getFirstInsertionPt();
+                while (isa<AllocaInst>(*Entry))
+                {
+                    ++Entry;
                 }
-                // errs() << "I saw a function called " << F.getName() << "!\n";
+                IRBuilder<> Builder(&*Entry);
+                Value *IsAttached = Builder.CreateLoad(I8, Attached, "storeprof.attached");
+                Value *NeedsAttach = Builder.CreateICmpEQ(IsAttached, ConstantInt::get(I8, 0));
+                Instruction *Then = SplitBlockAndInsertIfThen(NeedsAttach, &*Entry, false);
+                IRBuilder<> AttachBuilder(Then);
+                AttachBuilder.CreateCall(Attach, {ModuleDesc,
+                                                  AttachBuilder.CreateConstInBoundsGEP2_64(CountersTy, Counters, 0, 0),
+                                                  Attached});
+            }
+
+            // Bump the site's counter right before each store; plain loads and stores, the
+            // array belongs to this thread alone
+            for (size_t Site = 0; Site < Stores.size(); Site++)
+            {
+                IRBuilder<> Builder(Stores[Site]);
+                Value *Slot = Builder.CreateConstInBoundsGEP2_64(CountersTy, Counters, 0, Site, "storeprof.slot");
+                Value *Count = Builder.CreateLoad(I64, Slot, "storeprof.count");
+                Builder.CreateStore(Builder.CreateAdd(Count, ConstantInt::get(I64, 1)), Slot);
             }
-            return PreservedAnalyses::all();
+
+            return PreservedAnalyses::none();
         };
     };
 
@@ -56,10 +194,79 @@ llvmGetPassPluginInfo()
         .PluginVersion = "v0.1",
         .RegisterPassBuilderCallbacks = [](PassBuilder &PB)
         {
-            PB.registerPipelineStartEPCallback(
+            // Instrument the optimized module, so the profile counts the stores that
+            // actually run and the counters do not get in the optimizer's way.  Then keep
+            // loop counters in registers (LICM) and fold them into one add of the trip
+            // count at the exit (IndVarSimplify), which leaves loops nearly as fast as before
+            PB.registerOptimizerLastEPCallback(
                 [](ModulePassManager &MPM, OptimizationLevel Level)
                 {
+                    if (Mode != "stores")
+                    {
+                        return;
+                    }
                     MPM.addPass(SkeletonPass());
+                    if (Level != OptimizationLevel::O0)
+                    {
+                        FunctionPassManager FPM;
+                        FPM.addPass(createFunctionToLoopPassAdaptor(LICMPass(), /*UseMemorySSA=*/true));
+                        FPM.addPass(createFunctionToLoopPassAdaptor(IndVarSimplifyPass()));
+                        MPM.addPass(createModuleToFunctionPassAdaptor(std::move(FPM)));
+                    }
+                });
+
+            // Edges are counted, and their counts read back, on the unoptimized module:
+            // both builds see the same CFG there, and the optimizer gets to use the weights.
+            // Paths likewise, where the blocks still carry the source's labels
+            PB.registerPipelineStartEPCallback(
+                [](ModulePassManager &MPM, OptimizationLevel Level)
+                {
+                    if (!EdgeProfileUse.empty())
+                    {
+                        MPM.addPass(looper::EdgeProfileUsePass(EdgeProfileUse));
+                    }
+                    else if (Mode == "edges")
+                    {
+                        MPM.addPass(looper::EdgeProfilePass());
+                    }
+                    else if (Mode == "paths")
+                    {
+                        MPM.addPass(looper::PathProfilePass(PathProfileArrayMax));
+                    }
+                });
+
+            // Teach 'opt -passes="store-profile"' (and the edge and path profile passes) about the passes as well
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name,
+                   ModulePassManager &MPM,
+                   ArrayRef<PassBuilder::PipelineElement> /*unused*/)
+                {
+                    if (Name == "store-profile")
+                    {
+                        MPM.addPass(SkeletonPass());
+                        return true;
+                    }
+                    if (Name == "edge-profile")
+                    {
+                        MPM.addPass(looper::EdgeProfilePass());
+                        return true;
+                    }
+                    if (Name == "edge-profile-use")
+                    {
+                        MPM.addPass(looper::EdgeProfileUsePass(EdgeProfileUse));
+                        return true;
+                    }
+                    if (Name == "path-profile")
+                    {
+                        MPM.addPass(looper::PathProfilePass(PathProfileArrayMax));
+                        return true;
+                    }
+                    if (Name == "path-profile-decode")
+                    {
+                        MPM.addPass(looper::PathProfileDecodePass(PathProfileDecode, PathProfileTraces, PathProfileTop));
+                        return true;
+                    }
+                    return false;
                 });
         }};
 }
@@ -0,0 +1,152 @@
+/*
+ * Loop kernels for measuring IVEPass against plain -O2.
+ *
+ * Each kernel runs over buffers reached through pointer arguments, the case
+ * IVEPass rewrites, and is timed over several repetitions.  The checksum
+ * line lets run.sh check that both builds compute the same thing.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define N 4096
+#define W 512
+#define H 512
+#define K 3
+#define REPS 50
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+__attribute__((noinline)) void saxpy(int *restrict x, int *restrict y, int a, long n)
+{
+  for (long i = 0; i < n; i++)
+    y[i] += a * x[i];
+}
+
+__attribute__((noinline)) void strided(int *restrict dst, const int *restrict src, long n)
+{
+  for (long i = 0; i < n; i++)
+    dst[i] = src[3 * i] + src[3 * i + 2];
+}
+
+// The step is only known at run time and may be zero, so the exit test must not be rewritten
+__attribute__((noinline)) long gather(const int *restrict src, long n, long stride)
+{
+  long sum = 0;
+  for (long i = 0; i < n; i++)
+    sum += src[i * stride];
+  return sum;
+}
+
+__attribute__((noinline)) void bytes(unsigned char *restrict dst, const unsigned char *restrict src, long n)
+{
+  for (long i = 0; i < n; i++)
+    dst[i] = (unsigned char)(src[i] ^ 0x5a);
+}
+
+__attribute__((noinline)) void convolve(int *restrict out, const int *restrict in, const int *restrict kernel,
+                                        long h, long w)
+{
+  for (long i = 0; i + K <= h; i++)
+    for (long j = 0; j + K <= w; j++)
+    {
+      int sum = 0;
+      for (long ki = 0; ki < K; ki++)
+        for (long kj = 0; kj < K; kj++)
+          sum += in[(i + ki) * w + (j + kj)] * kernel[ki * K + kj];
+      out[i * w + j] = sum;
+    }
+}
+
+__attribute__((noinline)) void matmul(int *restrict c, const int *restrict a, const int *restrict b, long n)
+{
+  for (long i = 0; i < n; i++)
+    for (long k = 0; k < n; k++)
+      for (long j = 0; j < n; j++)
+        c[i * n + j] += a[i * n + k] * b[k * n + j];
+}
+
+static uint64_t checksum(const void *buf, size_t size)
+{
+  const unsigned char *p = buf;
+  uint64_t h = 1469598103934665603ull;
+  for (size_t i = 0; i < size; i++)
+    h = (h ^ p[i]) * 1099511628211ull;
+  return h;
+}
+
+int main(void)
+{
+  int *x = malloc(3 * N * sizeof(int)), *y = malloc(N * sizeof(int));
+  unsigned char *b1 = malloc(N), *b2 = malloc(N);
+  int *img = malloc(H * W * sizeof(int)), *out = calloc(H * W, sizeof(int));
+  int kernel[K * K] = {1, 2, 1, 2, 4, 2, 1, 2, 1};
+  long m = 128;
+  int *ma = malloc(m * m * sizeof(int)), *mb = malloc(m * m * sizeof(int)), *mc = calloc(m * m, sizeof(int));
+
+  for (long i = 0; i < 3 * N; i++)
+    x[i] = (int)(i * 7 % 13);
+  for (long i = 0; i < N; i++)
+  {
+    y[i] = (int)i;
+    b1[i] = (unsigned char)i;
+  }
+  for (long i = 0; i < H * W; i++)
+    img[i] = (int)(i % 251);
+  for (long i = 0; i < m * m; i++)
+  {
+    ma[i] = (int)(i % 17);
+    mb[i] = (int)(i % 19);
+  }
+
+  double t;
+  uint64_t sum = 0;
+
+  t = now();
+  for (int r = 0; r < REPS * 100; r++)
+    saxpy(x, y, 3, N);
+  printf("saxpy    %10.3f ms\n", (now() - t) * 1e3);
+  sum ^= checksum(y, N * sizeof(int));
+
+  t = now();
+  for (int r = 0; r < REPS * 100; r++)
+    strided(y, x, N);
+  printf("strided  %10.3f ms\n", (now() - t) * 1e3);
+  sum ^= checksum(y, N * sizeof(int));
+
+  t = now();
+  long gathered = 0;
+  for (int r = 0; r < REPS * 100; r++)
+    gathered += gather(x, N, r % 3);
+  printf("gather   %10.3f ms\n", (now() - t) * 1e3);
+  sum ^= (uint64_t)gathered;
+
+  t = now();
+  for (int r = 0; r < REPS * 100; r++)
+    bytes(b2, b1, N);
+  printf("bytes    %10.3f ms\n", (now() - t) * 1e3);
+  sum ^= checksum(b2, N);
+
+  t = now();
+  for (int r = 0; r < REPS; r++)
+    convolve(out, img, kernel, H, W);
+  printf("convolve %10.3f ms\n", (now() - t) * 1e3);
+  sum ^= checksum(out, H * W * sizeof(int));
+
+  t = now();
+  for (int r = 0; r < REPS / 10; r++)
+    matmul(mc, ma, mb, m);
+  printf("matmul   %10.3f ms\n", (now() - t) * 1e3);
+  sum ^= checksum(mc, m * m * sizeof(int));
+
+  printf("checksum %016llx\n", (unsigned long long)sum);
+
+  free(x); free(y); free(b1); free(b2); free(img); free(out); free(ma); free(mb); free(mc);
+  return 0;
+}
@@ -0,0 +1,18 @@
+#!/bin/sh
+# Builds kernels.c with plain -O2 and with -O2 plus IVEPass, then runs both.
+# Usage: ./run.sh [path/to/SkeletonPass.so]
+set -e
+cd "$(dirname "$0")"
+PLUGIN=${1:-../llvm-pass-skeleton/build/skeleton/SkeletonPass.so}
+CC=${CC:-clang}
+
+$CC -O2 kernels.c -o kernels.O2
+$CC -O2 -fpass-plugin="$PLUGIN" kernels.c -o kernels.ive
+
+echo "== -O2"
+./kernels.O2
+echo "== -O2 + ive-pass"
+./kernels.ive
+
+# Both builds must agree
+[ "$(./kernels.O2 | grep checksum)" = "$(./kernels.ive | grep checksum)" ] || { echo "checksum mismatch" >&2; exit 1; }
@@ -1,16 +1,266 @@
 #include "llvm/Pass.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Transforms/Scalar/LoopPassManager.h"
+#include "llvm/Transforms/Utils/Local.h"
 #include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
 
+#define DEBUG_TYPE "ive-pass"
+
 using namespace llvm;
 
 namespace
 {
 
+    // True if I is what a header phi of L receives from the latch, i.e. the
+    // update of an existing induction variable; reducing it would only add a copy
+    bool isBasicIncrement(const Instruction &I, const Loop &L)
+    {
+        BasicBlock *Latch = L.getLoopLatch();
+        for (const PHINode &Phi : L.getHeader()->phis())
+        {
+            if (Phi.getIncomingValueForBlock(Latch) == &I)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Instructions worth replacing by their own induction variable: address
+    // computations of any shape (array, byte-offset or multi-index GEPs over
+    // globals, allocas, arguments or heap pointers) and integer multiplies
+    bool isReducible(const Instruction &I)
+    {
+        if (isa<GetElementPtrInst>(I))
+        {
+            return true;
+        }
+        return I.getType()->isIntegerTy() &&
+               (I.getOpcode() == Instruction::Mul || I.getOpcode() == Instruction::Shl);
+    }
+
+    // Number of in-loop instructions that die along with I: operands whose only use is I,
+    // then their operands, and so on.  Phis are left alone, they are loop-carried
+    unsigned countDyingOperands(const Instruction &I, const Loop &L)
+    {
+        unsigned Count = 0;
+        SmallVector<const Instruction *, 8> Work{&I};
+        while (!Work.empty())
+        {
+            const Instruction *Cur = Work.pop_back_val();
+            for (const Value *Op : Cur->operands())
+            {
+                auto *OpI = dyn_cast<Instruction>(Op);
+                if (OpI && !isa<PHINode>(OpI) && L.contains(OpI) && OpI->hasOneUse())
+                {
+                    Count++;
+                    Work.push_back(OpI);
+                }
+            }
+        }
+        return Count;
+    }
+
+    // True if every use of GEP is a load or store that can fold it into its addressing
+    // mode as base register + Step * counter, so computing the address costs nothing
+    bool foldsIntoAddressing(const GetElementPtrInst &GEP, const SCEV *Step, const TargetTransformInfo &TTI)
+    {
+        auto *C = dyn_cast<SCEVConstant>(Step);
+        if (!C || C->getAPInt().getMinSignedBits() > 64 || GEP.user_empty())
+        {
+            return false;
+        }
+        int64_t Scale = C->getAPInt().getSExtValue();
+        for (const User *U : GEP.users())
+        {
+            Type *AccessTy = nullptr;
+            if (auto *Load = dyn_cast<LoadInst>(U))
+            {
+                AccessTy = Load->getType();
+            }
+            else if (auto *Store = dyn_cast<StoreInst>(U))
+            {
+                AccessTy = Store->getPointerOperand() == &GEP ? Store->getValueOperand()->getType() : nullptr;
+            }
+            if (!AccessTy || !TTI.isLegalAddressingMode(AccessTy, nullptr, 0, true, Scale, GEP.getAddressSpace()))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Work saved per iteration by replacing I with its own induction
+     * variable, which in turn costs one add and one register.  I itself is
+     * saved unless it is free anyway (an address the memory operations fold,
+     * or a multiply no dearer than an add), plus whatever computed it and
+     * has no other use.
+     */
+    unsigned reductionBenefit(const Instruction &I, const SCEVAddRecExpr &Expr, const Loop &L,
+                              ScalarEvolution &SE, const TargetTransformInfo &TTI)
+    {
+        unsigned Saved = countDyingOperands(I, L);
+        if (auto *GEP = dyn_cast<GetElementPtrInst>(&I))
+        {
+            Saved += !foldsIntoAddressing(*GEP, Expr.getStepRecurrence(SE), TTI);
+        }
+        else
+        {
+            Saved += TTI.getInstructionCost(&I, TargetTransformInfo::TCK_SizeAndLatency) >
+                     TargetTransformInfo::TCC_Basic;
+        }
+        return Saved;
+    }
+
+    // If V is one of L's header phis or the value that phi receives from the latch, that phi
+    PHINode *getHeaderPhi(Value *V, const Loop &L)
+    {
+        BasicBlock *Latch = L.getLoopLatch();
+        for (PHINode &Phi : L.getHeader()->phis())
+        {
+            if (&Phi == V || Phi.getIncomingValueForBlock(Latch) == V)
+            {
+                return &Phi;
+            }
+        }
+        return nullptr;
+    }
+
+    // True if the exit test Cmp is all that keeps the induction variable Phi and its increment alive
+    bool onlyFeedsExitTest(PHINode *Phi, const Instruction *Cmp, const Loop &L)
+    {
+        auto *Inc = dyn_cast<Instruction>(Phi->getIncomingValueForBlock(L.getLoopLatch()));
+        if (!Inc)
+        {
+            return false;
+        }
+        for (User *U : Phi->users())
+        {
+            if (U != Inc && U != Cmp)
+            {
+                return false;
+            }
+        }
+        for (User *U : Inc->users())
+        {
+            if (U != Phi && U != Cmp)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // An induction variable created by the pass: its header phi, its latch update, and its recurrence
+    struct NewIV
+    {
+        WeakTrackingVH Phi;
+        WeakTrackingVH Next;
+        const SCEVAddRecExpr *Expr;
+    };
+
+    /**
+     * Linear function test replacement: rewrite L's exit test to compare IV
+     * against its value on the exiting iteration, computed from the trip
+     * count, so the induction variable the test used to read dies.
+     *
+     * With BackedgeTaken = n, the loop leaves through its only exiting block
+     * on iteration n, when the phi holds Start + n*Step, or Start + (n+1)*Step
+     * once the latch has incremented it.
+     */
+    bool replaceExitTest(Loop &L, ScalarEvolution &SE, SCEVExpander &Expander, const SCEV *BackedgeTaken,
+                         const NewIV &IV)
+    {
+        BasicBlock *Exiting = L.getExitingBlock();
+        if (!Exiting || isa<SCEVCouldNotCompute>(BackedgeTaken))
+        {
+            return false;
+        }
+        auto *BI = dyn_cast<BranchInst>(Exiting->getTerminator());
+        if (!BI || !BI->isConditional())
+        {
+            return false;
+        }
+        auto *Cmp = dyn_cast<ICmpInst>(BI->getCondition());
+        if (!Cmp || !Cmp->hasOneUse() || !L.contains(Cmp))
+        {
+            return false;
+        }
+
+        // Only worth it if the old induction variable has no other use
+        PHINode *OldPhi = nullptr;
+        for (Value *Op : Cmp->operands())
+        {
+            if ((OldPhi = getHeaderPhi(Op, L)))
+            {
+                break;
+            }
+        }
+        auto *Phi = cast_or_null<PHINode>(IV.Phi);
+        Value *Next = IV.Next;
+        if (!OldPhi || OldPhi == Phi || !Phi || !Next || !onlyFeedsExitTest(OldPhi, Cmp, L))
+        {
+            return false;
+        }
+
+        // An equality test is only exact if the new variable cannot wrap before the exit;
+        // address arithmetic cannot, other integers need SCEV to know it
+        const SCEV *Step = IV.Expr->getStepRecurrence(SE);
+        if (!Phi->getType()->isPointerTy() && !IV.Expr->hasNoSelfWrap())
+        {
+            return false;
+        }
+        // A step of zero at run time would make the limit equal the start and end the loop
+        // after one iteration, so the step must be provably nonzero (as IndVarSimplify requires)
+        if (!SE.isKnownNonZero(Step))
+        {
+            return false;
+        }
+        if (SE.getTypeSizeInBits(BackedgeTaken->getType()) > SE.getTypeSizeInBits(Step->getType()))
+        {
+            return false;
+        }
+
+        const SCEV *Count = SE.getNoopOrZeroExtend(BackedgeTaken, Step->getType());
+        Value *Tested = Phi;
+        if (Exiting == L.getLoopLatch())
+        {
+            Count = SE.getAddExpr(Count, SE.getOne(Step->getType()));
+            Tested = Next;
+        }
+        const SCEV *Limit = SE.getAddExpr(IV.Expr->getStart(), SE.getMulExpr(Count, Step));
+        // SCEVExpander would emit a division by a possibly zero value unguarded
+        if (!isSafeToExpand(Limit, SE))
+        {
+            return false;
+        }
+
+        Value *LimitVal = Expander.expandCodeFor(Limit, Phi->getType(), L.getLoopPreheader()->getTerminator());
+
+        // Stay in the loop while the variable has not reached the limit
+        IRBuilder<> Builder(BI);
+        CmpInst::Predicate Pred = L.contains(BI->getSuccessor(0)) ? ICmpInst::ICMP_NE : ICmpInst::ICMP_EQ;
+        BI->setCondition(Builder.CreateICmp(Pred, Tested, LimitVal, "ive.exitcond"));
+
+        LLVM_DEBUG(dbgs() << "IVEPass: exit test now compares against " << *Limit << "\n");
+
+        // Delete the old test, then the old induction variable and its increment
+        auto Forget = [&](Value *V) { SE.forgetValue(V); };
+        RecursivelyDeleteTriviallyDeadInstructions(Cmp, nullptr, nullptr, Forget);
+        SE.forgetValue(OldPhi->getIncomingValueForBlock(L.getLoopLatch()));
+        SE.forgetValue(OldPhi);
+        RecursivelyDeleteDeadPHINode(OldPhi);
+        return true;
+    }
+
     struct IVEPass : public PassInfoMixin<IVEPass>
     {
         static StringRef name() { return "ive-pass"; }
@@ -20,6 +270,7 @@ namespace
 
             // Grab everything I need to perform IVE
             ScalarEvolution &SE = AR.SE;
+            const TargetTransformInfo &TTI = AR.TTI;
 
             // Ensure loop is in a valid state
             BasicBlock *Preheader = L.getLoopPreheader();
@@ -27,56 +278,74 @@ namespace
             BasicBlock *Latch = L.getLoopLatch();
             if (!Preheader || !Header || !Latch)
             {
-                errs() << "Missing preheader, header, or latch\n";
+                LLVM_DEBUG(dbgs() << "Missing preheader, header, or latch\n");
                 return PreservedAnalyses::all();
             }
 
-
-
             struct IVJob
             {
                 const SCEVAddRecExpr *Expr;
-                Instruction *OldInst;
+                WeakTrackingVH OldInst;
+                unsigned Benefit;
+                unsigned Order;
             };
 
             // Initialize a list to hold all the induction variables for this loop
             SmallVector<IVJob, 8> Jobs;
-            SmallVector<Instruction *, 8> ToErase;
 
-            // Loop through each basic block in the loop
+            // Loop through each basic block in the loop, including those of inner loops:
+            // a value that only changes with L is still an induction variable of L there
             for (BasicBlock *B : L.blocks())
             {
 
                 // Loop through each instruction
                 for (Instruction &I : *B)
                 {
-                    const SCEV *S = SE.getSCEV(&I);
+                    if (isa<PHINode>(I) || !isReducible(I) || !SE.isSCEVable(I.getType()))
+                    {
+                        continue;
+                    }
 
-                    // Check if this instruction is an add-recurrence
-                    if (auto *ARExpr = dyn_cast<SCEVAddRecExpr>(S))
+                    // Only affine add-recurrences of this loop with a step we can compute safely
+                    auto *ARExpr = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(&I));
+                    if (!ARExpr || ARExpr->getLoop() != &L || !ARExpr->isAffine() || isBasicIncrement(I, L))
                     {
-                        errs() << "An SCEVAddRecExpr: \n";
-                        I.print(errs());
-                        errs() << "\n\n";
-                        // Only add affine expressions that belong to this loop to our list
-                        if (ARExpr->getLoop() == &L && ARExpr->isAffine())
-                        {
-                            Type *Ty = ARExpr->getType();
-                            if (Ty->isPointerTy())
-                            { // These are currently the only supported types so don't erase anything else
-
-                                Jobs.push_back({ARExpr, &I});
-                            }
-                        }
+                        continue;
+                    }
+                    if (!isSafeToExpand(ARExpr, SE))
+                    {
+                        continue;
+                    }
+
+                    unsigned Benefit = reductionBenefit(I, *ARExpr, L, SE, TTI);
+                    LLVM_DEBUG(dbgs() << "IVEPass: " << I << " = " << *ARExpr << " saves " << Benefit << "\n");
+                    if (Benefit > 0)
+                    {
+                        Jobs.push_back({ARExpr, &I, Benefit, static_cast<unsigned>(Jobs.size())});
                     }
                 }
             }
 
+            // Each new variable holds a register across the loop; spend at most half the
+            // target's scalar registers, counting the loop's existing phis, best savings first
+            unsigned NumRegs = TTI.getNumberOfRegisters(TTI.getRegisterClassForType(false));
+            unsigned LivePhis = std::distance(Header->phis().begin(), Header->phis().end());
+            unsigned Budget = NumRegs / 2 > LivePhis ? NumRegs / 2 - LivePhis : 0;
+            llvm::stable_sort(Jobs, [](const IVJob &A, const IVJob &B) { return A.Benefit > B.Benefit; });
+            if (Jobs.size() > Budget)
+            {
+                Jobs.resize(Budget);
+            }
 
-            Instruction *PreTerm = Preheader->getTerminator();
-            IRBuilder<> PreHeaderBuilder(PreTerm);
+            if (Jobs.empty())
+            {
+                return PreservedAnalyses::all();
+            }
 
-            IRBuilder<> HeaderBuilder(&*Header->getFirstInsertionPt());
+            // Rewrite in program order so operands are reduced before their users
+            llvm::sort(Jobs, [](const IVJob &A, const IVJob &B) { return A.Order < B.Order; });
+
+            Instruction *PreTerm = Preheader->getTerminator();
 
             Instruction *LatchTerm = Latch->getTerminator();
             IRBuilder<> LatchBuilder(LatchTerm);
@@ -84,182 +353,119 @@ namespace
             Module &M = *Latch->getModule();
             const DataLayout &DL = M.getDataLayout();
 
-            // Initialize the expander
+            // Initialize the expander.  Outside canonical mode it expands a start that is itself
+            // a recurrence of an enclosing loop (the i*W part of a[i*W + j]) as an incremented
+            // phi in that loop instead of a multiply, so nested strides are reduced as well
             SCEVExpander Expander(SE, DL, "ive");
+            Expander.disableCanonicalMode();
+
+            SmallVector<NewIV, 8> NewIVs;
+
+            // The trip count, for rewriting the exit test once the new variables exist
+            const SCEV *BackedgeTaken = SE.getBackedgeTakenCount(&L);
 
             for (auto &J : Jobs)
             {
 
-                // Unpack the struct
+                // Unpack the struct; an earlier job may already have deleted this instruction
                 const SCEVAddRecExpr *ARExpr = J.Expr;
-                Instruction *Old = J.OldInst;
-
-                // Get start value to use for constructing Pre-Header
-                Value *StartVal = Expander.expandCodeFor(
-                    ARExpr->getStart(),
-                    ARExpr->getType(),
-                    PreTerm);
+                auto *Old = cast_or_null<Instruction>(J.OldInst);
+                if (!Old)
+                {
+                    continue;
+                }
 
-                PHINode *NewPhi = nullptr;
+                Type *Ty = Old->getType();
 
-                // Form replacement instructions
+                // Get start value to use for constructing Pre-Header
+                Value *StartVal = Expander.expandCodeFor(ARExpr->getStart(), Ty, PreTerm);
+
+                // Declare the phi node for this inductive variable; the header's first non-phi may
+                // have been deleted by an earlier job, so look it up again each time
+                IRBuilder<> HeaderBuilder(Header, Header->getFirstInsertionPt());
+                PHINode *NewPhi = HeaderBuilder.CreatePHI(Ty, 2, Ty->isPointerTy() ? "ive.pointer.phi" : "ive.phi");
+                NewPhi->addIncoming(StartVal, Preheader);
+
+                // Form replacement instructions.  The step is loop invariant, so expand it once in the
+                // preheader; a pointer variable steps with a GEP so alias analysis still sees where it
+                // points, which ptrtoint/inttoptr would hide from LICM and the vectorizer
+                const SCEV *Step = ARExpr->getStepRecurrence(SE);
                 Value *NextVal;
-                Type *Ty = ARExpr->getType();
                 if (Ty->isPointerTy())
                 {
-                    StartVal->getType()->print(errs());
-
-
-                    // strip off any bitcast/intrin‐casts to get the true source
-                    Value *Base = StartVal->stripPointerCasts();
-
-
-                    // 2) peel away any of the three GEP flavors
-                    if (auto *CE = dyn_cast<ConstantExpr>(Base)) {
-                        if (CE->getOpcode() == Instruction::GetElementPtr)
-                        Base = CE->getOperand(0)->stripPointerCasts();
-                    }
-                    else if (auto *GO = dyn_cast<GEPOperator>(Base)) {
-                        // covers both ConstantExpr and Instruction GEP operators
-                        Base = GO->getPointerOperand()->stripPointerCasts();
-                    }
-                    else if (auto *GI = dyn_cast<GetElementPtrInst>(Base)) {
-                        Base = GI->getPointerOperand()->stripPointerCasts();
-                    }
-  
-                    ArrayType *ArrTy = nullptr;
-                    Type *EltTy = nullptr;
-                    // 2) If it’s a global, grab its array type
-                    if (auto *GV = dyn_cast<GlobalVariable>(Base)) {
-                        // getValueType() on a GlobalVariable returns the IR‐type of the global itself
-                        if (auto *AT = dyn_cast<ArrayType>(GV->getValueType())) {
-                        ArrTy = AT;
-                        EltTy = ArrTy->getElementType();  // this is i32
-                        unsigned NumElements = ArrTy->getNumElements();
-
-                        }
+                    // Not inbounds: the increment on the final iteration may step past the object,
+                    // and the exit test reads exactly that value
+                    auto *OldGEP = dyn_cast<GetElementPtrInst>(Old);
+
+                    // Step a whole number of elements when the step allows it, bytes otherwise
+                    Type *EltTy = OldGEP ? OldGEP->getResultElementType() : nullptr;
+                    auto *ConstStep = dyn_cast<SCEVConstant>(Step);
+                    uint64_t EltSize = EltTy && EltTy->isSized() ? DL.getTypeAllocSize(EltTy).getFixedSize() : 0;
+                    Value *Index;
+                    Value *Base = NewPhi;
+                    if (ConstStep && EltSize > 1 && ConstStep->getAPInt().srem(EltSize) == 0)
+                    {
+                        Index = ConstantInt::get(Step->getType(), ConstStep->getAPInt().sdiv(EltSize));
                     }
-
-                    // Handle non-global arrays
-                    if (auto *AI = dyn_cast<AllocaInst>(Base))
+                    else
                     {
-                        if (auto *AT = dyn_cast<ArrayType>(AI->getAllocatedType()))
-                        {
-                            ArrTy = AT;
-                            EltTy = ArrTy->getElementType();  // this is i32
-                        
-                        }
+                        // With typed pointers a byte step needs an i8* to walk; both casts
+                        // fold away under opaque pointers
+                        EltTy = LatchBuilder.getInt8Ty();
+                        Index = Expander.expandCodeFor(Step, DL.getIndexType(Ty), PreTerm);
+                        Base = LatchBuilder.CreateBitCast(NewPhi, LatchBuilder.getInt8PtrTy(Ty->getPointerAddressSpace()));
                     }
-                      // skip this Job entirely and leave the loop’s IR untouched.
-                        if (!ArrTy || !EltTy) {
-                        errs() << "IVEPass: couldn’t infer ArrayType/ElementType—skipping this induction\n";
-                        continue;
-  }
-                    // Declare the phi node for this inductive variable
-                    NewPhi = HeaderBuilder.CreatePHI(
-                        ARExpr->getType(),
-                        2,
-                        "ive.pointer.phi");
-
-                    auto *OldGEP = cast<GetElementPtrInst>(Old);
-                    Value *BasePtr = OldGEP->getPointerOperand()->stripPointerCasts();
-
-
-
-
-                    Value *IdxVal = OldGEP->getOperand(OldGEP->getNumOperands() - 1);
-
-                    // Make sure it is the phi node:
-                    auto *IdxPhi = cast<PHINode>(IdxVal);
-
-                    Value *StartIdx = IdxPhi->getIncomingValueForBlock(Preheader);
-
-
-                    if (!ArrTy) {
-                        errs() << "ERROR: ArrTy is null — failed to infer ArrayType!\n";
-                      } else {
-                        errs() << "Got ArrTy = ["
-                               << ArrTy->getNumElements()
-                               << " x ";
-                        ArrTy->getElementType()->print(errs());
-                        errs() << "]\n";
-                      }
-                      
-                      if (!EltTy) {
-                        errs() << "ERROR: EltTy is null — cannot extract element type!\n";
-                      } else {
-                        errs() << "Got EltTy = ";
-                        EltTy->print(errs());
-                        errs() << "\n";
-                      }
-
-                    // Build {0, IdxPhi} so we pick element IdxPhi
-                    Value *Zero = ConstantInt::get(IdxPhi->getType(), 0);
-                    SmallVector<Value *, 2> Idxs{Zero, StartIdx};
-
-                    // Put initial pointer creator in Preheader
-                    Value *InitialPointer = PreHeaderBuilder.CreateInBoundsGEP(ArrTy, BasePtr, Idxs, "ive.initial.pointer");
-
-                    NewPhi->addIncoming(InitialPointer, Preheader);
-
-
-
-                    // Figure out the target integer type for pointers on this target:
-                    LLVMContext &Ctx = LatchBuilder.getContext();
-                    Type *IntPtrTy = DL.getIntPtrType(Ctx); // from your DataLayout DL
-
-                    // 4) Compute the byte‐stride constant = sizeof(EltTy)
-                    EltTy->print(errs());
-                    uint64_t Bytes = DL.getTypeAllocSize(EltTy);
-
-                    
-                    Value *StepConst = ConstantInt::get(
-                        DL.getIntPtrType(Ctx),
-                        Bytes
-                    );
-
-                    Value *StepVal = Expander.expandCodeFor(
-                        ARExpr->getStepRecurrence(SE),  // still the same SCEV
-                        IntPtrTy,                       
-                        LatchTerm
-                    );
-
-
-                    // Insert ptrtoint
-                    Value *PtrAsInt = LatchBuilder.CreatePtrToInt(NewPhi, IntPtrTy, "ive.ptrtoi");
-                    InitialPointer->getType()->print(errs());
-
-                    // // Insert add stride
-                    Value *NewInt = LatchBuilder.CreateAdd(PtrAsInt, StepVal, "ive.add");
-
-                    // turn it back into a pointer of the same type as original Ptr:
-                    Value *NextVal = LatchBuilder.CreateIntToPtr(NewInt, InitialPointer->getType(), "ive.next");
-
-
-                    // Add this incremented induction variable to our Phi node (coming from the latch block)
-                    NewPhi->addIncoming(NextVal, Latch);
-
-
-                    Old->replaceAllUsesWith(NewPhi); // replace all the old instructions with our new phi node
 
+                    NextVal = LatchBuilder.CreateBitCast(LatchBuilder.CreateGEP(EltTy, Base, Index, "ive.next"), Ty);
+                }
+                else
+                {
+                    Value *StepVal = Expander.expandCodeFor(Step, Ty, PreTerm);
+                    NextVal = LatchBuilder.CreateAdd(NewPhi, StepVal, "ive.next");
+                }
 
-                    // Make sure to delete old instruction
-                    ToErase.push_back(Old);
-                    }
+                // Add this incremented induction variable to our Phi node (coming from the latch block)
+                NewPhi->addIncoming(NextVal, Latch);
+                NewIVs.push_back({NewPhi, NextVal, ARExpr});
 
+                // replace all the old instructions with our new phi node
+                SE.forgetValue(Old);
+                Old->replaceAllUsesWith(NewPhi);
 
+                // Make sure to delete the old instruction, along with whatever only it used
+                RecursivelyDeleteTriviallyDeadInstructions(Old, nullptr, nullptr,
+                                                           [&](Value *V) { SE.forgetValue(V); });
+            }
 
+            // A reduced multiply whose only user was a reduced address is left as a phi that only
+            // feeds its own increment
+            for (NewIV &IV : NewIVs)
+            {
+                if (auto *Phi = dyn_cast_or_null<PHINode>(IV.Phi))
+                {
+                    RecursivelyDeleteDeadPHINode(Phi);
                 }
-            // Delete the old instructions
-            for (Instruction *Old : ToErase)
+            }
+
+            // Test the exit against a surviving new variable, preferring a pointer since
+            // that is what the loop body addresses through
+            llvm::stable_sort(NewIVs, [](const NewIV &A, const NewIV &B)
+                              { return A.Expr->getType()->isPointerTy() && !B.Expr->getType()->isPointerTy(); });
+            for (NewIV &IV : NewIVs)
             {
-                Old->print(errs());
-                errs() << "\n\n";
-                Old->eraseFromParent();
+                if (IV.Phi && replaceExitTest(L, SE, Expander, BackedgeTaken, IV))
+                {
+                    // The trip count was derived from the old exit test
+                    SE.forgetLoop(&L);
+                    break;
+                }
             }
-            
 
-            return PreservedAnalyses::none();
+            // Only instructions changed: the CFG, loop structure and dominators are untouched,
+            // and SCEV was kept up to date by forgetting every value replaced or deleted above
+            PreservedAnalyses PA = getLoopPassPreservedAnalyses();
+            PA.preserveSet<CFGAnalyses>();
+            return PA;
         };
     };
 
@@ -275,11 +481,15 @@ llvmGetPassPluginInfo()
         .PluginVersion = "v0.1",
         .RegisterPassBuilderCallbacks = [](PassBuilder &PB)
         {
-            // 1) still inject at end of default loop pipeline if you do -O2…
+            // 1) still inject at end of default loop pipeline, but only when optimizing for speed:
+            //    the new variables trade size for fewer operations per iteration
             PB.registerLoopOptimizerEndEPCallback(
-                [](LoopPassManager &LPM, OptimizationLevel)
+                [](LoopPassManager &LPM, OptimizationLevel Level)
                 {
-                    LPM.addPass(IVEPass());
+                    if (Level.getSpeedupLevel() >= 2 && Level.getSizeLevel() == 0)
+                    {
+                        LPM.addPass(IVEPass());
+                    }
                 });
 
             // 2) teach 'opt -passes="loop(ive-pass)"' about our pass:
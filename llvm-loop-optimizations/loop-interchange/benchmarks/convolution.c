@@ -0,0 +1,85 @@
+/*
+ * The 2-D convolution from cfg/convolution written the way our C ports of it
+ * walk memory: column by column, so every inner iteration jumps a whole row.
+ *
+ * InterchangePass should turn the nest around so the inner loop runs along a
+ * row.  run.sh builds this with and without the pass and compares runtime and
+ * cache misses; the checksum line must match between the two builds.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define H 2048
+#define W 2048
+#define K 3
+#define REPS 20
+
+static const int kernel[K][K] = {{1, 2, 1}, {2, 4, 2}, {1, 2, 1}};
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+__attribute__((noinline)) void convolve(int (*restrict out)[W], const int (*restrict in)[W])
+{
+  for (long j = 0; j < W - K + 1; j++)
+    for (long i = 0; i < H - K + 1; i++)
+    {
+      int sum = 0;
+      for (long ki = 0; ki < K; ki++)
+        for (long kj = 0; kj < K; kj++)
+          sum += in[i + ki][j + kj] * kernel[ki][kj];
+      out[i][j] = sum;
+    }
+}
+
+__attribute__((noinline)) void scale(int (*restrict out)[W], const int (*restrict in)[W], int factor)
+{
+  for (long j = 0; j < W; j++)
+    for (long i = 0; i < H; i++)
+      out[i][j] = in[i][j] * factor;
+}
+
+static uint64_t checksum(const void *buf, size_t size)
+{
+  const unsigned char *p = buf;
+  uint64_t h = 1469598103934665603ull;
+  for (size_t i = 0; i < size; i++)
+    h = (h ^ p[i]) * 1099511628211ull;
+  return h;
+}
+
+int main(void)
+{
+  int (*img)[W] = malloc(sizeof(int[H][W]));
+  int (*out)[W] = calloc(1, sizeof(int[H][W]));
+  int (*scaled)[W] = calloc(1, sizeof(int[H][W]));
+  for (long i = 0; i < H; i++)
+    for (long j = 0; j < W; j++)
+      img[i][j] = (int)((i * W + j) * 7919 % 19) - 9;
+
+  double t;
+  uint64_t sum = 0;
+
+  t = now();
+  for (int r = 0; r < REPS; r++)
+    convolve(out, img);
+  printf("convolve %10.3f ms\n", (now() - t) * 1e3);
+  sum ^= checksum(out, sizeof(int[H][W]));
+
+  t = now();
+  for (int r = 0; r < REPS; r++)
+    scale(scaled, out, r + 1);
+  printf("scale    %10.3f ms\n", (now() - t) * 1e3);
+  sum ^= checksum(scaled, sizeof(int[H][W]));
+
+  printf("checksum %016llx\n", (unsigned long long)sum);
+
+  free(img); free(out); free(scaled);
+  return 0;
+}
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Builds convolution.c with plain -O2 and with -O2 plus InterchangePass, then runs
+# both, under `perf stat` when it is available so cache misses show up too.
+# Usage: ./run.sh [path/to/SkeletonPass.so]
+set -e
+cd "$(dirname "$0")"
+PLUGIN=${1:-../llvm-pass-skeleton/build/skeleton/SkeletonPass.so}
+CC=${CC:-clang}
+
+$CC -O2 convolution.c -o convolution.O2
+$CC -O2 -fpass-plugin="$PLUGIN" convolution.c -o convolution.interchange
+
+run()
+{
+  if command -v perf >/dev/null 2>&1; then
+    perf stat -e cycles,cache-references,cache-misses,L1-dcache-load-misses "$1"
+  else
+    "$1"
+  fi
+}
+
+echo "== -O2"
+run ./convolution.O2
+echo "== -O2 + interchange-pass"
+run ./convolution.interchange
+
+# Both builds must agree
+[ "$(./convolution.O2 | grep checksum)" = "$(./convolution.interchange | grep checksum)" ] || { echo "checksum mismatch" >&2; exit 1; }
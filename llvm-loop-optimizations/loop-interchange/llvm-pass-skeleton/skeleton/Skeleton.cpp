@@ -0,0 +1,544 @@
+#include <functional>
+#include "llvm/Pass.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/LoopIterator.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Transforms/Scalar/LoopPassManager.h"
+
+#define DEBUG_TYPE "interchange-pass"
+
+using namespace llvm;
+
+namespace
+{
+
+    // The induction variable that drives a loop: Phi starts at Start, Next = Phi + Step
+    // is fed back from the latch, and the loop keeps going while Cmp, which compares
+    // Phi or Next against Bound, agrees with ContinueOnTrue
+    struct LoopIV
+    {
+        PHINode *Phi = nullptr;
+        BinaryOperator *Next = nullptr;
+        Value *Start = nullptr;
+        Value *Step = nullptr;
+        unsigned StepIdx = 1;
+        ICmpInst *Cmp = nullptr;
+        Value *Bound = nullptr;
+        unsigned BoundIdx = 1;
+        CmpInst::Predicate Pred = CmpInst::BAD_ICMP_PREDICATE;
+        bool TestsNext = false;
+        bool ContinueOnTrue = false;
+        bool NSW = false, NUW = false;
+    };
+
+    // Pure instructions that can be recomputed anywhere their operands are available
+    bool isPure(const Instruction &I)
+    {
+        return !I.mayReadOrWriteMemory() && !I.mayHaveSideEffects() && !I.isTerminator() && !isa<PHINode>(I);
+    }
+
+    // V can be made available in the preheader of Outer: it already is, or it is a pure
+    // computation on values that are, sitting somewhere in Outer but outside Inner
+    bool isHoistable(Value *V, const Loop &Outer, const Loop &Inner)
+    {
+        auto *I = dyn_cast<Instruction>(V);
+        if (!I || !Outer.contains(I))
+        {
+            return true;
+        }
+        return !Inner.contains(I) && isPure(*I) && Outer.hasLoopInvariantOperands(I);
+    }
+
+    // Fills IV for L if L is controlled by a single integer counter whose start and bound
+    // are invariant in Outer and whose step is constant.  The header may not hold any
+    // other phi: a second loop-carried scalar would tie the iterations of L together
+    bool matchIV(const Loop &L, const Loop &Outer, const Loop &Inner, LoopIV &IV)
+    {
+        BasicBlock *Header = L.getHeader();
+        BasicBlock *Latch = L.getLoopLatch();
+        BasicBlock *Preheader = L.getLoopPreheader();
+        BasicBlock *Exiting = L.getExitingBlock();
+        if (!Latch || !Preheader || !Exiting || !L.getExitBlock())
+        {
+            return false;
+        }
+
+        auto Phis = Header->phis();
+        if (std::distance(Phis.begin(), Phis.end()) != 1)
+        {
+            return false;
+        }
+        IV.Phi = &*Phis.begin();
+        if (!IV.Phi->getType()->isIntegerTy())
+        {
+            return false;
+        }
+        IV.Start = IV.Phi->getIncomingValueForBlock(Preheader);
+        IV.Next = dyn_cast<BinaryOperator>(IV.Phi->getIncomingValueForBlock(Latch));
+        if (!IV.Next || IV.Next->getOpcode() != Instruction::Add)
+        {
+            return false;
+        }
+        IV.StepIdx = IV.Next->getOperand(0) == IV.Phi ? 1 : 0;
+        if (IV.Next->getOperand(1 - IV.StepIdx) != IV.Phi)
+        {
+            return false;
+        }
+        IV.Step = IV.Next->getOperand(IV.StepIdx);
+        IV.NSW = IV.Next->hasNoSignedWrap();
+        IV.NUW = IV.Next->hasNoUnsignedWrap();
+        if (!isa<ConstantInt>(IV.Step) || !isHoistable(IV.Start, Outer, Inner))
+        {
+            return false;
+        }
+
+        auto *Br = dyn_cast<BranchInst>(Exiting->getTerminator());
+        if (!Br || !Br->isConditional())
+        {
+            return false;
+        }
+        IV.Cmp = dyn_cast<ICmpInst>(Br->getCondition());
+        if (!IV.Cmp || !IV.Cmp->hasOneUse())
+        {
+            return false;
+        }
+        IV.ContinueOnTrue = L.contains(Br->getSuccessor(0));
+        IV.Pred = IV.Cmp->getPredicate();
+        for (unsigned Idx = 0; Idx < 2; Idx++)
+        {
+            Value *Op = IV.Cmp->getOperand(1 - Idx);
+            if (Op == IV.Phi || Op == IV.Next)
+            {
+                IV.BoundIdx = Idx;
+                IV.Bound = IV.Cmp->getOperand(Idx);
+                IV.TestsNext = Op == IV.Next;
+            }
+        }
+        return IV.Bound && isHoistable(IV.Bound, Outer, Inner);
+    }
+
+    // True if some direction vector allowed by D changes its lexicographic sign when
+    // the entries at levels A and B are exchanged.  A dependence whose order would flip
+    // is exactly one the interchanged nest would execute backwards.  Enumerating signs
+    // covers both the normalized and the reversed reading of the vector
+    bool flipsUnderSwap(const Dependence &D, unsigned A, unsigned B)
+    {
+        unsigned Levels = D.getLevels();
+        SmallVector<int, 8> Vec(Levels + 1, 0);
+
+        std::function<bool(unsigned)> Enumerate = [&](unsigned Level) -> bool
+        {
+            if (Level > Levels)
+            {
+                auto LexSign = [&](bool Swapped)
+                {
+                    for (unsigned K = 1; K <= Levels; K++)
+                    {
+                        unsigned From = !Swapped ? K : K == A ? B
+                                                   : K == B   ? A
+                                                              : K;
+                        if (Vec[From] != 0)
+                        {
+                            return Vec[From];
+                        }
+                    }
+                    return 0;
+                };
+                return LexSign(false) != LexSign(true);
+            }
+            unsigned Dir = D.getDirection(Level);
+            const std::pair<unsigned, int> Options[] = {
+                {Dependence::DVEntry::LT, 1}, {Dependence::DVEntry::EQ, 0}, {Dependence::DVEntry::GT, -1}};
+            for (auto [Bit, Sign] : Options)
+            {
+                if (Dir & Bit)
+                {
+                    Vec[Level] = Sign;
+                    if (Enumerate(Level + 1))
+                    {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        };
+        return Enumerate(1);
+    }
+
+    // Step of the address S per iteration of K, peeling recurrences of deeper loops
+    // off the front; null if the address moves with K in a non-affine way
+    const SCEV *strideIn(const SCEV *S, const Loop *K, ScalarEvolution &SE)
+    {
+        while (auto *AR = dyn_cast<SCEVAddRecExpr>(S))
+        {
+            if (AR->getLoop() == K)
+            {
+                return AR->getStepRecurrence(SE);
+            }
+            if (!AR->getLoop()->contains(K->getHeader()) && !K->contains(AR->getLoop()->getHeader()))
+            {
+                break;
+            }
+            S = AR->getStart();
+        }
+        return SE.isLoopInvariant(S, K) ? SE.getZero(S->getType()) : nullptr;
+    }
+
+    // Cost of walking the memory accesses in Accesses with K as the innermost loop:
+    // nothing for an invariant address, one unit for a unit stride, two when
+    // consecutive iterations still share a cache line and four when every iteration
+    // touches a new one (or the stride is unknown)
+    unsigned strideCost(ArrayRef<Instruction *> Accesses, const Loop *K, ScalarEvolution &SE,
+                        const DataLayout &DL)
+    {
+        constexpr int64_t CacheLine = 64;
+        unsigned Cost = 0;
+        for (Instruction *I : Accesses)
+        {
+            Value *Ptr = getLoadStorePointerOperand(I);
+            int64_t Size = DL.getTypeStoreSize(getLoadStoreType(I)).getFixedSize();
+            auto *Stride = dyn_cast_or_null<SCEVConstant>(strideIn(SE.getSCEV(Ptr), K, SE));
+            if (!Stride || Stride->getAPInt().getMinSignedBits() > 64)
+            {
+                Cost += 4;
+                continue;
+            }
+            int64_t Bytes = std::abs(Stride->getAPInt().getSExtValue());
+            Cost += Bytes == 0 ? 0 : Bytes <= Size ? 1
+                                 : Bytes < CacheLine ? 2
+                                                     : 4;
+        }
+        return Cost;
+    }
+
+    struct InterchangePass : public PassInfoMixin<InterchangePass>
+    {
+        PreservedAnalyses run(Loop &L, LoopAnalysisManager &LAM,
+                              LoopStandardAnalysisResults &AR, LPMUpdater &U)
+        {
+            // L is the outer loop of the pair; the loop pass manager visits inner loops
+            // first, so a unit-stride loop keeps moving inward one level per outer loop
+            if (L.getSubLoops().size() != 1)
+            {
+                return PreservedAnalyses::all();
+            }
+            Loop &Outer = L;
+            Loop &Inner = *L.getSubLoops().front();
+
+            LoopIV OuterIV, InnerIV;
+            if (!matchIV(Outer, Outer, Inner, OuterIV) || !matchIV(Inner, Outer, Inner, InnerIV))
+            {
+                LLVM_DEBUG(dbgs() << "interchange: " << Outer.getName() << " is not a counted nest\n");
+                return PreservedAnalyses::all();
+            }
+            // Swapping the bundles swaps the exit tests, so both loops must test in the
+            // same place (both rotated or both not) and count in the same type
+            if (OuterIV.Phi->getType() != InnerIV.Phi->getType() ||
+                (Outer.getExitingBlock() == Outer.getLoopLatch()) !=
+                    (Inner.getExitingBlock() == Inner.getLoopLatch()))
+            {
+                return PreservedAnalyses::all();
+            }
+
+            auto IsControl = [&](const Instruction *I)
+            {
+                return I == OuterIV.Phi || I == OuterIV.Next || I == OuterIV.Cmp ||
+                       I == InnerIV.Phi || I == InnerIV.Next || I == InnerIV.Cmp;
+            };
+
+            // Code between the two loops must either not care which iteration of Outer
+            // it runs in, or be a pure function of the outer counter that can be sunk into
+            // the inner header (address computations LICM hoisted out of the inner loop)
+            SmallVector<Instruction *, 8> Sink;
+            SmallPtrSet<Instruction *, 8> SinkSet;
+            LoopBlocksRPO RPO(&Outer);
+            RPO.perform(&AR.LI);
+            for (BasicBlock *BB : RPO)
+            {
+                if (Inner.contains(BB))
+                {
+                    continue;
+                }
+                for (Instruction &I : *BB)
+                {
+                    if (IsControl(&I) || isa<DbgInfoIntrinsic>(I))
+                    {
+                        continue;
+                    }
+                    if (auto *Phi = dyn_cast<PHINode>(&I))
+                    {
+                        if (!Phi->use_empty())
+                        {
+                            return PreservedAnalyses::all();
+                        }
+                        continue;
+                    }
+                    if (auto *Br = dyn_cast<BranchInst>(&I))
+                    {
+                        if (Br->isConditional() && Br->getCondition() != OuterIV.Cmp &&
+                            !isHoistable(Br->getCondition(), Outer, Inner))
+                        {
+                            return PreservedAnalyses::all();
+                        }
+                        continue;
+                    }
+                    if (!isPure(I))
+                    {
+                        LLVM_DEBUG(dbgs() << "interchange: imperfect nest at " << I << "\n");
+                        return PreservedAnalyses::all();
+                    }
+                    if (Outer.hasLoopInvariantOperands(&I))
+                    {
+                        continue;
+                    }
+                    bool Sinkable = AR.DT.dominates(BB, Inner.getHeader()) &&
+                                    all_of(I.operands(), [&](Value *Op)
+                                           {
+                                               auto *OpI = dyn_cast<Instruction>(Op);
+                                               return !OpI || !Outer.contains(OpI) || OpI == OuterIV.Phi ||
+                                                      SinkSet.count(OpI);
+                                           });
+                    if (!Sinkable)
+                    {
+                        return PreservedAnalyses::all();
+                    }
+                    Sink.push_back(&I);
+                    SinkSet.insert(&I);
+                }
+            }
+
+            // The body is everything in Inner but its control, plus what gets sunk into it
+            auto InBody = [&](const Instruction *I)
+            {
+                return (Inner.contains(I) && !IsControl(I)) || SinkSet.count(const_cast<Instruction *>(I));
+            };
+            for (Instruction *I : Sink)
+            {
+                for (User *Usr : I->users())
+                {
+                    if (!InBody(cast<Instruction>(Usr)))
+                    {
+                        return PreservedAnalyses::all();
+                    }
+                }
+            }
+
+            // The counters may only feed each other's control, the body or dead phis
+            for (const LoopIV *IV : {&OuterIV, &InnerIV})
+            {
+                for (Instruction *V : {cast<Instruction>(IV->Phi), cast<Instruction>(IV->Next)})
+                {
+                    for (User *Usr : V->users())
+                    {
+                        auto *UI = cast<Instruction>(Usr);
+                        bool Unused = isa<PHINode>(UI) && UI->use_empty();
+                        if (UI != IV->Phi && UI != IV->Next && UI != IV->Cmp && !InBody(UI) && !Unused)
+                        {
+                            return PreservedAnalyses::all();
+                        }
+                    }
+                }
+            }
+
+            // Body: only plain loads and stores touch memory, nothing escapes the nest
+            SmallVector<Instruction *, 16> Accesses;
+            for (BasicBlock *BB : Inner.blocks())
+            {
+                for (Instruction &I : *BB)
+                {
+                    if (IsControl(&I) || isa<DbgInfoIntrinsic>(I))
+                    {
+                        continue;
+                    }
+                    for (User *Usr : I.users())
+                    {
+                        auto *UI = cast<Instruction>(Usr);
+                        if (!Inner.contains(UI) && !(isa<PHINode>(UI) && UI->use_empty()))
+                        {
+                            return PreservedAnalyses::all();
+                        }
+                    }
+                    if (auto *LI = dyn_cast<LoadInst>(&I); LI && LI->isSimple())
+                    {
+                        Accesses.push_back(&I);
+                    }
+                    else if (auto *SI = dyn_cast<StoreInst>(&I); SI && SI->isSimple())
+                    {
+                        Accesses.push_back(&I);
+                    }
+                    else if (I.mayReadOrWriteMemory() || I.mayHaveSideEffects())
+                    {
+                        LLVM_DEBUG(dbgs() << "interchange: opaque memory effect " << I << "\n");
+                        return PreservedAnalyses::all();
+                    }
+                }
+            }
+
+            // Profitability first, it is far cheaper than dependence testing
+            Function &F = *Outer.getHeader()->getParent();
+            const DataLayout &DL = F.getParent()->getDataLayout();
+            unsigned CostNow = strideCost(Accesses, &Inner, AR.SE, DL);
+            unsigned CostSwapped = strideCost(Accesses, &Outer, AR.SE, DL);
+            LLVM_DEBUG(dbgs() << "interchange: " << Outer.getName() << " cost " << CostNow << " as is, "
+                              << CostSwapped << " interchanged\n");
+            if (CostSwapped >= CostNow)
+            {
+                return PreservedAnalyses::all();
+            }
+
+            // Legality: no dependence between body accesses may be reversed
+            DependenceInfo DI(&F, &AR.AA, &AR.SE, &AR.LI);
+            unsigned OuterLevel = Outer.getLoopDepth(), InnerLevel = Inner.getLoopDepth();
+            for (size_t A = 0; A < Accesses.size(); A++)
+            {
+                for (size_t B = A; B < Accesses.size(); B++)
+                {
+                    Instruction *Src = Accesses[A], *Dst = Accesses[B];
+                    if (!isa<StoreInst>(Src) && !isa<StoreInst>(Dst))
+                    {
+                        continue;
+                    }
+                    auto D = DI.depends(Src, Dst, true);
+                    if (!D)
+                    {
+                        continue;
+                    }
+                    if (D->isConfused() || D->getLevels() < InnerLevel ||
+                        flipsUnderSwap(*D, OuterLevel, InnerLevel))
+                    {
+                        LLVM_DEBUG(dbgs() << "interchange: blocked by dependence " << *Src << " -> " << *Dst << "\n");
+                        return PreservedAnalyses::all();
+                    }
+                }
+            }
+
+            LLVM_DEBUG(dbgs() << "interchange: swapping " << Outer.getName() << " and " << Inner.getName() << "\n");
+
+            // Bounds and starts computed between the loops move out of the nest
+            Instruction *OuterPreheaderTerm = Outer.getLoopPreheader()->getTerminator();
+            for (Value *V : {InnerIV.Start, InnerIV.Bound, OuterIV.Start, OuterIV.Bound})
+            {
+                auto *I = dyn_cast<Instruction>(V);
+                if (I && Outer.contains(I))
+                {
+                    I->moveBefore(OuterPreheaderTerm);
+                }
+            }
+
+            // Outer-dependent code between the loops moves into the inner header,
+            // keeping its relative order
+            Instruction *InsertPt = &*Inner.getHeader()->getFirstInsertionPt();
+            for (Instruction *I : Sink)
+            {
+                I->moveBefore(InsertPt);
+            }
+
+            // Collect body uses of every counter before anything is rewired
+            auto BodyUses = [&](Value *V)
+            {
+                SmallVector<Use *, 8> Uses;
+                for (Use &U : V->uses())
+                {
+                    if (InBody(cast<Instruction>(U.getUser())))
+                    {
+                        Uses.push_back(&U);
+                    }
+                }
+                return Uses;
+            };
+            auto OuterPhiUses = BodyUses(OuterIV.Phi), InnerPhiUses = BodyUses(InnerIV.Phi);
+            auto OuterNextUses = BodyUses(OuterIV.Next), InnerNextUses = BodyUses(InnerIV.Next);
+
+            // Swap the bundles: the outer loop now counts what the inner one did and
+            // vice versa.  The CFG, and with it LoopInfo and the dominator tree, is untouched
+            auto Retarget = [](LoopIV &To, const LoopIV &From, const Loop &ToLoop)
+            {
+                To.Phi->setIncomingValueForBlock(ToLoop.getLoopPreheader(), From.Start);
+                To.Next->setOperand(To.StepIdx, From.Step);
+                To.Next->setHasNoSignedWrap(From.NSW);
+                To.Next->setHasNoUnsignedWrap(From.NUW);
+
+                Value *Tested = From.TestsNext ? cast<Value>(To.Next) : cast<Value>(To.Phi);
+                To.Cmp->setOperand(From.BoundIdx, From.Bound);
+                To.Cmp->setOperand(1 - From.BoundIdx, Tested);
+                To.Cmp->setPredicate(From.ContinueOnTrue == To.ContinueOnTrue
+                                         ? From.Pred
+                                         : CmpInst::getInversePredicate(From.Pred));
+            };
+            LoopIV OuterOld = OuterIV, InnerOld = InnerIV;
+            Retarget(OuterIV, InnerOld, Outer);
+            Retarget(InnerIV, OuterOld, Inner);
+
+            // Body uses follow the values they used to see.  A use of an old increment
+            // becomes the same increment of the counter that now carries those values
+            IRBuilder<> Builder(&*Inner.getHeader()->getFirstInsertionPt());
+            auto Rewire = [&](ArrayRef<Use *> PhiUses, ArrayRef<Use *> NextUses, PHINode *NewPhi,
+                              const LoopIV &Old)
+            {
+                for (Use *U : PhiUses)
+                {
+                    U->set(NewPhi);
+                }
+                if (!NextUses.empty())
+                {
+                    Value *Next = Builder.CreateAdd(NewPhi, Old.Step, NewPhi->getName() + ".next", Old.NUW, Old.NSW);
+                    for (Use *U : NextUses)
+                    {
+                        U->set(Next);
+                    }
+                }
+            };
+            Rewire(OuterPhiUses, OuterNextUses, InnerIV.Phi, OuterOld);
+            Rewire(InnerPhiUses, InnerNextUses, OuterIV.Phi, InnerOld);
+
+            AR.SE.forgetLoop(&Outer);
+
+            auto PA = getLoopPassPreservedAnalyses();
+            PA.preserveSet<CFGAnalyses>();
+            return PA;
+        }
+    };
+
+} // namespace
+
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo()
+{
+    return {
+        .APIVersion = LLVM_PLUGIN_API_VERSION,
+        .PluginName = "InterchangePass",
+        .PluginVersion = "v0.1",
+        .RegisterPassBuilderCallbacks = [](PassBuilder &PB)
+        {
+            // 1) inject at end of default loop pipeline when optimizing for speed
+            PB.registerLoopOptimizerEndEPCallback(
+                [](LoopPassManager &LPM, OptimizationLevel Level)
+                {
+                    if (Level.getSpeedupLevel() >= 2)
+                    {
+                        LPM.addPass(InterchangePass());
+                    }
+                });
+
+            // 2) teach 'opt -passes="loop(interchange-pass)"' about our pass:
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name,
+                   LoopPassManager &LPM,
+                   ArrayRef<PassBuilder::PipelineElement> /*unused*/)
+                {
+                    if (Name == "interchange-pass")
+                    {
+                        LPM.addPass(InterchangePass());
+                        return true; // we handled it
+                    }
+                    return false; // not ours, let other callbacks try
+                });
+        }};
+}
@@ -0,0 +1,295 @@
+#include "llvm/Pass.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/CodeMetrics.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Transforms/Scalar/LoopPassManager.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include "llvm/Transforms/Utils/UnrollLoop.h"
+
+#define DEBUG_TYPE "unroll-pass"
+
+using namespace llvm;
+
+static cl::opt<unsigned> FullMaxSize(
+    "unroll-pass-full-max-size", cl::init(150), cl::Hidden,
+    cl::desc("Largest loop, in instructions after unrolling, that is unrolled completely"));
+
+static cl::opt<unsigned> PartialMaxSize(
+    "unroll-pass-partial-max-size", cl::init(200), cl::Hidden,
+    cl::desc("Largest loop body, in instructions after unrolling, a partial unroll may produce"));
+
+static cl::opt<unsigned> MaxCount(
+    "unroll-pass-max-count", cl::init(8), cl::Hidden,
+    cl::desc("Most copies of the body a partial unroll makes"));
+
+static cl::opt<bool> AllowRuntime(
+    "unroll-pass-runtime", cl::init(true), cl::Hidden,
+    cl::desc("Partially unroll loops whose trip count is only known at run time, with a remainder loop"));
+
+namespace
+{
+
+    // The compare and branch that control the loop, paid once per unrolled iteration
+    // rather than once per copy
+    constexpr unsigned BackedgeInsts = 2;
+
+    // Values each copy of the body keeps in registers at once: the loop-carried phis and
+    // the loads, which the scheduler will start early once the copies sit side by side
+    unsigned registersPerIteration(const Loop &L, bool Vector)
+    {
+        unsigned Count = 0;
+        for (BasicBlock *B : L.blocks())
+        {
+            for (Instruction &I : *B)
+            {
+                bool Counted = (isa<PHINode>(I) && B == L.getHeader()) || isa<LoadInst>(I);
+                if (Counted && I.getType()->isVectorTy() == Vector)
+                {
+                    Count++;
+                }
+            }
+        }
+        return Count;
+    }
+
+    // Largest power of two no greater than N, or 0
+    unsigned floorPowerOf2(unsigned N)
+    {
+        return N ? 1u << Log2_32(N) : 0;
+    }
+
+    struct UnrollPass : public PassInfoMixin<UnrollPass>
+    {
+        // Partial unrolling before the vectorizer hides the loop it would have widened,
+        // so the early pipeline run only removes loops outright
+        explicit UnrollPass(bool AllowPartial = true) : AllowPartial(AllowPartial) {}
+
+        static StringRef name() { return "unroll-pass"; }
+        PreservedAnalyses run(Loop &L, LoopAnalysisManager &LAM, LoopStandardAnalysisResults &AR,
+                              LPMUpdater &U)
+        {
+            Function &F = *L.getHeader()->getParent();
+            OptimizationRemarkEmitter ORE(&F);
+            auto Missed = [&](StringRef Reason, const Twine &Msg)
+            {
+                ORE.emit([&]()
+                         { return OptimizationRemarkMissed(DEBUG_TYPE, Reason, L.getStartLoc(), L.getHeader())
+                                  << Msg.str(); });
+                return PreservedAnalyses::all();
+            };
+
+            // Only innermost loops in simplified form, and not ones unrolled before, marked
+            // by the user, or already widened and interleaved by the vectorizer
+            if (!L.isInnermost() || !L.isLoopSimplifyForm() || !L.getLoopLatch() ||
+                (hasUnrollTransformation(&L) & TM_Disable) ||
+                getBooleanLoopAttribute(&L, "llvm.loop.isvectorized"))
+            {
+                return PreservedAnalyses::all();
+            }
+
+            // Size of one copy of the body, as the target sees it
+            SmallPtrSet<const Value *, 32> EphValues;
+            CodeMetrics::collectEphemeralValues(&L, &AR.AC, EphValues);
+            CodeMetrics Metrics;
+            for (BasicBlock *B : L.blocks())
+            {
+                Metrics.analyzeBasicBlock(B, AR.TTI, EphValues);
+            }
+            if (Metrics.notDuplicatable || Metrics.convergent)
+            {
+                return Missed("NotDuplicatable", "loop body cannot be duplicated");
+            }
+            unsigned Size = std::max(Metrics.NumInsts, BackedgeInsts + 1);
+            auto SizeWith = [&](uint64_t Copies)
+            { return (Size - BackedgeInsts) * Copies + BackedgeInsts; };
+
+            // Exact trip count if SCEV knows it, otherwise an upper bound, otherwise 0
+            unsigned TripCount = AR.SE.getSmallConstantTripCount(&L);
+            unsigned MaxTripCount = AR.SE.getSmallConstantMaxTripCount(&L);
+            LLVM_DEBUG(dbgs() << "unroll: " << L.getName() << " size " << Size << ", trip count " << TripCount
+                              << ", at most " << MaxTripCount << "\n");
+
+            // Full unrolling removes the loop.  With only an upper bound the copies keep
+            // their exit tests, but the backedge and the counter still go away
+            unsigned Count = 0;
+            bool Full = false;
+            bool Runtime = false;
+            if (TripCount && SizeWith(TripCount) <= FullMaxSize)
+            {
+                Count = TripCount;
+                Full = true;
+            }
+            else if (!TripCount && MaxTripCount && SizeWith(MaxTripCount) <= FullMaxSize)
+            {
+                Count = MaxTripCount;
+                Full = true;
+            }
+            else if (!AllowPartial)
+            {
+                return PreservedAnalyses::all();
+            }
+            else
+            {
+                // Partial unrolling: as many copies as the size limit, the count limit and
+                // the register file allow, kept a power of two so the remainder is cheap
+                unsigned Limit = std::min<unsigned>(MaxCount, (PartialMaxSize - BackedgeInsts) /
+                                                                  std::max(Size - BackedgeInsts, 1u));
+                for (bool Vector : {false, true})
+                {
+                    unsigned PerIteration = registersPerIteration(L, Vector);
+                    unsigned Budget = AR.TTI.getNumberOfRegisters(AR.TTI.getRegisterClassForType(Vector));
+                    if (PerIteration && Budget)
+                    {
+                        Limit = std::min(Limit, Budget / PerIteration);
+                    }
+                }
+                Count = floorPowerOf2(Limit);
+                if (Count < 2)
+                {
+                    return Missed("TooLarge", "loop body too large or register hungry to unroll (size " +
+                                                  Twine(Size) + ")");
+                }
+                if (MaxTripCount && Count >= MaxTripCount)
+                {
+                    return PreservedAnalyses::all();
+                }
+
+                // A known trip count the copies divide needs no remainder; otherwise the
+                // leftover iterations run in an epilogue loop
+                if (TripCount)
+                {
+                    while (TripCount % Count)
+                    {
+                        Count /= 2;
+                    }
+                    Runtime = Count < 2;
+                    Count = Runtime ? floorPowerOf2(Limit) : Count;
+                }
+                else
+                {
+                    Runtime = true;
+                }
+                if (Runtime && !AllowRuntime)
+                {
+                    return Missed("NoRuntime", "trip count is not a multiple of the unroll count and "
+                                               "runtime unrolling is disabled");
+                }
+            }
+
+            UnrollLoopOptions ULO;
+            ULO.Count = Count;
+            ULO.Force = false;
+            ULO.Runtime = Runtime;
+            ULO.AllowExpensiveTripCount = false;
+            ULO.UnrollRemainder = false;
+            ULO.ForgetAllSCEV = false;
+
+            std::string LoopName = std::string(L.getName());
+            DebugLoc Loc = L.getStartLoc();
+            BasicBlock *Header = L.getHeader();
+            Loop *Remainder = nullptr;
+            LoopUnrollResult Result = UnrollLoop(&L, ULO, &AR.LI, &AR.SE, &AR.DT, &AR.AC, &AR.TTI,
+                                                 /*ORE=*/nullptr, /*PreserveLCSSA=*/true, &Remainder);
+
+            switch (Result)
+            {
+            case LoopUnrollResult::Unmodified:
+                // Say which attempt UnrollLoop turned down
+                if (Full)
+                {
+                    return Missed("FullUnrollFailed",
+                                  "loop could not be unrolled completely into " + Twine(Count) + " copies");
+                }
+                if (Runtime)
+                {
+                    return Missed("RuntimeUnrollFailed", "remainder for a runtime trip count could not be built");
+                }
+                return Missed("PartialUnrollFailed", "loop could not be unrolled by a factor of " + Twine(Count));
+            case LoopUnrollResult::FullyUnrolled:
+                ORE.emit([&]()
+                         { return OptimizationRemark(DEBUG_TYPE, "FullyUnrolled", Loc, Header)
+                                  << "completely unrolled loop with "
+                                  << ore::NV("UnrollCount", Count) << " iterations"; });
+                U.markLoopAsDeleted(L, LoopName);
+                break;
+            case LoopUnrollResult::PartiallyUnrolled:
+                ORE.emit([&]()
+                         {
+                             OptimizationRemark R(DEBUG_TYPE, "PartialUnrolled", Loc, Header);
+                             R << "unrolled loop by a factor of " << ore::NV("UnrollCount", Count);
+                             if (Runtime)
+                             {
+                                 R << " with an epilogue for the remaining iterations";
+                             }
+                             return R;
+                         });
+                // The copies already fill the budget; neither this loop nor its
+                // remainder should be unrolled again further down the pipeline
+                L.setLoopAlreadyUnrolled();
+                if (Remainder)
+                {
+                    U.addSiblingLoops({Remainder});
+                }
+                break;
+            }
+
+            return getLoopPassPreservedAnalyses();
+        }
+
+        bool AllowPartial;
+    };
+
+} // namespace
+
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo()
+{
+    return {
+        .APIVersion = LLVM_PLUGIN_API_VERSION,
+        .PluginName = "UnrollPass",
+        .PluginVersion = "v0.1",
+        .RegisterPassBuilderCallbacks = [](PassBuilder &PB)
+        {
+            // 1) inject at end of default loop pipeline, only when optimizing for speed:
+            //    unrolling trades code size for fewer branches and counter updates.
+            //    Small loops go away there; partial unrolling waits until after the vectorizer
+            PB.registerLoopOptimizerEndEPCallback(
+                [](LoopPassManager &LPM, OptimizationLevel Level)
+                {
+                    if (Level.getSpeedupLevel() >= 2 && Level.getSizeLevel() == 0)
+                    {
+                        LPM.addPass(UnrollPass(/*AllowPartial=*/false));
+                    }
+                });
+            PB.registerOptimizerLastEPCallback(
+                [](ModulePassManager &MPM, OptimizationLevel Level)
+                {
+                    if (Level.getSpeedupLevel() >= 2 && Level.getSizeLevel() == 0)
+                    {
+                        MPM.addPass(createModuleToFunctionPassAdaptor(
+                            createFunctionToLoopPassAdaptor(UnrollPass())));
+                    }
+                });
+
+            // 2) teach 'opt -passes="loop(unroll-pass)"' about our pass:
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name,
+                   LoopPassManager &LPM,
+                   ArrayRef<PassBuilder::PipelineElement> /*unused*/)
+                {
+                    if (Name == "unroll-pass")
+                    {
+                        LPM.addPass(UnrollPass());
+                        return true; // we handled it
+                    }
+                    return false; // not ours, let other callbacks try
+                });
+        }};
+}
@@ -0,0 +1,269 @@
+#include "llvm/Pass.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Transforms/Scalar/LoopPassManager.h"
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+
+#define DEBUG_TYPE "prefetch-pass"
+
+using namespace llvm;
+
+static cl::opt<unsigned> MemoryLatency(
+    "prefetch-memory-latency", cl::init(300), cl::Hidden,
+    cl::desc("Cycles a miss to memory takes, which the prefetch has to cover"));
+
+static cl::opt<unsigned> HardwareStride(
+    "prefetch-hardware-stride", cl::init(2048), cl::Hidden,
+    cl::desc("Largest constant stride in bytes the hardware prefetcher is trusted to follow"));
+
+static cl::opt<unsigned> LastLevelCache(
+    "prefetch-llc-size", cl::init(8 << 20), cl::Hidden,
+    cl::desc("Bytes a loop must stream through before prefetching is worth it"));
+
+static cl::opt<unsigned> MaxIterationsAhead(
+    "prefetch-max-iterations", cl::init(64), cl::Hidden,
+    cl::desc("Upper bound on how many iterations ahead a prefetch reaches"));
+
+namespace
+{
+
+    // A load or store whose address is an affine recurrence of the loop
+    struct Stream
+    {
+        Instruction *Access;
+        const SCEVAddRecExpr *Expr;
+        bool IsWrite;
+    };
+
+    /**
+     * Estimated cycles one iteration of L takes when its data is in cache,
+     * from the target's latency costs.  Only has to be good enough to decide
+     * how many iterations hide one miss.
+     */
+    unsigned iterationCost(const Loop &L, const TargetTransformInfo &TTI)
+    {
+        unsigned Cost = 0;
+        for (BasicBlock *B : L.blocks())
+        {
+            for (Instruction &I : *B)
+            {
+                InstructionCost C = TTI.getInstructionCost(&I, TargetTransformInfo::TCK_Latency);
+                Cost += C.isValid() ? *C.getValue() : 1;
+            }
+        }
+        return std::max(Cost, 1u);
+    }
+
+    // True if the hardware prefetcher can be expected to follow a stream with this step
+    // on its own: a small constant stride it detects after a couple of misses
+    bool hardwareCovers(const SCEV *Step)
+    {
+        auto *C = dyn_cast<SCEVConstant>(Step);
+        return C && C->getAPInt().getMinSignedBits() <= 64 &&
+               static_cast<uint64_t>(std::abs(C->getAPInt().getSExtValue())) <= HardwareStride;
+    }
+
+    struct PrefetchPass : public PassInfoMixin<PrefetchPass>
+    {
+        static StringRef name() { return "prefetch-pass"; }
+        PreservedAnalyses run(Loop &L, LoopAnalysisManager &LAM, LoopStandardAnalysisResults &AR,
+                              LPMUpdater &U)
+        {
+            ScalarEvolution &SE = AR.SE;
+            const TargetTransformInfo &TTI = AR.TTI;
+
+            // Misses that matter come from the innermost loop, where the distance
+            // is measured in its own iterations
+            BasicBlock *Preheader = L.getLoopPreheader();
+            if (!Preheader || !L.getLoopLatch() || !L.isInnermost())
+            {
+                return PreservedAnalyses::all();
+            }
+
+            // Same discovery as IVEPass, but over the addresses of memory accesses
+            SmallVector<Stream, 8> Streams;
+            for (BasicBlock *B : L.blocks())
+            {
+                for (Instruction &I : *B)
+                {
+                    Value *Ptr = getLoadStorePointerOperand(&I);
+                    bool Simple = isa<LoadInst>(I) ? cast<LoadInst>(I).isSimple()
+                                                   : isa<StoreInst>(I) && cast<StoreInst>(I).isSimple();
+                    if (!Ptr || !Simple)
+                    {
+                        continue;
+                    }
+                    auto *ARExpr = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(Ptr));
+                    if (!ARExpr || ARExpr->getLoop() != &L || !ARExpr->isAffine() || !isSafeToExpand(ARExpr, SE))
+                    {
+                        continue;
+                    }
+                    Streams.push_back({&I, ARExpr, isa<StoreInst>(I)});
+                }
+            }
+            if (Streams.empty())
+            {
+                return PreservedAnalyses::all();
+            }
+
+            // A nest that provably streams through less than the last-level cache holds
+            // misses at most once per line no matter what, so it is left alone.  Every
+            // enclosing trip count counts: a column walk is only cold across columns
+            const DataLayout &DL = L.getHeader()->getModule()->getDataLayout();
+            uint64_t Trips = 1;
+            for (const Loop *Cur = &L; Cur && Trips; Cur = Cur->getParentLoop())
+            {
+                Trips = SaturatingMultiply(Trips, uint64_t(SE.getSmallConstantMaxTripCount(Cur)));
+            }
+            if (Trips)
+            {
+                uint64_t Footprint = 0;
+                for (const Stream &S : Streams)
+                {
+                    auto *C = dyn_cast<SCEVConstant>(S.Expr->getStepRecurrence(SE));
+                    if (!C || C->getAPInt().getMinSignedBits() > 64)
+                    {
+                        Footprint = LastLevelCache;
+                        break;
+                    }
+                    Footprint = SaturatingAdd(Footprint, SaturatingMultiply(
+                                                             uint64_t(std::abs(C->getAPInt().getSExtValue())), Trips));
+                }
+                if (Footprint < LastLevelCache)
+                {
+                    LLVM_DEBUG(dbgs() << "prefetch: " << L.getName() << " footprint " << Footprint << " fits\n");
+                    return PreservedAnalyses::all();
+                }
+            }
+
+            // Enough iterations ahead that the line arrives as the access reaches it
+            unsigned LineSize = TTI.getCacheLineSize() ? TTI.getCacheLineSize() : 64;
+            unsigned Cost = iterationCost(L, TTI);
+            unsigned Ahead = std::min<unsigned>((MemoryLatency + Cost - 1) / Cost, MaxIterationsAhead);
+            LLVM_DEBUG(dbgs() << "prefetch: " << L.getName() << " costs " << Cost << " cycles, "
+                              << Ahead << " iterations ahead\n");
+
+            SCEVExpander Expander(SE, DL, "prefetch");
+            Instruction *PreTerm = Preheader->getTerminator();
+            Module &M = *Preheader->getModule();
+            SmallVector<const Stream *, 8> Issued;
+            bool Changed = false;
+
+            for (const Stream &S : Streams)
+            {
+                const SCEV *Step = S.Expr->getStepRecurrence(SE);
+                if (Step->isZero() || hardwareCovers(Step) || !SE.isLoopInvariant(Step, &L))
+                {
+                    continue;
+                }
+
+                // One prefetch per cache line: a stream with the same step whose start lies
+                // within a line of one already covered, or within a line of where that one
+                // will be a few iterations from now (the row above or below in a stencil),
+                // rides along with it
+                auto *ConstStep = dyn_cast<SCEVConstant>(Step);
+                bool Covered = any_of(Issued, [&](const Stream *Other)
+                                      {
+                                          auto *Diff = dyn_cast<SCEVConstant>(
+                                              SE.getMinusSCEV(S.Expr->getStart(), Other->Expr->getStart()));
+                                          if (Other->Expr->getStepRecurrence(SE) != Step || !Diff ||
+                                              Diff->getAPInt().getMinSignedBits() > 64)
+                                          {
+                                              return false;
+                                          }
+                                          int64_t Offset = Diff->getAPInt().getSExtValue();
+                                          if (ConstStep)
+                                          {
+                                              int64_t Stride = ConstStep->getAPInt().getSExtValue();
+                                              int64_t Iters = (Offset + (Offset < 0 ? -Stride / 2 : Stride / 2)) / Stride;
+                                              if (std::abs(Iters) <= Ahead)
+                                              {
+                                                  Offset -= Iters * Stride;
+                                              }
+                                          }
+                                          return std::abs(Offset) < LineSize;
+                                      });
+                if (Covered)
+                {
+                    continue;
+                }
+
+                // Address Ahead iterations on.  Not inbounds: near the end of the loop it
+                // points past the object, which a prefetch tolerates but a GEP promise does not
+                Value *Ptr = getLoadStorePointerOperand(S.Access);
+                Type *IdxTy = DL.getIndexType(Ptr->getType());
+                Value *Distance = Expander.expandCodeFor(
+                    SE.getMulExpr(SE.getTruncateOrSignExtend(Step, IdxTy), SE.getConstant(IdxTy, Ahead)),
+                    IdxTy, PreTerm);
+                IRBuilder<> Builder(S.Access);
+                Value *Bytes = Builder.CreateBitCast(
+                    Ptr, Builder.getInt8PtrTy(Ptr->getType()->getPointerAddressSpace()));
+                Value *Target = Builder.CreateGEP(Builder.getInt8Ty(), Bytes, Distance, "prefetch.addr");
+
+                // llvm.prefetch(address, rw, locality, cache type): keep it in all levels, data cache
+                Function *Prefetch = Intrinsic::getDeclaration(&M, Intrinsic::prefetch, {Target->getType()});
+                Builder.CreateCall(Prefetch, {Target, Builder.getInt32(S.IsWrite), Builder.getInt32(3),
+                                              Builder.getInt32(1)});
+                LLVM_DEBUG(dbgs() << "prefetch: " << *S.Access << " step " << *Step << "\n");
+
+                Issued.push_back(&S);
+                Changed = true;
+            }
+
+            if (!Changed)
+            {
+                return PreservedAnalyses::all();
+            }
+            auto PA = getLoopPassPreservedAnalyses();
+            PA.preserveSet<CFGAnalyses>();
+            return PA;
+        }
+    };
+
+} // namespace
+
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo()
+{
+    return {
+        .APIVersion = LLVM_PLUGIN_API_VERSION,
+        .PluginName = "PrefetchPass",
+        .PluginVersion = "v0.1",
+        .RegisterPassBuilderCallbacks = [](PassBuilder &PB)
+        {
+            // 1) run on the final loops, after vectorization has settled how far each
+            //    iteration moves, and only when optimizing for speed
+            PB.registerOptimizerLastEPCallback(
+                [](ModulePassManager &MPM, OptimizationLevel Level)
+                {
+                    if (Level.getSpeedupLevel() >= 2 && Level.getSizeLevel() == 0)
+                    {
+                        MPM.addPass(createModuleToFunctionPassAdaptor(
+                            createFunctionToLoopPassAdaptor(PrefetchPass())));
+                    }
+                });
+
+            // 2) teach 'opt -passes="loop(prefetch-pass)"' about our pass:
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name,
+                   LoopPassManager &LPM,
+                   ArrayRef<PassBuilder::PipelineElement> /*unused*/)
+                {
+                    if (Name == "prefetch-pass")
+                    {
+                        LPM.addPass(PrefetchPass());
+                        return true; // we handled it
+                    }
+                    return false; // not ours, let other callbacks try
+                });
+        }};
+}
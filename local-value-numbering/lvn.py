@@ -33,47 +33,6 @@ FOLDABLE_OPS = {"add": lambda x, y: x + y,
                 "or": lambda x, y: x or y}
 
 
-# Dead code elimination
-def trivial_dce_pass(func):
-  """Remove instructions from `func` that are never used as arguments
-  to any other instruction. Return a bool indicating whether we deleted
-  anything.
-  """
-  # Form blocks from the function
-  blocks = list(form_blocks(func['instrs']))
-
-  # Reset flag
-  changed = False
-
-  # Initialize set to hold used variables
-  used = set()
-
-  # Add every variable that appears as an argument to our used set (starting assumption)
-  for block in blocks:
-      for instr in block:
-          for arg in instr.get('args', []):
-              used.add(arg)
-
-
- # Remove all instructions that assign to an unused variable
-  for block in blocks:
-      to_remove = []
-      for instr in block:
-         if instr.get('dest') is not None:
-             if instr['dest'] not in used:
-                 changed = True
-                 to_remove.append(instr)
-    # Remove all accumulated instructions
-      for instr in to_remove:
-          block.remove(instr)
-    
-  # Reassemble the function.
-  func['instrs'] = flatten(blocks)
-
-  return changed
-
-
-
 def drop_killed_local(blocks):
     """Delete instructions in a single block whose result is unused
     before the next assignment. Return a bool indicating whether
@@ -280,8 +239,7 @@ if __name__ == '__main__':
         
         func['instrs'] = flatten(blocks)
 
-        trivial_dce_pass(func)
+        # Dead code is removed afterwards by the global liveness pass in ../dead-code-elimination
 
-        
 
     json.dump(prog, sys.stdout, indent=2, sort_keys=True)
\ No newline at end of file
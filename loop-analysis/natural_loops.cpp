@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../cfg/block_graph.h"
+#include "../dominance-tree/dominator_tree.h"
+#include "natural_loops.h"
+
+using json = nlohmann::json;
+
+bool Loop::contains(unsigned block) const
+{
+  return std::binary_search(blocks.begin(), blocks.end(), block);
+}
+
+unsigned LoopNest::depth(unsigned block) const
+{
+  if (block >= loop_of.size() || loop_of[block] == BlockGraph::NONE)
+  {
+    return 0;
+  }
+  return loops[loop_of[block]].depth;
+}
+
+LoopNest find_loops(const BlockGraph &graph, const DominatorTree &dominators)
+{
+  unsigned N = graph.size();
+  LoopNest nest;
+  nest.loop_of.assign(N, BlockGraph::NONE);
+
+  // Group the back edges by header: an edge is a back edge if its target dominates its source
+  std::vector<std::vector<unsigned>> latches_of(N);
+  for (unsigned block = 0; block < N; block++)
+  {
+    for (unsigned succ : graph.succs[block])
+    {
+      if (dominators.dominates(succ, block))
+      {
+        latches_of[succ].push_back(block);
+      }
+    }
+  }
+
+  std::vector<Loop> found;
+  std::vector<bool> in_loop(N, false);
+  for (unsigned header = 0; header < N; header++)
+  {
+    if (latches_of[header].empty())
+    {
+      continue;
+    }
+
+    Loop loop;
+    loop.header = header;
+    loop.latches = latches_of[header];
+
+    // The body is everything that reaches a latch without passing through the header
+    std::vector<unsigned> stack;
+    in_loop[header] = true;
+    loop.blocks.push_back(header);
+    for (unsigned latch : loop.latches)
+    {
+      if (!in_loop[latch])
+      {
+        in_loop[latch] = true;
+        loop.blocks.push_back(latch);
+        stack.push_back(latch);
+      }
+    }
+    while (!stack.empty())
+    {
+      unsigned block = stack.back();
+      stack.pop_back();
+      for (unsigned pred : graph.preds[block])
+      {
+        // Unreachable predecessors are not dominated by the header and do not belong to the loop
+        if (!in_loop[pred] && dominators.dominates(header, pred))
+        {
+          in_loop[pred] = true;
+          loop.blocks.push_back(pred);
+          stack.push_back(pred);
+        }
+      }
+    }
+    std::sort(loop.blocks.begin(), loop.blocks.end());
+
+    // Exiting and exit blocks
+    for (unsigned block : loop.blocks)
+    {
+      for (unsigned succ : graph.succs[block])
+      {
+        if (!in_loop[succ])
+        {
+          loop.exiting.push_back(block);
+          loop.exits.push_back(succ);
+        }
+      }
+    }
+    for (auto *list : {&loop.exiting, &loop.exits})
+    {
+      std::sort(list->begin(), list->end());
+      list->erase(std::unique(list->begin(), list->end()), list->end());
+    }
+
+    for (unsigned block : loop.blocks)
+    {
+      in_loop[block] = false;
+    }
+    found.push_back(std::move(loop));
+  }
+
+  // Outer loops are strictly larger than the loops nested in them, so sort largest first
+  std::stable_sort(found.begin(), found.end(), [](const Loop &a, const Loop &b) {
+    return a.blocks.size() > b.blocks.size();
+  });
+
+  // Each loop's parent is the innermost loop seen so far that contains its header
+  for (unsigned idx = 0; idx < found.size(); idx++)
+  {
+    Loop &loop = found[idx];
+    loop.parent = nest.loop_of[loop.header];
+    if (loop.parent == BlockGraph::NONE)
+    {
+      nest.top_level.push_back(idx);
+    }
+    else
+    {
+      loop.depth = found[loop.parent].depth + 1;
+      found[loop.parent].children.push_back(idx);
+    }
+    for (unsigned block : loop.blocks)
+    {
+      nest.loop_of[block] = idx;
+    }
+  }
+  nest.loops = std::move(found);
+
+  // A loop whose header has one outside predecessor that only jumps to it already has a preheader
+  for (Loop &loop : nest.loops)
+  {
+    unsigned entering = BlockGraph::NONE;
+    unsigned count = 0;
+    for (unsigned pred : graph.preds[loop.header])
+    {
+      if (!loop.contains(pred))
+      {
+        entering = pred;
+        count++;
+      }
+    }
+    if (count == 1 && graph.succs[entering].size() == 1)
+    {
+      loop.preheader = entering;
+    }
+  }
+
+  return nest;
+}
+
+bool insert_preheaders(BlockGraph &graph, LoopNest &nest)
+{
+  bool changed = false;
+
+  for (Loop &loop : nest.loops)
+  {
+    if (loop.preheader != BlockGraph::NONE)
+    {
+      continue;
+    }
+
+    std::vector<unsigned> entering;
+    for (unsigned pred : graph.preds[loop.header])
+    {
+      if (!loop.contains(pred) && std::find(entering.begin(), entering.end(), pred) == entering.end())
+      {
+        entering.push_back(pred);
+      }
+    }
+    if (entering.empty())
+    {
+      continue;
+    }
+
+    // Lay the new block out right before the header so a fall-through into the loop stays one
+    const std::string header_name = graph.names[loop.header];
+    unsigned pre = graph.add_block("preheader", loop.header);
+    graph.blocks[pre].push_back(json{{"op", "jmp"}, {"labels", json::array({header_name})}});
+    graph.implicit_terminator[pre] = true;
+
+    // Redirect every entering edge to the preheader
+    for (unsigned pred : entering)
+    {
+      for (auto &label : graph.blocks[pred].back()["labels"])
+      {
+        if (label == header_name)
+        {
+          label = graph.names[pre];
+        }
+      }
+      for (unsigned &succ : graph.succs[pred])
+      {
+        if (succ == loop.header)
+        {
+          succ = pre;
+        }
+      }
+      graph.preds[pre].push_back(pred);
+    }
+    auto &header_preds = graph.preds[loop.header];
+    header_preds.erase(std::remove_if(header_preds.begin(), header_preds.end(),
+                                      [&](unsigned pred) { return !loop.contains(pred); }),
+                       header_preds.end());
+    header_preds.push_back(pre);
+    graph.succs[pre].push_back(loop.header);
+
+    // The preheader sits inside every loop that encloses this one
+    nest.loop_of.push_back(loop.parent);
+    for (unsigned anc = loop.parent; anc != BlockGraph::NONE; anc = nest.loops[anc].parent)
+    {
+      auto &blocks = nest.loops[anc].blocks;
+      blocks.insert(std::upper_bound(blocks.begin(), blocks.end(), pre), pre);
+    }
+
+    loop.preheader = pre;
+    changed = true;
+  }
+
+  return changed;
+}
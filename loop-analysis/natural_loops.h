@@ -0,0 +1,90 @@
+#ifndef NATURAL_LOOPS_H
+#define NATURAL_LOOPS_H
+
+#include <vector>
+#include "../cfg/block_graph.h"
+#include "../dominance-tree/dominator_tree.h"
+
+/**
+ * @brief One natural loop of a Bril function.
+ *
+ * All block sets are sorted vectors of block indices, so membership tests
+ * are a binary search and the whole nest stays small.
+ */
+struct Loop {
+  /// The loop header, which dominates every block in the loop.
+  unsigned header;
+
+  /// Sources of the back edges into the header.
+  std::vector<unsigned> latches;
+
+  /// Every block in the loop, including the header and nested loops' blocks.
+  std::vector<unsigned> blocks;
+
+  /// Blocks inside the loop with a successor outside it.
+  std::vector<unsigned> exiting;
+
+  /// Blocks outside the loop with a predecessor inside it.
+  std::vector<unsigned> exits;
+
+  /// The block that enters the header from outside, if the loop has one
+  /// (see `insert_preheaders`).  `BlockGraph::NONE` otherwise.
+  unsigned preheader = BlockGraph::NONE;
+
+  /// Enclosing loop (`BlockGraph::NONE` for an outermost loop) and
+  /// directly nested loops.
+  unsigned parent = BlockGraph::NONE;
+  std::vector<unsigned> children;
+
+  /// Nesting depth: 1 for an outermost loop.
+  unsigned depth = 1;
+
+  /// True if `block` is part of this loop.
+  bool contains(unsigned block) const;
+};
+
+/**
+ * @brief The loop-nest tree of a Bril function.
+ *
+ * Loops are stored outermost-first, so a loop's parent always has a
+ * smaller index than the loop itself.
+ */
+struct LoopNest {
+  std::vector<Loop> loops;
+
+  /// Innermost loop containing each block, or `BlockGraph::NONE`.
+  std::vector<unsigned> loop_of;
+
+  /// Loops that are not nested in any other loop.
+  std::vector<unsigned> top_level;
+
+  /// Number of loops around `block` (0 if it is in no loop).
+  unsigned depth(unsigned block) const;
+};
+
+/**
+ * @brief Finds the natural loops of a function and arranges them into a tree.
+ *
+ * A back edge is an edge `latch → header` where the header dominates the
+ * latch.  Back edges sharing a header form a single loop, whose body is
+ * everything that reaches a latch without going through the header.
+ * Retreating edges into irreducible regions are not back edges and
+ * produce no loop.
+ */
+LoopNest find_loops(const BlockGraph& graph, const DominatorTree& dominators);
+
+/**
+ * @brief Gives every loop a dedicated preheader.
+ *
+ * A loop already has one if its header has a single predecessor outside
+ * the loop and that predecessor only jumps to the header.  Otherwise a new
+ * block is laid out just before the header, all entering edges are
+ * redirected to it, and it jumps to the header.  The nest is updated in
+ * place (the preheader joins every enclosing loop), but the graph's
+ * dominator tree must be recomputed if anything was inserted.
+ *
+ * @return True if any block was inserted.
+ */
+bool insert_preheaders(BlockGraph& graph, LoopNest& nest);
+
+#endif // NATURAL_LOOPS_H
@@ -0,0 +1,66 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../analysis-cache/cached_analyses.h"
+#include "../cfg/block_graph.h"
+#include "../dominance-tree/dominator_tree.h"
+#include "natural_loops.h"
+
+using json = nlohmann::json;
+
+// Print a list of block indices by name
+void print_blocks(const BlockGraph &graph, const std::vector<unsigned> &blocks)
+{
+  for (unsigned block : blocks)
+  {
+    std::cout << " " << graph.names[block];
+  }
+  std::cout << "\n";
+}
+
+int main()
+{
+  // Read JSON input
+  json program;
+  std::cin >> program;
+
+  // Check if "functions" exists and is an array
+  if (!program.contains("functions") || !program["functions"].is_array())
+  {
+    std::cerr << "Error: Expected a 'functions' key with an array of functions.\n";
+    return 1;
+  }
+
+  // Reuse the CFGs and dominator trees of functions seen before, if BRIL_CACHE_DIR is set
+  std::unique_ptr<AnalysisCache> cache = AnalysisCache::from_env();
+
+  for (auto &func : program["functions"])
+  {
+    std::string digest = cache ? AnalysisCache::digest(func) : "";
+    BlockGraph graph = cached_block_graph(cache.get(), func, digest);
+    DominatorTree dominators = cached_dominators(cache.get(), graph, digest);
+    LoopNest nest = find_loops(graph, dominators);
+
+    std::cout << "Function: " << func["name"].get<std::string>() << "\n";
+
+    for (const Loop &loop : nest.loops)
+    {
+      std::cout << "  Loop: " << graph.names[loop.header] << " (depth " << loop.depth << ")\n";
+      std::cout << "    Parent: "
+                << (loop.parent == BlockGraph::NONE ? "none" : graph.names[nest.loops[loop.parent].header]) << "\n";
+      std::cout << "    Preheader: "
+                << (loop.preheader == BlockGraph::NONE ? "none" : graph.names[loop.preheader]) << "\n";
+      std::cout << "    Blocks:";
+      print_blocks(graph, loop.blocks);
+      std::cout << "    Latches:";
+      print_blocks(graph, loop.latches);
+      std::cout << "    Exits:";
+      print_blocks(graph, loop.exits);
+    }
+    std::cout << "\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,408 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../cfg/block_graph.h"
+#include "../dominance-tree/dominator_tree.h"
+#include "../loop-analysis/natural_loops.h"
+#include "../data-flow-analysis/reaching_definitions.h"
+#include "../data-flow-analysis/live_variables.h"
+
+using json = nlohmann::json;
+
+// Opcodes whose result only depends on their arguments
+const std::unordered_set<std::string> PURE_OPS = {
+    "const", "id",
+    "add", "sub", "mul", "div",
+    "eq", "lt", "gt", "le", "ge",
+    "not", "and", "or",
+    "fadd", "fsub", "fmul", "fdiv",
+    "feq", "flt", "fgt", "fle", "fge",
+    "ptradd",
+    "ceq", "clt", "cgt", "cle", "cge", "char2int", "int2char"};
+
+// Pure opcodes that can fail at runtime, so they must not be executed speculatively
+const std::unordered_set<std::string> TRAPPING_OPS = {"div"};
+
+/**
+ * @brief Checks whether anything the loop does before a trapping instruction
+ * on its first trip can be observed.
+ *
+ * Walks back from the instruction to the header without taking back edges.
+ * Anything other than a pure op or a branch (a print, a store, a call, a load
+ * that might fail first, ...) on the way means that hoisting the instruction
+ * could make it fail before output or memory changes the original program
+ * makes.
+ */
+bool effects_before(const BlockGraph &graph, const Loop &loop, unsigned block, unsigned index)
+{
+  auto has_effect = [](const json &instr) {
+    const std::string &op = instr["op"].get_ref<const std::string &>();
+    return !PURE_OPS.count(op) && op != "jmp" && op != "br" && op != "nop";
+  };
+
+  for (unsigned i = 0; i < index; i++)
+  {
+    if (has_effect(graph.blocks[block][i]))
+    {
+      return true;
+    }
+  }
+
+  std::vector<bool> seen(graph.size(), false);
+  std::vector<unsigned> stack;
+  seen[block] = true;
+  if (block != loop.header)
+  {
+    stack.push_back(block);
+  }
+  while (!stack.empty())
+  {
+    unsigned b = stack.back();
+    stack.pop_back();
+    for (unsigned pred : graph.preds[b])
+    {
+      if (seen[pred] || !loop.contains(pred))
+      {
+        continue;
+      }
+      seen[pred] = true;
+      if (std::any_of(graph.blocks[pred].begin(), graph.blocks[pred].end(), has_effect))
+      {
+        return true;
+      }
+      if (pred != loop.header)
+      {
+        stack.push_back(pred);
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief The whole-function analyses hoisting consults, shared by all loops.
+ *
+ * Hoisting only moves instructions into preheaders that already exist, so
+ * the CFG, and with it the dominators and block order, never changes.
+ * Reaching definitions and liveness do, but only in functions where a loop
+ * actually hoisted something; they are recomputed lazily for the next loop.
+ */
+struct FunctionAnalyses {
+  DominatorTree dominators;
+  std::vector<unsigned> order;
+  ReachingDefinitions rd;
+  LiveVariables liveness;
+
+  /// Set once code has moved since `rd` and `liveness` were computed.
+  bool stale = true;
+
+  /// Recomputes the data-flow analyses if code has moved.
+  void refresh(const BlockGraph &graph, const json &args)
+  {
+    if (stale)
+    {
+      rd = compute_reaching_definitions(graph, args);
+      liveness = compute_live_variables(graph);
+      stale = false;
+    }
+  }
+};
+
+/**
+ * @brief Hoists the invariant computations out of one loop into its preheader.
+ *
+ * An instruction is invariant if it is pure and every argument is either
+ * defined only outside the loop or by a single invariant instruction inside
+ * it.  An invariant instruction defining `x` is hoisted if
+ *   - it is the loop's only definition of `x`,
+ *   - every use of `x` in the loop sees only that definition, and
+ *   - its block dominates every exiting block, or it cannot trap and `x`
+ *     is dead at every exit, so running it when the original would not
+ *     have is unobservable, and
+ *   - if it can trap, nothing observable happens before it on the first
+ *     trip, so a failure still comes before any of the loop's effects.
+ *
+ * @return True if anything was hoisted.
+ */
+bool hoist_loop(BlockGraph &graph, const Loop &loop, const json &args, FunctionAnalyses &analyses)
+{
+  if (loop.preheader == BlockGraph::NONE)
+  {
+    return false;
+  }
+
+  analyses.refresh(graph, args);
+  const DominatorTree &dominators = analyses.dominators;
+  const ReachingDefinitions &rd = analyses.rd;
+  const LiveVariables &liveness = analyses.liveness;
+
+  // How often each variable is defined inside the loop
+  std::unordered_map<std::string, unsigned> defs_in_loop;
+  for (unsigned block : loop.blocks)
+  {
+    for (const auto &instr : graph.blocks[block])
+    {
+      if (instr.contains("dest"))
+      {
+        defs_in_loop[instr["dest"].get<std::string>()]++;
+      }
+    }
+  }
+
+  // Visit the loop in reverse postorder so definitions are seen before their uses
+  std::vector<unsigned> order;
+  for (unsigned block : analyses.order)
+  {
+    if (loop.contains(block))
+    {
+      order.push_back(block);
+    }
+  }
+
+  // Mark invariant definitions until nothing changes, remembering the order they were found in
+  std::vector<bool> invariant(rd.defs.size(), false);
+  std::vector<unsigned> candidates;
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (unsigned block : order)
+    {
+      const std::vector<json> &instrs = graph.blocks[block];
+      for (unsigned i = 0; i < instrs.size(); i++)
+      {
+        unsigned def = rd.def_ids[block][i];
+        if (def == ReachingDefinitions::NONE || invariant[def] ||
+            !PURE_OPS.count(instrs[i]["op"].get<std::string>()))
+        {
+          continue;
+        }
+
+        bool args_invariant = true;
+        if (instrs[i].contains("args"))
+        {
+          for (const auto &arg : instrs[i]["args"])
+          {
+            std::vector<unsigned> reaching = rd.reaching(block, i, arg.get<std::string>());
+            bool from_outside = std::all_of(reaching.begin(), reaching.end(), [&](unsigned d) {
+              return rd.defs[d].block == ReachingDefinitions::ARGUMENT || !loop.contains(rd.defs[d].block);
+            });
+            bool from_invariant = reaching.size() == 1 && invariant[reaching[0]];
+            if (!from_outside && !from_invariant)
+            {
+              args_invariant = false;
+              break;
+            }
+          }
+        }
+
+        if (args_invariant)
+        {
+          invariant[def] = true;
+          candidates.push_back(def);
+          changed = true;
+        }
+      }
+    }
+  }
+
+  // Decide which candidates can move; a candidate may only move if the in-loop definitions it reads move too
+  std::vector<bool> hoisted(rd.defs.size(), false);
+  std::vector<unsigned> to_hoist;
+  for (unsigned def : candidates)
+  {
+    const auto &site = rd.defs[def];
+    const json &instr = graph.blocks[site.block][site.index];
+
+    if (defs_in_loop[site.var] != 1)
+    {
+      continue;
+    }
+
+    // Every use of the variable inside the loop must see only this definition
+    bool sole_reaching = true;
+    for (unsigned block : loop.blocks)
+    {
+      const std::vector<json> &instrs = graph.blocks[block];
+      for (unsigned i = 0; i < instrs.size() && sole_reaching; i++)
+      {
+        if (!instrs[i].contains("args"))
+        {
+          continue;
+        }
+        for (const auto &arg : instrs[i]["args"])
+        {
+          if (arg == site.var)
+          {
+            std::vector<unsigned> reaching = rd.reaching(block, i, site.var);
+            if (reaching.size() != 1 || reaching[0] != def)
+            {
+              sole_reaching = false;
+              break;
+            }
+          }
+        }
+      }
+    }
+    if (!sole_reaching)
+    {
+      continue;
+    }
+
+    // Either it runs on every path out of the loop anyway, or running it early is harmless
+    bool dominates_exits = std::all_of(loop.exiting.begin(), loop.exiting.end(), [&](unsigned exiting) {
+      return dominators.dominates(site.block, exiting);
+    });
+    if (!dominates_exits)
+    {
+      bool dead_at_exits = std::none_of(loop.exits.begin(), loop.exits.end(), [&](unsigned exit) {
+        return liveness.is_live_in(exit, site.var);
+      });
+      if (!dead_at_exits || TRAPPING_OPS.count(instr["op"].get<std::string>()))
+      {
+        continue;
+      }
+    }
+
+    // A trap must not overtake the loop's prints, stores or calls
+    if (TRAPPING_OPS.count(instr["op"].get<std::string>()) && effects_before(graph, loop, site.block, site.index))
+    {
+      continue;
+    }
+
+    // The in-loop definitions it reads must already be on their way out
+    bool operands_hoisted = true;
+    if (instr.contains("args"))
+    {
+      for (const auto &arg : instr["args"])
+      {
+        for (unsigned d : rd.reaching(site.block, site.index, arg.get<std::string>()))
+        {
+          if (rd.defs[d].block != ReachingDefinitions::ARGUMENT && loop.contains(rd.defs[d].block) && !hoisted[d])
+          {
+            operands_hoisted = false;
+          }
+        }
+      }
+    }
+    if (!operands_hoisted)
+    {
+      continue;
+    }
+
+    hoisted[def] = true;
+    to_hoist.push_back(def);
+  }
+
+  if (to_hoist.empty())
+  {
+    return false;
+  }
+
+  // Append the hoisted instructions to the preheader, just before its terminator, in dependence order
+  std::vector<json> &pre = graph.blocks[loop.preheader];
+  json term = pre.back();
+  pre.pop_back();
+  for (unsigned def : to_hoist)
+  {
+    pre.push_back(graph.blocks[rd.defs[def].block][rd.defs[def].index]);
+  }
+  pre.push_back(std::move(term));
+
+  // Then remove them from the loop body
+  for (unsigned block : loop.blocks)
+  {
+    std::vector<json> &instrs = graph.blocks[block];
+    std::vector<json> kept;
+    kept.reserve(instrs.size());
+    for (unsigned i = 0; i < instrs.size(); i++)
+    {
+      unsigned def = rd.def_ids[block][i];
+      if (def == ReachingDefinitions::NONE || !hoisted[def])
+      {
+        kept.push_back(std::move(instrs[i]));
+      }
+    }
+    instrs = std::move(kept);
+  }
+
+  analyses.stale = true;
+  return true;
+}
+
+/**
+ * @brief Runs loop-invariant code motion on a whole function.
+ *
+ * Every loop first gets a preheader.  Loops are then processed innermost
+ * first, so code hoisted out of an inner loop lands in a block of the
+ * enclosing loop and can be hoisted again from there.
+ *
+ * @param func Bril function object; its "instrs" are rewritten in place.
+ * @return True if the function changed.
+ */
+bool licm(json &func)
+{
+  if (!func.contains("instrs"))
+  {
+    return false;
+  }
+
+  BlockGraph graph = form_block_graph(func["instrs"].get<std::vector<json>>());
+  if (graph.size() == 0)
+  {
+    return false;
+  }
+
+  LoopNest nest = find_loops(graph, compute_dominators(graph));
+  if (nest.loops.empty())
+  {
+    return false;
+  }
+  bool changed = insert_preheaders(graph, nest);
+
+  json args = func.contains("args") ? func["args"] : json::array();
+  FunctionAnalyses analyses;
+  analyses.dominators = compute_dominators(graph);
+  analyses.order = reverse_postorder(graph);
+
+  // Inner loops come after their parents in the nest
+  for (unsigned idx = nest.loops.size(); idx-- > 0;)
+  {
+    changed = hoist_loop(graph, nest.loops[idx], args, analyses) || changed;
+  }
+
+  if (changed)
+  {
+    func["instrs"] = reassemble(graph);
+  }
+
+  return changed;
+}
+
+int main()
+{
+  // Read JSON input
+  json program;
+  std::cin >> program;
+
+  // Check if "functions" exists and is an array
+  if (!program.contains("functions") || !program["functions"].is_array())
+  {
+    std::cerr << "Error: Expected a 'functions' key with an array of functions.\n";
+    return 1;
+  }
+
+  for (auto &func : program["functions"])
+  {
+    licm(func);
+  }
+
+  std::cout << program.dump(2) << "\n";
+
+  return 0;
+}
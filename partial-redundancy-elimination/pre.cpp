@@ -0,0 +1,561 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../cfg/block_graph.h"
+#include "../data-flow-analysis/bit_vector.h"
+#include "../data-flow-analysis/live_variables.h"
+
+using json = nlohmann::json;
+
+// Opcodes whose computations can be moved: pure, and unable to fail at runtime
+const std::unordered_set<std::string> PRE_OPS = {
+    "add", "sub", "mul",
+    "eq", "lt", "gt", "le", "ge",
+    "not", "and", "or",
+    "fadd", "fsub", "fmul", "fdiv",
+    "feq", "flt", "fgt", "fle", "fge",
+    "ptradd",
+    "ceq", "clt", "cgt", "cle", "cge", "char2int", "int2char"};
+
+// Opcodes whose arguments can be reordered
+const std::unordered_set<std::string> COMMUTE_OPS = {
+    "add", "mul", "eq", "and", "or", "fadd", "fmul", "feq", "ceq"};
+
+/**
+ * @brief The expressions of a function that PRE may move, numbered densely.
+ */
+struct ExpressionTable {
+  /// Id of each canonical expression key.
+  std::unordered_map<std::string, unsigned> ids;
+
+  /// One instruction computing each expression (its `dest` is rewritten on use).
+  std::vector<json> templates;
+
+  /// Expressions that read each variable, i.e. the ones a definition of it kills.
+  std::unordered_map<std::string, std::vector<unsigned>> readers;
+
+  /// Canonical key of an instruction, or "" if it is not a movable computation.
+  static std::string key(const json &instr)
+  {
+    if (!instr.contains("dest") || !instr.contains("args") || !instr.contains("type") ||
+        !PRE_OPS.count(instr["op"].get<std::string>()))
+    {
+      return "";
+    }
+    std::string op = instr["op"].get<std::string>();
+    std::vector<std::string> args = instr["args"].get<std::vector<std::string>>();
+    if (COMMUTE_OPS.count(op))
+    {
+      std::sort(args.begin(), args.end());
+    }
+    std::string k = op + " " + instr["type"].dump();
+    for (const auto &arg : args)
+    {
+      k += " " + arg;
+    }
+    return k;
+  }
+
+  /// Id of an instruction's expression, adding it if new; `NONE` if it is not movable.
+  unsigned intern(const json &instr)
+  {
+    std::string k = key(instr);
+    if (k.empty())
+    {
+      return BlockGraph::NONE;
+    }
+    auto [it, inserted] = ids.emplace(k, templates.size());
+    if (inserted)
+    {
+      templates.push_back(instr);
+      for (const auto &arg : instr["args"])
+      {
+        readers[arg.get<std::string>()].push_back(it->second);
+      }
+    }
+    return it->second;
+  }
+};
+
+/**
+ * @brief Partial redundancy elimination by lazy code motion.
+ *
+ * Follows Knoop, Rüthing and Steffen's lazy code motion in Drechsler and
+ * Stadel's edge-based form.  Four bit-vector problems over the CFG decide,
+ * for every expression, the latest edges where computing it into a fresh
+ * temporary makes every later computation redundant:
+ *
+ *   ANTIN(b)    = ANTLOC(b) ∪ (TRANSP(b) ∩ ANTOUT(b)),  ANTOUT(b) = ∩ ANTIN(succ)
+ *   AVOUT(b)    = COMP(b) ∪ (TRANSP(b) ∩ AVIN(b)),      AVIN(b)   = ∩ AVOUT(pred)
+ *   EARLIEST(i,j) = ANTIN(j) ∩ ¬AVOUT(i) ∩ (¬TRANSP(i) ∪ ¬ANTOUT(i))
+ *   LATER(i,j)  = EARLIEST(i,j) ∪ (LATERIN(i) ∩ ¬ANTLOC(i)), LATERIN(j) = ∩ LATER(i,j)
+ *   INSERT(i,j) = LATER(i,j) ∩ ¬LATERIN(j),  DELETE(b) = ANTLOC(b) ∩ ¬LATERIN(b)
+ *
+ * Computations are only placed where the expression is anticipated, so no
+ * path evaluates it more often than before, and as late as possible, so
+ * temporaries live no longer than necessary.  Edges that need an insertion
+ * and are critical get a new block.  A computation repeated within a block
+ * reads the temporary as well, and copies out of temporaries whose
+ * destination dies in the block are forwarded to their uses.
+ *
+ * @param func Bril function object; its "instrs" are rewritten in place.
+ * @return True if the function changed.
+ */
+bool lazy_code_motion(json &func)
+{
+  if (!func.contains("instrs"))
+  {
+    return false;
+  }
+
+  BlockGraph graph = form_block_graph(func["instrs"].get<std::vector<json>>());
+  unsigned N = graph.size();
+  if (N == 0)
+  {
+    return false;
+  }
+
+  // Number the expressions
+  ExpressionTable table;
+  std::vector<std::vector<unsigned>> expr_of(N);
+  for (unsigned b = 0; b < N; b++)
+  {
+    for (const auto &instr : graph.blocks[b])
+    {
+      expr_of[b].push_back(table.intern(instr));
+    }
+  }
+  unsigned E = table.templates.size();
+  if (E == 0)
+  {
+    return false;
+  }
+
+  // Local properties, plus where the upward-exposed computations sit in each block and
+  // which expressions a block computes again before any operand changes
+  std::vector<BitVector> antloc(N, BitVector(E)), comp(N, BitVector(E)), transp(N, BitVector(E, true));
+  std::vector<std::unordered_map<unsigned, unsigned>> first_index(N);
+  BitVector locally_redundant(E);
+  for (unsigned b = 0; b < N; b++)
+  {
+    const std::vector<json> &instrs = graph.blocks[b];
+    for (unsigned k = 0; k < instrs.size(); k++)
+    {
+      unsigned e = expr_of[b][k];
+      if (e != BlockGraph::NONE)
+      {
+        // Upward exposed if none of its operands has been redefined yet in this block
+        if (transp[b][e] && !antloc[b][e])
+        {
+          antloc[b].set(e);
+          first_index[b][e] = k;
+        }
+        if (comp[b][e])
+        {
+          locally_redundant.set(e);
+        }
+        comp[b].set(e);
+      }
+
+      // A definition kills every expression that reads the variable, including this one
+      if (instrs[k].contains("dest"))
+      {
+        auto it = table.readers.find(instrs[k]["dest"].get<std::string>());
+        if (it != table.readers.end())
+        {
+          for (unsigned killed : it->second)
+          {
+            comp[b].reset(killed);
+            transp[b].reset(killed);
+          }
+        }
+      }
+    }
+  }
+
+  // Only reachable blocks take part; unreachable predecessors would only weaken the meets
+  std::vector<unsigned> order = reverse_postorder(graph);
+  std::vector<bool> reachable(N, false);
+  for (unsigned b : order)
+  {
+    reachable[b] = true;
+  }
+
+  // Anticipability (backward)
+  std::vector<BitVector> antin(N, BitVector(E, true)), antout(N, BitVector(E, true));
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+      unsigned b = *it;
+      BitVector out(E, !graph.succs[b].empty());
+      for (unsigned s : graph.succs[b])
+      {
+        out &= antin[s];
+      }
+      BitVector in = antloc[b] | (transp[b] & out);
+      antout[b] = std::move(out);
+      if (in != antin[b])
+      {
+        antin[b] = std::move(in);
+        changed = true;
+      }
+    }
+  }
+
+  // Availability (forward)
+  std::vector<BitVector> avout(N, BitVector(E, true));
+  changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (unsigned b : order)
+    {
+      BitVector in(E, b != 0);
+      for (unsigned p : graph.preds[b])
+      {
+        if (reachable[p])
+        {
+          in &= avout[p];
+        }
+      }
+      BitVector out = comp[b] | (transp[b] & in);
+      if (out != avout[b])
+      {
+        avout[b] = std::move(out);
+        changed = true;
+      }
+    }
+  }
+
+  auto earliest = [&](unsigned i, unsigned j) {
+    return antin[j] & ~avout[i] & (~transp[i] | ~antout[i]);
+  };
+
+  // Later (forward); the entry's virtual in-edge is its earliest placement
+  std::vector<BitVector> laterin(N, BitVector(E, true));
+  laterin[0] = antin[0];
+  auto later = [&](unsigned i, unsigned j) {
+    BitVector through = laterin[i];
+    through.reset(antloc[i]);
+    return earliest(i, j) | through;
+  };
+  changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (unsigned j : order)
+    {
+      if (j == 0)
+      {
+        continue;
+      }
+      BitVector in(E, true);
+      for (unsigned i : graph.preds[j])
+      {
+        if (reachable[i])
+        {
+          in &= later(i, j);
+        }
+      }
+      if (in != laterin[j])
+      {
+        laterin[j] = std::move(in);
+        changed = true;
+      }
+    }
+  }
+
+  // Deletions decide which expressions get a temporary at all
+  std::vector<BitVector> deleted(N, BitVector(E));
+  BitVector needed(E);
+  for (unsigned b : order)
+  {
+    deleted[b] = antloc[b];
+    deleted[b].reset(laterin[b]);
+    needed |= deleted[b];
+  }
+
+  // Computations repeated within a block read a temporary as well, even if no code moves
+  BitVector temped = needed | locally_redundant;
+  if (!temped.any())
+  {
+    return false;
+  }
+
+  // Fresh temporary names that clash with no existing variable
+  std::unordered_set<std::string> taken;
+  for (const auto &block : graph.blocks)
+  {
+    for (const auto &instr : block)
+    {
+      if (instr.contains("dest"))
+      {
+        taken.insert(instr["dest"].get<std::string>());
+      }
+    }
+  }
+  if (func.contains("args"))
+  {
+    for (const auto &arg : func["args"])
+    {
+      taken.insert(arg["name"].get<std::string>());
+    }
+  }
+  std::vector<std::string> temp(E);
+  unsigned counter = 0;
+  for (unsigned e = 0; e < E; e++)
+  {
+    if (temped[e])
+    {
+      do
+      {
+        temp[e] = "pre.t" + std::to_string(counter++);
+      } while (taken.count(temp[e]));
+    }
+  }
+
+  // A computation of expression e into its temporary
+  auto compute_into_temp = [&](unsigned e) {
+    json instr = table.templates[e];
+    instr["dest"] = temp[e];
+    return instr;
+  };
+
+  // Rewrite the blocks.  `holds` tracks the temporaries known to hold their expression's
+  // value: a deleted computation finds it there on entry, and any computation made while it
+  // still holds reads it.  Every other computation saves its value into the temporary, in
+  // case something later reads it.  `save_copy` flags the copies that saves introduce.
+  std::vector<std::vector<bool>> save_copy(N);
+  for (unsigned b = 0; b < N; b++)
+  {
+    std::vector<json> &instrs = graph.blocks[b];
+    std::vector<json> rewritten;
+    rewritten.reserve(instrs.size());
+    BitVector holds(E);
+
+    for (unsigned k = 0; k < instrs.size(); k++)
+    {
+      unsigned e = expr_of[b][k];
+      if (e != BlockGraph::NONE && temped[e])
+      {
+        bool is_deleted = deleted[b][e] && first_index[b][e] == k;
+        bool is_saved = !is_deleted && !holds[e];
+        if (is_saved)
+        {
+          rewritten.push_back(compute_into_temp(e));
+          save_copy[b].push_back(false);
+        }
+        json copy = {{"op", "id"}, {"dest", instrs[k]["dest"]}, {"type", instrs[k]["type"]}, {"args", json::array({temp[e]})}};
+        rewritten.push_back(std::move(copy));
+        save_copy[b].push_back(is_saved);
+        holds.set(e);
+      }
+      else
+      {
+        rewritten.push_back(instrs[k]);
+        save_copy[b].push_back(false);
+      }
+
+      if (instrs[k].contains("dest"))
+      {
+        auto it = table.readers.find(instrs[k]["dest"].get<std::string>());
+        if (it != table.readers.end())
+        {
+          for (unsigned killed : it->second)
+          {
+            holds.reset(killed);
+          }
+        }
+      }
+    }
+    instrs = std::move(rewritten);
+  }
+
+  // Insert computations on the chosen edges: at the end of a single-successor source, at the start of a
+  // single-predecessor target, or in a new block splitting a critical edge
+  for (unsigned i : order)
+  {
+    // A branch with both targets the same is still one edge
+    std::vector<unsigned> succs = graph.succs[i];
+    std::sort(succs.begin(), succs.end());
+    succs.erase(std::unique(succs.begin(), succs.end()), succs.end());
+    for (unsigned j : succs)
+    {
+      BitVector insert = later(i, j);
+      insert.reset(laterin[j]);
+      insert &= needed;
+      if (!insert.any())
+      {
+        continue;
+      }
+
+      std::vector<json> computations;
+      for (unsigned e = 0; e < E; e++)
+      {
+        if (insert[e])
+        {
+          computations.push_back(compute_into_temp(e));
+        }
+      }
+
+      std::vector<json> &source = graph.blocks[i];
+      if (graph.succs[i].size() == 1)
+      {
+        source.insert(source.end() - 1, computations.begin(), computations.end());
+        save_copy[i].insert(save_copy[i].end() - 1, computations.size(), false);
+      }
+      else if (graph.preds[j].size() == 1)
+      {
+        graph.blocks[j].insert(graph.blocks[j].begin(), computations.begin(), computations.end());
+        save_copy[j].insert(save_copy[j].begin(), computations.size(), false);
+      }
+      else
+      {
+        unsigned split = graph.add_block("pre.edge");
+        computations.push_back(json{{"op", "jmp"}, {"labels", json::array({graph.names[j]})}});
+        graph.blocks[split] = std::move(computations);
+        save_copy.emplace_back(graph.blocks[split].size(), false);
+        for (auto &label : graph.blocks[i].back()["labels"])
+        {
+          if (label == graph.names[j])
+          {
+            label = graph.names[split];
+          }
+        }
+      }
+    }
+  }
+  graph.recompute_edges();
+
+  // Undo saves whose temporary nothing reads: `t = e; x = id t` goes back to `x = e`
+  std::unordered_set<std::string> temps;
+  for (unsigned e = 0; e < E; e++)
+  {
+    if (temped[e])
+    {
+      temps.insert(temp[e]);
+    }
+  }
+  LiveVariables liveness = compute_live_variables(graph);
+  for (unsigned b = 0; b < graph.size(); b++)
+  {
+    std::vector<json> &instrs = graph.blocks[b];
+    std::vector<bool> live = liveness.live_out[b];
+    std::vector<bool> drop(instrs.size(), false);
+
+    for (unsigned k = instrs.size(); k-- > 0;)
+    {
+      const json &instr = instrs[k];
+      if (save_copy[b][k] && !live[liveness.var_ids.at(instr["args"][0].get<std::string>())])
+      {
+        // Fold the copy's destination back into the computation right before it
+        instrs[k - 1]["dest"] = instr["dest"];
+        drop[k] = true;
+        continue;
+      }
+      if (instr.contains("dest"))
+      {
+        live[liveness.var_ids.at(instr["dest"].get<std::string>())] = false;
+      }
+      if (instr.contains("args"))
+      {
+        for (const auto &arg : instr["args"])
+        {
+          live[liveness.var_ids.at(arg.get<std::string>())] = true;
+        }
+      }
+    }
+
+    // Forward the other copies out of temporaries when their destination dies in this block:
+    // `x = id t; ... use x` becomes `... use t`, provided t is not reassigned before the uses
+    for (unsigned k = 0; k < instrs.size(); k++)
+    {
+      const json &instr = instrs[k];
+      if (drop[k] || !instr.contains("op") || instr["op"] != "id" ||
+          !temps.count(instr["args"][0].get<std::string>()))
+      {
+        continue;
+      }
+      const std::string x = instr["dest"].get<std::string>();
+      const std::string t = instr["args"][0].get<std::string>();
+      std::vector<unsigned> uses;
+      bool forwardable = true, redefined = false, t_reassigned = false;
+      for (unsigned j = k + 1; j < instrs.size() && forwardable && !redefined; j++)
+      {
+        if (drop[j])
+        {
+          continue;
+        }
+        if (instrs[j].contains("args") && std::find(instrs[j]["args"].begin(), instrs[j]["args"].end(), x) != instrs[j]["args"].end())
+        {
+          forwardable = !t_reassigned;
+          uses.push_back(j);
+        }
+        if (instrs[j].contains("dest"))
+        {
+          redefined = instrs[j]["dest"] == x;
+          t_reassigned = t_reassigned || instrs[j]["dest"] == t;
+        }
+      }
+      if (!forwardable || (!redefined && liveness.live_out[b][liveness.var_ids.at(x)]))
+      {
+        continue;
+      }
+      for (unsigned j : uses)
+      {
+        for (auto &arg : instrs[j]["args"])
+        {
+          if (arg == x)
+          {
+            arg = t;
+          }
+        }
+      }
+      drop[k] = true;
+    }
+
+    std::vector<json> kept;
+    kept.reserve(instrs.size());
+    for (unsigned k = 0; k < instrs.size(); k++)
+    {
+      if (!drop[k])
+      {
+        kept.push_back(std::move(instrs[k]));
+      }
+    }
+    instrs = std::move(kept);
+  }
+
+  func["instrs"] = reassemble(graph);
+  return true;
+}
+
+int main()
+{
+  // Read JSON input
+  json program;
+  std::cin >> program;
+
+  // Check if "functions" exists and is an array
+  if (!program.contains("functions") || !program["functions"].is_array())
+  {
+    std::cerr << "Error: Expected a 'functions' key with an array of functions.\n";
+    return 1;
+  }
+
+  for (auto &func : program["functions"])
+  {
+    lazy_code_motion(func);
+  }
+
+  std::cout << program.dump(2) << "\n";
+
+  return 0;
+}
@@ -0,0 +1,104 @@
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include "batch.hpp"
+#include "thread-pool.hpp"
+#include "trace-injector.hpp"
+#include "trace-loader.hpp"
+
+namespace trace {
+
+bool parseJob(const std::string& line, Job& job){
+  size_t start = line.find_first_not_of(" \t\r");
+  if (start == std::string::npos || line[start] == '#') {
+    return false;
+  }
+
+  std::vector<std::string> fields;
+  if (line.find('\t') != std::string::npos) {
+    std::stringstream in(line);
+    std::string field;
+    while (std::getline(in, field, '\t')) {
+      if (!field.empty() && field.back() == '\r') {
+        field.pop_back();
+      }
+      fields.push_back(field);
+    }
+  }
+  else {
+    std::stringstream in(line);
+    std::string field;
+    while (in >> field) {
+      fields.push_back(field);
+    }
+  }
+
+  if (fields.size() != 3) {
+    throw std::runtime_error("expected 'program trace output', got: " + line);
+  }
+  job = {fields[0], fields[1], fields[2]};
+  return true;
+}
+
+void runJob(const Job& job, ProgramCache& cache){
+  std::vector<Instruction> guardedInstrs = traceLoader(job.trace);
+  std::shared_ptr<const nlohmann::json> program = cache.get(job.program);
+  writeProgram(*program, guardedInstrs, job.output);
+}
+
+int runBatch(const std::string& manifestPath, unsigned threads){
+  std::ifstream manifestFile;
+  if (manifestPath != "-") {
+    manifestFile.open(manifestPath);
+    if (!manifestFile) {
+      std::cerr << "cannot open manifest " << manifestPath << "\n";
+      return 1;
+    }
+  }
+  std::istream& manifest = manifestPath == "-" ? std::cin : manifestFile;
+
+  // Read the whole manifest first, so a malformed line stops the batch before anything runs
+  std::vector<Job> jobs;
+  std::string line;
+  for (size_t lineNo = 1; std::getline(manifest, line); lineNo++) {
+    Job job;
+    try {
+      if (parseJob(line, job)) {
+        jobs.push_back(std::move(job));
+      }
+    }
+    catch (const std::exception& e) {
+      std::cerr << manifestPath << ":" << lineNo << ": " << e.what() << "\n";
+      return 1;
+    }
+  }
+
+  ProgramCache cache;
+  std::atomic<size_t> failed{0};
+  std::mutex errMutex;
+  {
+    ThreadPool pool(threads);
+    for (const Job& job : jobs) {
+      pool.submit([&] {
+        try {
+          runJob(job, cache);
+        }
+        catch (const std::exception& e) {
+          failed++;
+          std::lock_guard<std::mutex> lock(errMutex);
+          std::cerr << job.program << " + " << job.trace << ": " << e.what() << "\n";
+        }
+      });
+    }
+    pool.wait();
+  }
+
+  std::cerr << jobs.size() - failed << "/" << jobs.size() << " jobs done, "
+            << cache.loads() << " programs parsed\n";
+  return failed ? 1 : 0;
+}
+
+} // namespace trace
@@ -0,0 +1,55 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <string>
+#include <vector>
+#include "program-cache.hpp"
+
+namespace trace {
+
+/**
+ * @brief One trace injection: a program, a trace for it, and where the result goes.
+ */
+struct Job {
+  std::string program;
+  std::string trace;
+  std::string output;
+};
+
+/**
+ * @brief Parses one manifest line into a job.
+ *
+ * The three fields are separated by tabs, or by whitespace if the line has
+ * no tabs (so paths containing spaces need the tab form).
+ *
+ * @return False for blank lines and `#` comments.
+ * @throws std::runtime_error
+ *   If the line does not have exactly three fields.
+ */
+bool parseJob(const std::string& line, Job& job);
+
+/**
+ * @brief Loads the job's trace, injects it into the (cached) program, and writes the result.
+ *
+ * @throws Whatever loading, parsing or writing throws.
+ */
+void runJob(const Job& job, ProgramCache& cache);
+
+/**
+ * @brief Runs every job in a manifest on a thread pool.
+ *
+ * Programs shared by several jobs are parsed once.  Failed jobs are reported
+ * on stderr and do not stop the others.
+ *
+ * @param manifestPath
+ *   File with one job per line (see `parseJob`), or `"-"` for stdin.
+ * @param threads
+ *   Worker threads; 0 means one per hardware thread.
+ * @return
+ *   0 if every job succeeded, 1 otherwise.
+ */
+int runBatch(const std::string& manifestPath, unsigned threads);
+
+} // namespace trace
+
+#endif // BATCH_HPP
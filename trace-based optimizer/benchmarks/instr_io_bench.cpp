@@ -0,0 +1,173 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../../utils.hpp"
+
+using json = nlohmann::json;
+
+/*
+ * Compares the two ways of reading and writing Instructions:
+ *   - through a DOM: json::parse + from_json, and to_json + dump
+ *   - directly: parse_instructions and dump_instructions
+ *
+ * Usage: instr_io_bench [--min-time SECONDS] [--instrs N] [trace.json ...]
+ *
+ * Each trace is a JSON array of instructions, as trace-loader reads.  Without
+ * one, a synthetic trace of --instrs instructions (a few MB) is used.  Both
+ * paths must agree on every trace before anything is timed.
+ *
+ * Reported per trace and path: MB of JSON per second, nanoseconds and heap
+ * allocations per instruction.
+ */
+
+namespace {
+
+// Heap traffic while a measurement is running
+bool counting = false;
+size_t allocations = 0;
+
+void *allocate(size_t size)
+{
+  if (counting)
+  {
+    allocations++;
+  }
+  if (void *p = std::malloc(size ? size : 1))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+/// Runs `run` repeatedly until min_time has passed and prints one row of the report.
+void measure(const std::string &name, size_t bytes, size_t instrs, double min_time, const std::function<void()> &run)
+{
+  using clock = std::chrono::steady_clock;
+  size_t passes = 0;
+  allocations = 0;
+  counting = true;
+  auto start = clock::now();
+  double seconds = 0;
+  while (passes == 0 || seconds < min_time)
+  {
+    run();
+    passes++;
+    seconds = std::chrono::duration<double>(clock::now() - start).count();
+  }
+  counting = false;
+
+  double total = double(instrs) * passes;
+  std::printf("  %-10s %10.1f MB/s %10.1f ns/instr %10.2f allocs/instr\n", name.c_str(),
+              double(bytes) * passes / seconds / 1e6, seconds * 1e9 / total, allocations / total);
+}
+
+/// A trace of `count` instructions with the mix of ops, types and fields real traces have.
+std::string synthetic_trace(size_t count)
+{
+  std::mt19937 rng(1);
+  auto var = [&]() { return "v" + std::to_string(rng() % 64); };
+  json trace = json::array();
+  for (size_t k = 0; k < count; k++)
+  {
+    switch (rng() % 8)
+    {
+    case 0:
+      trace.push_back({{"op", "const"}, {"dest", var()}, {"type", "int"}, {"value", int(rng() % 1000) - 500}});
+      break;
+    case 1:
+      trace.push_back({{"op", "const"}, {"dest", var()}, {"type", "bool"}, {"value", bool(rng() % 2)}});
+      break;
+    case 2:
+      trace.push_back({{"op", "br"}, {"args", {var()}}, {"labels", {"then." + std::to_string(k), "else." + std::to_string(k)}}});
+      break;
+    case 3:
+      trace.push_back({{"op", "call"}, {"dest", var()}, {"type", "int"}, {"funcs", {"helper"}}, {"args", {var(), var()}}});
+      break;
+    case 4:
+      trace.push_back({{"op", "load"}, {"dest", var()}, {"type", {{"ptr", "int"}}}, {"args", {var()}}});
+      break;
+    case 5:
+      trace.push_back({{"op", "print"}, {"args", {var()}}});
+      break;
+    default:
+      trace.push_back({{"op", rng() % 2 ? "add" : "mul"}, {"dest", var()}, {"type", "int"}, {"args", {var(), var()}}});
+      break;
+    }
+  }
+  return trace.dump();
+}
+
+} // namespace
+
+void *operator new(size_t size) { return allocate(size); }
+void *operator new[](size_t size) { return allocate(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+int main(int argc, char **argv)
+{
+  double min_time = 0.5;
+  size_t count = 50000;
+  std::vector<std::pair<std::string, std::string>> traces;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (arg == "--min-time" && i + 1 < argc)
+    {
+      min_time = std::stod(argv[++i]);
+    }
+    else if (arg == "--instrs" && i + 1 < argc)
+    {
+      count = std::stoul(argv[++i]);
+    }
+    else
+    {
+      std::ifstream in(arg);
+      if (!in)
+      {
+        std::cerr << "instr_io_bench: cannot open " << arg << "\n";
+        return 1;
+      }
+      std::stringstream text;
+      text << in.rdbuf();
+      traces.push_back({arg, text.str()});
+    }
+  }
+  if (traces.empty())
+  {
+    traces.push_back({"synthetic", synthetic_trace(count)});
+  }
+
+  for (const auto &[name, text] : traces)
+  {
+    // Both readers and both writers have to agree before their speed means anything
+    std::vector<Instruction> dom = json::parse(text).get<std::vector<Instruction>>();
+    std::vector<Instruction> sax = parse_instructions(text);
+    std::string dom_out = json(dom).dump();
+    if (json(sax).dump() != dom_out || dump_instructions(dom) != dom_out)
+    {
+      std::cerr << "instr_io_bench: " << name << ": the direct reader or writer disagrees with from_json/to_json\n";
+      return 1;
+    }
+
+    std::printf("%s: %zu instructions, %.1f MB\n", name.c_str(), dom.size(), text.size() / 1e6);
+    std::printf(" read\n");
+    measure("dom", text.size(), dom.size(), min_time, [&]() { json::parse(text).get<std::vector<Instruction>>(); });
+    measure("direct", text.size(), dom.size(), min_time, [&]() { parse_instructions(text); });
+    std::printf(" write\n");
+    measure("dom", dom_out.size(), dom.size(), min_time, [&]() { json(dom).dump(); });
+    measure("direct", dom_out.size(), dom.size(), min_time, [&]() { dump_instructions(dom); });
+  }
+  return 0;
+}
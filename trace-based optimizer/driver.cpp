@@ -1,39 +1,86 @@
 #include "trace-injector.hpp"
 #include "trace-loader.hpp"
 #include "driver.hpp"
-#include <iostream>  
+#include "batch.hpp"
+#include "server.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+void usage() {
+  std::cerr << "Usage:\n"
+            << "  # JSON on stdin, default hot-path:\n"
+            << "    ./trace_driver\n\n"
+            << "  # program.json only (default hot-path):\n"
+            << "    ./trace_driver program.json\n\n"
+            << "  # program.json and hot-path:\n"
+            << "    ./trace_driver program.json hot.trace\n\n"
+            << "  # any of the above, writing somewhere other than ./output:\n"
+            << "    ./trace_driver program.json hot.trace -o out.json\n\n"
+            << "  # many jobs, one 'program trace output' per line, on N threads:\n"
+            << "    ./trace_driver --batch manifest.txt [-j N]\n\n"
+            << "  # stay up and take jobs on a Unix socket, keeping programs parsed:\n"
+            << "    ./trace_driver --serve /tmp/trace_driver.sock [-j N]\n";
+}
+
+} // namespace
 
 int main(int argc, char** argv) {
-  std::string progPath  = "-";         // "-" means read JSON from stdin
-  std::string hotPath   = "my.trace";  // default hot-path
+  std::string progPath   = "-";         // "-" means read JSON from stdin
+  std::string hotPath    = "my.trace";  // default hot-path
+  std::string outputPath = "output";
+  std::string manifest, socketPath;
+  unsigned threads = 0;                 // 0 means one per hardware thread
 
-  if (argc == 2) {
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-o" && hasValue) {
+      outputPath = argv[++i];
+    } else if (arg == "-j" && hasValue) {
+      threads = std::stoul(argv[++i]);
+    } else if (arg == "--batch" && hasValue) {
+      manifest = argv[++i];
+    } else if (arg == "--serve" && hasValue) {
+      socketPath = argv[++i];
+    } else if (arg.size() > 1 && arg[0] == '-') {
+      usage();
+      return 1;
+    } else {
+      positional.push_back(arg);
+    }
+  }
+
+  if (!manifest.empty() || !socketPath.empty()) {
+    if (!positional.empty() || (!manifest.empty() && !socketPath.empty())) {
+      usage();
+      return 1;
+    }
+    return manifest.empty() ? trace::serve(socketPath, threads) : trace::runBatch(manifest, threads);
+  }
+
+  if (positional.size() >= 1) {
     // one argument → program file
-    progPath = argv[1];
-  } else if (argc == 3) {
+    progPath = positional[0];
+  }
+  if (positional.size() == 2) {
     // two arguments → program file & hot-path
-    progPath = argv[1];
-    hotPath  = argv[2];
-  } else if (argc > 3) {
-    std::cerr << "Usage:\n"
-              << "  # JSON on stdin, default hot-path:\n"
-              << "    ./trace_driver\n\n"
-              << "  # JSON on stdin, override hot-path:\n"
-              << "    ./trace_driver <hot.trace>\n\n"
-              << "  # program.json only (default hot-path):\n"
-              << "    ./trace_driver program.json\n\n"
-              << "  # program.json and hot-path:\n"
-              << "    ./trace_driver program.json hot.trace\n";
+    hotPath = positional[1];
+  } else if (positional.size() > 2) {
+    usage();
     return 1;
   }
-  return driver(progPath, hotPath);
+  return driver(progPath, hotPath, outputPath);
 }
 
-int driver(const std::string& programPath, const std::string& hotPathPath)
+int driver(const std::string& programPath, const std::string& hotPathPath, const std::string& outputPath)
 {
   std::vector<Instruction> guardedInstrs = trace::traceLoader(hotPathPath);
 
-  trace::injectTrace(programPath, guardedInstrs, "output");
+  trace::injectTrace(programPath, guardedInstrs, outputPath);
 
   return 0;
 
@@ -14,7 +14,7 @@
  * It reads a “hot-path” trace from the given JSON file, wraps any branches
  * in guards (via traceLoader), then injects that guarded trace into the
  * specified Bril program (via injectTrace).  The modified program is
- * written to the hard-coded path `"data/output"`.
+ * written to `outputPath`.
  *
  * @param programPath
  *   Filesystem path to the input Bril program (JSON).  Must contain a
@@ -24,8 +24,11 @@
  *   Filesystem path to the JSON trace file.  The file must be a JSON array
  *   of `Instruction` objects (e.g., `[ { "op": "add", … }, … ]`).
  *
+ * @param outputPath
+ *   Where the modified program is written; overwritten if it exists.
+ *
  * @return
- *   Exit status code (currently always returns 1).
+ *   Exit status code (currently always returns 0).
  *
  * @throws std::runtime_error
  *   Propagates any I/O or JSON parsing errors from `traceLoader` or
@@ -33,7 +36,8 @@
  */
 int driver(
     const std::string& programPath,
-    const std::string& hotPathPath
+    const std::string& hotPathPath,
+    const std::string& outputPath = "output"
 );
 
 #endif // DRIVER_HPP
@@ -0,0 +1,72 @@
+#include <system_error>
+#include "program-cache.hpp"
+#include "trace-injector.hpp"
+
+namespace trace {
+
+using json = nlohmann::json;
+
+std::shared_ptr<const json> ProgramCache::get(const std::string& path){
+  // Stdin and files that cannot be stat'ed are not cached; loadProgram reports the error
+  std::error_code ec;
+  auto mtime = std::filesystem::last_write_time(path, ec);
+  auto size = ec ? 0 : std::filesystem::file_size(path, ec);
+  if (path == "-" || path.empty() || ec) {
+    return std::make_shared<const json>(loadProgram(path));
+  }
+
+  std::promise<std::shared_ptr<const json>> promise;
+  std::shared_future<std::shared_ptr<const json>> program;
+  uint64_t id = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(path);
+    if (it != entries.end() && it->second.mtime == mtime && it->second.size == size) {
+      it->second.lastUse = ++clock;
+      program = it->second.program;
+    }
+    else {
+      // This thread loads it; others asking meanwhile wait on the same future
+      id = ++clock;
+      program = promise.get_future().share();
+      entries[path] = Entry{mtime, size, program, id, id};
+      loadCount++;
+      evict();
+    }
+  }
+
+  if (id) {
+    try {
+      promise.set_value(std::make_shared<const json>(loadProgram(path)));
+    }
+    catch (...) {
+      // Hand the error to everyone waiting, but let the next request try again
+      promise.set_exception(std::current_exception());
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = entries.find(path);
+      if (it != entries.end() && it->second.id == id) {
+        entries.erase(it);
+      }
+    }
+  }
+  return program.get();
+}
+
+size_t ProgramCache::loads() const{
+  std::lock_guard<std::mutex> lock(mutex);
+  return loadCount;
+}
+
+void ProgramCache::evict(){
+  while (entries.size() > capacity) {
+    auto oldest = entries.begin();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+      if (it->second.lastUse < oldest->second.lastUse) {
+        oldest = it;
+      }
+    }
+    entries.erase(oldest);
+  }
+}
+
+} // namespace trace
@@ -0,0 +1,59 @@
+#ifndef PROGRAM_CACHE_HPP
+#define PROGRAM_CACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+namespace trace {
+
+/**
+ * @brief Parsed Bril programs, kept between jobs that use the same file.
+ *
+ * Programs are keyed by path and re-read when the file's modification time
+ * or size changes.  It is safe to use from several threads: when two of them
+ * ask for a program that is not loaded yet, one parses it and the other
+ * waits for that result instead of parsing it again.  Past `capacity`
+ * programs, the least recently used one is dropped.
+ */
+class ProgramCache {
+public:
+  explicit ProgramCache(size_t capacity = 64) : capacity(capacity) {}
+
+  /**
+   * @brief Returns the parsed program at `path`, loading it if needed.
+   *
+   * @throws std::runtime_error or nlohmann::json::parse_error
+   *   As `loadProgram` does.  Failures are not cached.
+   */
+  std::shared_ptr<const nlohmann::json> get(const std::string& path);
+
+  /// Number of programs parsed so far, for reporting.
+  size_t loads() const;
+
+private:
+  struct Entry {
+    std::filesystem::file_time_type mtime;
+    std::uintmax_t size;
+    std::shared_future<std::shared_ptr<const nlohmann::json>> program;
+    uint64_t id;         /**< Tells a reload of the same path from this one. */
+    uint64_t lastUse;
+  };
+
+  void evict();
+
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, Entry> entries;
+  size_t capacity;
+  uint64_t clock = 0;
+  size_t loadCount = 0;
+};
+
+} // namespace trace
+
+#endif // PROGRAM_CACHE_HPP
@@ -0,0 +1,238 @@
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "batch.hpp"
+#include "program-cache.hpp"
+#include "server.hpp"
+#include "thread-pool.hpp"
+
+namespace trace {
+
+namespace {
+
+// Writes all of `reply`, retrying short writes; false if the client went away
+bool sendAll(int fd, const std::string& reply){
+  size_t sent = 0;
+  while (sent < reply.size()) {
+    ssize_t n = ::send(fd, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+/// A client connection.  Only the accept loop touches it; workers get a line and the fd.
+struct Connection {
+  std::string buffer;             /**< Bytes received after the last complete line. */
+  std::deque<std::string> lines;  /**< Complete lines not started yet, in order. */
+  bool busy = false;              /**< One of its jobs is on the pool. */
+  bool eof = false;               /**< The client will send nothing more. */
+  bool broken = false;            /**< A reply could not be delivered. */
+};
+
+// Moves the complete lines at the front of the connection's buffer onto its queue
+void takeLines(Connection& conn){
+  size_t newline;
+  while ((newline = conn.buffer.find('\n')) != std::string::npos) {
+    std::string line = conn.buffer.substr(0, newline);
+    conn.buffer.erase(0, newline + 1);
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    conn.lines.push_back(std::move(line));
+  }
+}
+
+// Runs one job line and sends its reply; false if the client went away
+bool answer(int fd, const std::string& line, ProgramCache& cache){
+  std::string reply;
+  try {
+    Job job;
+    if (!parseJob(line, job)) {
+      return true;
+    }
+    runJob(job, cache);
+    reply = "ok\n";
+  }
+  catch (const std::exception& e) {
+    reply = std::string("error: ") + e.what() + "\n";
+  }
+  return sendAll(fd, reply);
+}
+
+} // namespace
+
+int serve(const std::string& socketPath, unsigned threads){
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof addr.sun_path) {
+    std::cerr << "socket path too long: " << socketPath << "\n";
+    return 1;
+  }
+  std::strcpy(addr.sun_path, socketPath.c_str());
+
+  int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    std::cerr << "socket: " << std::strerror(errno) << "\n";
+    return 1;
+  }
+  ::unlink(socketPath.c_str());
+  if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0 || ::listen(listenFd, 64) < 0) {
+    std::cerr << socketPath << ": " << std::strerror(errno) << "\n";
+    ::close(listenFd);
+    return 1;
+  }
+
+  // Workers report finished jobs through `done` and wake the loop with a byte on this pipe
+  int wake[2];
+  if (::pipe(wake) < 0) {
+    std::cerr << "pipe: " << std::strerror(errno) << "\n";
+    ::close(listenFd);
+    return 1;
+  }
+
+  ProgramCache cache;
+  std::unordered_map<int, Connection> connections;
+  std::mutex doneMutex;
+  std::vector<std::pair<int, bool>> done;  // Connection of each finished job, and whether its reply went out
+  bool stopping = false;
+  bool failed = false;
+  {
+    ThreadPool pool(threads);
+    std::cerr << "trace_driver: serving on " << socketPath << " with " << pool.size() << " threads\n";
+
+    // Starts the connection's next job unless one is already running, so its replies stay in order
+    auto dispatch = [&](int fd, Connection& conn) {
+      while (!conn.busy && !conn.broken && !conn.lines.empty()) {
+        std::string line = std::move(conn.lines.front());
+        conn.lines.pop_front();
+        if (line == "shutdown") {
+          // Stop accepting and reading; jobs already received still run and get their replies
+          stopping = true;
+          conn.broken = !sendAll(fd, "ok\n");
+          continue;
+        }
+        conn.busy = true;
+        pool.submit([fd, line = std::move(line), &cache, &doneMutex, &done, wakeFd = wake[1]] {
+          bool sent = answer(fd, line, cache);
+          {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            done.push_back({fd, sent});
+          }
+          char byte = 0;
+          while (::write(wakeFd, &byte, 1) < 0 && errno == EINTR) {
+          }
+        });
+      }
+    };
+
+    std::vector<pollfd> fds;
+    while (true) {
+      // Close connections with nothing left to do
+      for (auto it = connections.begin(); it != connections.end();) {
+        const Connection& conn = it->second;
+        bool finished = conn.broken || ((conn.eof || stopping) && conn.lines.empty());
+        if (!conn.busy && finished) {
+          ::close(it->first);
+          it = connections.erase(it);
+        }
+        else {
+          ++it;
+        }
+      }
+      if (stopping && connections.empty()) {
+        break;
+      }
+
+      // An idle client costs a pollfd, not a worker
+      fds.clear();
+      fds.push_back({wake[0], POLLIN, 0});
+      if (!stopping) {
+        fds.push_back({listenFd, POLLIN, 0});
+        for (const auto& [fd, conn] : connections) {
+          if (!conn.eof && !conn.broken) {
+            fds.push_back({fd, POLLIN, 0});
+          }
+        }
+      }
+      if (::poll(fds.data(), fds.size(), -1) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        std::cerr << "poll: " << std::strerror(errno) << "\n";
+        failed = stopping = true;
+        continue;
+      }
+
+      for (const pollfd& p : fds) {
+        if (!p.revents) {
+          continue;
+        }
+        if (p.fd == wake[0]) {
+          char bytes[64];
+          (void)!::read(wake[0], bytes, sizeof bytes);
+          std::vector<std::pair<int, bool>> finished;
+          {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            finished.swap(done);
+          }
+          for (const auto& [fd, sent] : finished) {
+            Connection& conn = connections[fd];
+            conn.busy = false;
+            conn.broken = conn.broken || !sent;
+            dispatch(fd, conn);
+          }
+        }
+        else if (p.fd == listenFd) {
+          int fd = ::accept(listenFd, nullptr, nullptr);
+          if (fd >= 0) {
+            connections[fd];
+          }
+          else if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN) {
+            std::cerr << "accept: " << std::strerror(errno) << "\n";
+            failed = stopping = true;
+          }
+        }
+        else {
+          Connection& conn = connections[p.fd];
+          char chunk[4096];
+          ssize_t n = ::recv(p.fd, chunk, sizeof chunk, 0);
+          if (n < 0 && errno == EINTR) {
+            continue;
+          }
+          if (n <= 0) {
+            conn.eof = true;
+            continue;
+          }
+          conn.buffer.append(chunk, n);
+          takeLines(conn);
+          dispatch(p.fd, conn);
+        }
+      }
+    }
+  }
+
+  ::close(wake[0]);
+  ::close(wake[1]);
+  ::close(listenFd);
+  ::unlink(socketPath.c_str());
+  std::cerr << "trace_driver: stopped after parsing " << cache.loads() << " programs\n";
+  return failed ? 1 : 0;
+}
+
+} // namespace trace
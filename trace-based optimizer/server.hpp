@@ -0,0 +1,33 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <string>
+
+namespace trace {
+
+/**
+ * @brief Serves trace injections on a local Unix socket until told to stop.
+ *
+ * Clients send jobs one per line, in the manifest format `parseJob` reads
+ * (`program <TAB> trace <TAB> output`), and get one line back per job:
+ * `ok`, or `error: <message>`.  A connection may send any number of jobs;
+ * they run, and are answered, in order.  One thread polls the socket and
+ * all connections and hands each complete line to a thread pool, so jobs
+ * from different connections run concurrently and an idle connection never
+ * holds a worker.  Parsed programs stay cached across all connections,
+ * re-read only when the file changes.  The line `shutdown` stops the server
+ * from accepting connections or reading more input; jobs already received
+ * still run and get their replies, then every connection is closed.
+ *
+ * @param socketPath
+ *   Filesystem path of the socket.  A stale socket left there is replaced.
+ * @param threads
+ *   Jobs run at once; 0 means one per hardware thread.
+ * @return
+ *   0 after a shutdown request, 1 if the socket could not be set up or polling failed.
+ */
+int serve(const std::string& socketPath, unsigned threads);
+
+} // namespace trace
+
+#endif // SERVER_HPP
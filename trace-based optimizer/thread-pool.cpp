@@ -0,0 +1,63 @@
+#include <algorithm>
+#include "thread-pool.hpp"
+
+namespace trace {
+
+ThreadPool::ThreadPool(unsigned threads){
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  workers.reserve(threads);
+  for (unsigned i = 0; i < threads; i++) {
+    workers.emplace_back([this] { work(); });
+  }
+}
+
+ThreadPool::~ThreadPool(){
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  ready.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> task){
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push_back(std::move(task));
+  }
+  ready.notify_one();
+}
+
+void ThreadPool::wait(){
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this] { return tasks.empty() && running == 0; });
+}
+
+void ThreadPool::work(){
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+    // Drain the queue before stopping, so nothing submitted is lost
+    if (tasks.empty()) {
+      return;
+    }
+    std::function<void()> task = std::move(tasks.front());
+    tasks.pop_front();
+    running++;
+
+    lock.unlock();
+    task();
+    lock.lock();
+
+    running--;
+    if (tasks.empty() && running == 0) {
+      idle.notify_all();
+    }
+  }
+}
+
+} // namespace trace
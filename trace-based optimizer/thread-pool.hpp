@@ -0,0 +1,57 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace trace {
+
+/**
+ * @brief A fixed set of worker threads running tasks from a shared queue.
+ *
+ * Tasks run in submission order, as workers become free.  A task that throws
+ * terminates the program, so tasks are expected to catch and report their
+ * own errors.
+ */
+class ThreadPool {
+public:
+  /**
+   * @param threads
+   *   Number of workers; 0 means one per hardware thread.
+   */
+  explicit ThreadPool(unsigned threads = 0);
+
+  /// Runs every task still queued, then joins the workers.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// Queues a task to run on some worker.
+  void submit(std::function<void()> task);
+
+  /// Blocks until the queue is empty and no task is running.
+  void wait();
+
+  /// Number of worker threads.
+  unsigned size() const { return workers.size(); }
+
+private:
+  void work();
+
+  std::mutex mutex;
+  std::condition_variable ready;   /**< Signalled when a task is queued or the pool stops. */
+  std::condition_variable idle;    /**< Signalled when the last running task finishes. */
+  std::deque<std::function<void()>> tasks;
+  unsigned running = 0;
+  bool stopping = false;
+  std::vector<std::thread> workers;
+};
+
+} // namespace trace
+
+#endif // THREAD_POOL_HPP
@@ -1,5 +1,7 @@
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
 #include <vector>
 #include <string>
 #include <nlohmann/json.hpp>
@@ -9,38 +11,45 @@ namespace trace {
 
 using json = nlohmann::json;
 
-void injectTrace(const std::string& path, const std::vector<Instruction>& guardedTrace, const std::string& outputPath){
+json loadProgram(const std::string& path){
   // Read the program from its json source file or stdin
-  json j;
   if (path == "-" || path.empty()){
+    json j;
     std::cin >> j;
+    return j;
   }
-  else {
-    std::ifstream programFile(path);
-  
-    programFile >> j;
+  std::ifstream programFile(path);
+  if (!programFile) {
+    throw std::runtime_error("cannot open program " + path);
   }
+  // Parse from memory; going through the stream a byte at a time is much slower
+  std::string text{std::istreambuf_iterator<char>(programFile), std::istreambuf_iterator<char>()};
+  return json::parse(text);
+}
 
-
+json injectTrace(json j, const std::vector<Instruction>& guardedTrace){
   // pick out the “main” function’s instrs array
-  auto& funcs = j.at("functions");
-  json instrsJson;
-  for (auto& f : funcs) {
+  json* mainInstrs = nullptr;
+  for (auto& f : j.at("functions")) {
     if (f.at("name") == "main") {
-      instrsJson = f.at("instrs");
+      mainInstrs = &f.at("instrs");
       break;
     }
   }
-  // convert the JSON array into a vector<Instruction>
-  auto allInstrs = instrsJson.get<std::vector<Instruction>>();
+  if (!mainInstrs) {
+    throw std::runtime_error("injectTrace: program has no main function");
+  }
 
-  // 3) Build the new instruction list
-  std::vector<Instruction> newProgram;
+  // 3) Build the new instruction list.  The original instructions are moved
+  //    over as they are, rather than round-tripped through Instruction, so
+  //    each one is neither copied nor re-parsed
+  auto& allInstrs = mainInstrs->get_ref<json::array_t&>();
+  json::array_t newProgram;
   newProgram.reserve(1 + guardedTrace.size() + 1 + 1 + allInstrs.size());
 
   // a) speculate
   Instruction speculateInstr; speculateInstr.op = "speculate";
-  newProgram.push_back(speculateInstr);
+  newProgram.emplace_back(speculateInstr);
 
   // b) hot-path
   newProgram.insert(newProgram.end(),
@@ -48,33 +57,106 @@ void injectTrace(const std::string& path, const std::vector<Instruction>& guarde
 
   // c) commit
   Instruction commitInstr; commitInstr.op = "commit";
-  newProgram.push_back(commitInstr);
+  newProgram.emplace_back(commitInstr);
 
   // d) fallback label
   Instruction fallback; fallback.op = "";
   fallback.label = "hotpathfailed";
-  newProgram.push_back(fallback);
+  newProgram.emplace_back(fallback);
 
   // e) original code
   newProgram.insert(newProgram.end(),
-                    allInstrs.begin(), allInstrs.end());
-
-  // 4) Replace and emit
-  //   find the `main` function again and overwrite its instr list:
-  for (auto& f : j["functions"]) {
-    if (f["name"] == "main") {
-      f["instrs"] = json::array();
-      for (auto& inst : newProgram)
-        f["instrs"].push_back(inst);
-      break;
+                    std::make_move_iterator(allInstrs.begin()),
+                    std::make_move_iterator(allInstrs.end()));
+
+  // 4) Replace main's instr list in place
+  allInstrs = std::move(newProgram);
+
+  return j;
+}
+
+void writeProgram(const json& j, const std::vector<Instruction>& guardedTrace, const std::string& outputPath){
+  // Serialize main's new instruction list straight from the Instructions with
+  // write_instruction, and everything else with json::dump.  The text is what
+  // injectTrace(j, guardedTrace).dump() gives, but the program is not copied
+  // and the trace never becomes a DOM
+  auto key = [](std::string& out, const std::string& k) {
+    out += json(k).dump();
+    out += ':';
+  };
+
+  std::string out;
+  bool injected = false;
+  out += '{';
+  for (auto top = j.begin(); top != j.end(); ++top) {
+    if (top != j.begin()) out += ',';
+    key(out, top.key());
+    if (top.key() != "functions") {
+      out += top.value().dump();
+      continue;
     }
+
+    out += '[';
+    for (size_t k = 0; k < top.value().size(); k++) {
+      const json& f = top.value()[k];
+      if (k) out += ',';
+      if (injected || f.at("name") != "main") {
+        out += f.dump();
+        continue;
+      }
+      injected = true;
+      const json& instrs = f.at("instrs");
+
+      out += '{';
+      for (auto field = f.begin(); field != f.end(); ++field) {
+        if (field != f.begin()) out += ',';
+        key(out, field.key());
+        if (field.key() != "instrs") {
+          out += field.value().dump();
+          continue;
+        }
+
+        // speculate, hot path, commit, fallback label, original code
+        Instruction marker;
+        marker.op = "speculate";
+        out += '[';
+        write_instruction(out, marker);
+        for (const Instruction& instr : guardedTrace) {
+          out += ',';
+          write_instruction(out, instr);
+        }
+        marker.op = "commit";
+        out += ',';
+        write_instruction(out, marker);
+        marker.op = "";
+        marker.label = "hotpathfailed";
+        out += ',';
+        write_instruction(out, marker);
+        for (const json& instr : instrs) {
+          out += ',';
+          out += instr.dump();
+        }
+        out += ']';
+      }
+      out += '}';
+    }
+    out += ']';
+  }
+  out += '}';
+  if (!injected) {
+    throw std::runtime_error("injectTrace: program has no main function");
   }
 
   // Write to output file
   std::ofstream outFile(outputPath);
-  outFile << j.dump(2) << "\n";
-
+  if (!outFile) {
+    throw std::runtime_error("cannot write " + outputPath);
+  }
+  outFile << out << "\n";
+}
 
+void injectTrace(const std::string& path, const std::vector<Instruction>& guardedTrace, const std::string& outputPath){
+  writeProgram(loadProgram(path), guardedTrace, outputPath);
 }
 
-}
\ No newline at end of file
+}
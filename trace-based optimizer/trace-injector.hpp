@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <nlohmann/json.hpp>
 #include "../utils.hpp"   /**< Defines Instruction, from_json, to_json, etc. */
 
 namespace trace {
@@ -19,8 +20,8 @@ namespace trace {
  *   4. Defines a fallback label `hotpathfailed` for trace failures.
  *   5. Appends the original `"main"` instructions as the fallback path.
  *
- * The modified program is then written out in pretty-printed JSON form
- * to the specified output path.
+ * The modified program is then written out as compact JSON to the
+ * specified output path.
  *
  * @param path
  *   Filesystem path to the input Bril program (JSON file). The file
@@ -45,6 +46,56 @@ void injectTrace(
     const std::string& outputPath
 );
 
+/**
+ * @brief Reads a Bril program in JSON form.
+ *
+ * @param path
+ *   Filesystem path to the program, or `"-"` (or empty) for stdin.
+ *
+ * @throws std::runtime_error
+ *   If the file cannot be opened.
+ * @throws nlohmann::json::parse_error
+ *   If the JSON is malformed.
+ */
+nlohmann::json loadProgram(const std::string& path);
+
+/**
+ * @brief Inserts a guarded trace into an already parsed program.
+ *
+ * The in-memory half of the file-based `injectTrace` above: `main`'s
+ * instructions become speculate, trace, commit, `hotpathfailed`, original
+ * code.  The program is taken by value, so a caller holding a parsed program
+ * it wants to reuse passes a copy and keeps the original.
+ *
+ * @return The transformed program.
+ *
+ * @throws std::runtime_error
+ *   If there is no `"main"` function.
+ */
+nlohmann::json injectTrace(
+    nlohmann::json program,
+    const std::vector<Instruction>& guardedTrace
+);
+
+/**
+ * @brief Writes a program with a guarded trace injected into `main`,
+ * overwriting `outputPath`.
+ *
+ * Produces the same program as `injectTrace(program, guardedTrace)`, as
+ * compact JSON, without copying `program`: the new part of `main` is written
+ * directly from the `Instruction`s with `write_instruction`, so a cached
+ * program can be shared between jobs as is.
+ *
+ * @throws std::runtime_error
+ *   If there is no `"main"` function or the file cannot be opened for
+ *   writing.
+ */
+void writeProgram(
+    const nlohmann::json& program,
+    const std::vector<Instruction>& guardedTrace,
+    const std::string& outputPath
+);
+
 } // namespace trace
 
 #endif // TRACE_INJECTOR_HPP
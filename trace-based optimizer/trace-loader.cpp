@@ -35,14 +35,12 @@ std::vector<Instruction> addGuards(const std::vector<Instruction>& rawInstrs, co
 std::vector<Instruction>
 traceLoader(const std::string& path){
 
-  // Read trace from file and parse the JSON into a list of instructions
+  // Read trace from file and parse it straight into a list of instructions, without a DOM in between
   std::ifstream traceFile(path);
-  json j;
-
-  traceFile >> j; // uses utils to/from json functions for Instruction type
-
-  // Put all the instructions into a list
-  auto rawInstrs = j.get<std::vector<Instruction>>();
+  if (!traceFile) {
+    throw std::runtime_error("cannot open trace " + path);
+  }
+  auto rawInstrs = parse_instructions(traceFile);
 
   // Loop through instructions and replace branches with guards
   auto guardedInstrs = addGuards(rawInstrs, "hotpathfailed");
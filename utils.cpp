@@ -1,4 +1,8 @@
 #include "utils.hpp"
+#include <cstdio>
+#include <istream>
+#include <iterator>
+#include <stdexcept>
 #include <nlohmann/json.hpp>    // for nlohmann::json
 
 using nlohmann::json;
@@ -10,7 +14,7 @@ void to_json(nlohmann::json& j, const Instruction& i) {
   } else {
     j = nlohmann::json{{"op", i.op}};
     if (i.dest)  j["dest"]   = *i.dest;
-    if (i.type)  j["type"]   = *i.type;
+    if (i.type)  j["type"]   = !i.type->empty() && i.type->front() == '{' ? nlohmann::json::parse(*i.type) : nlohmann::json(*i.type);
     if (!i.funcs.empty()) j["funcs"]  = i.funcs;
     if (!i.args.empty())  j["args"]   = i.args;
     if (!i.labels.empty())j["labels"] = i.labels;
@@ -28,7 +32,7 @@ void from_json(const nlohmann::json& j, Instruction& i) {
   }
   if (j.contains("dest")) i.dest = j.at("dest").get<std::string>();
   else                   i.dest.reset();
-  if (j.contains("type")) i.type = j.at("type").get<std::string>();
+  if (j.contains("type")) i.type = j.at("type").is_string() ? j.at("type").get<std::string>() : j.at("type").dump();
   else                   i.type.reset();
   if (j.contains("funcs")) i.funcs = j.at("funcs").get<std::vector<std::string>>();
   else                     i.funcs.clear();
@@ -40,3 +44,276 @@ void from_json(const nlohmann::json& j, Instruction& i) {
   else                     i.value.reset();
 }
 
+
+
+namespace {
+
+/// SAX handler that fills Instructions from a JSON array of them as the
+/// parser reports each token.  Fields that can hold arbitrary JSON (value,
+/// parameterized types, unknown keys) are collected into a small DOM.
+class InstructionReader {
+public:
+  explicit InstructionReader(std::vector<Instruction>& out) : out(out) {}
+
+  bool null()                                        { return scalar(nullptr); }
+  bool boolean(bool b)                               { return scalar(b); }
+  bool number_integer(json::number_integer_t n)      { return scalar(n); }
+  bool number_unsigned(json::number_unsigned_t n)    { return scalar(n); }
+  bool number_float(json::number_float_t f, const json::string_t&) { return scalar(f); }
+  bool binary(json::binary_t&)                       { return fail("unexpected binary value"); }
+
+  bool string(json::string_t& s) {
+    if (state == State::List) {
+      list->push_back(std::move(s));
+      return true;
+    }
+    if (state == State::Instr && !capturing()) {
+      switch (field) {
+        case Field::Op:    cur.op = std::move(s);    field = Field::None; return true;
+        case Field::Label: cur.label = std::move(s); field = Field::None; return true;
+        case Field::Dest:  cur.dest = std::move(s);  field = Field::None; return true;
+        case Field::Type:  cur.type = std::move(s);  field = Field::None; return true;
+        default: break;
+      }
+    }
+    return scalar(std::move(s));
+  }
+
+  bool start_object(std::size_t) {
+    if (capturing() || (state == State::Instr && is_any(field))) {
+      capture_open(json::object());
+    } else if (state == State::Array) {
+      cur = Instruction{};
+      state = State::Instr;
+      field = Field::None;
+    } else {
+      return fail("expected an array of instructions");
+    }
+    return true;
+  }
+
+  bool key(json::string_t& k) {
+    if (capturing()) {
+      pending_key = std::move(k);
+    } else if (k == "op")     { field = Field::Op; }
+    else if (k == "label")  { field = Field::Label; }
+    else if (k == "dest")   { field = Field::Dest; }
+    else if (k == "type")   { field = Field::Type; }
+    else if (k == "args")   { field = Field::Args; }
+    else if (k == "labels") { field = Field::Labels; }
+    else if (k == "funcs")  { field = Field::Funcs; }
+    else if (k == "value")  { field = Field::Value; }
+    else                    { field = Field::Skip; }
+    return true;
+  }
+
+  bool end_object() {
+    if (capturing()) {
+      capture_close();
+      return true;
+    }
+    // Same rules as from_json: a label has no op, anything else must have one
+    if (cur.label) {
+      cur.op.clear();
+    } else if (cur.op.empty()) {
+      return fail("instruction has neither \"op\" nor \"label\"");
+    }
+    out.push_back(std::move(cur));
+    state = State::Array;
+    return true;
+  }
+
+  bool start_array(std::size_t) {
+    if (capturing() || (state == State::Instr && is_any(field))) {
+      capture_open(json::array());
+    } else if (state == State::Top) {
+      state = State::Array;
+    } else if (state == State::Instr && (field == Field::Args || field == Field::Labels || field == Field::Funcs)) {
+      list = field == Field::Args ? &cur.args : field == Field::Labels ? &cur.labels : &cur.funcs;
+      list->clear();
+      state = State::List;
+    } else {
+      return fail("unexpected array");
+    }
+    return true;
+  }
+
+  bool end_array() {
+    if (capturing()) {
+      capture_close();
+    } else if (state == State::List) {
+      state = State::Instr;
+      field = Field::None;
+    } else {
+      state = State::Done;
+    }
+    return true;
+  }
+
+  bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) {
+    // Rethrow with its real type, as json::parse would
+    if (auto* pe = dynamic_cast<const json::parse_error*>(&ex)) throw *pe;
+    throw std::runtime_error(ex.what());
+  }
+
+private:
+  enum class State { Top, Array, Instr, List, Done };
+  enum class Field { None, Op, Label, Dest, Type, Args, Labels, Funcs, Value, Skip };
+
+  // Fields whose value is kept (or dropped) as whatever JSON it is
+  static bool is_any(Field f) { return f == Field::Type || f == Field::Value || f == Field::Skip; }
+
+  bool capturing() const { return !stack.empty(); }
+
+  bool fail(const std::string& what) {
+    throw std::runtime_error("parse_instructions: " + what + " (instruction " + std::to_string(out.size()) + ")");
+  }
+
+  template <typename T>
+  bool scalar(T&& v) {
+    if (capturing()) {
+      json& top = *stack.back();
+      if (top.is_array()) top.push_back(std::forward<T>(v));
+      else                top[pending_key] = std::forward<T>(v);
+      return true;
+    }
+    if (state != State::Instr || !is_any(field)) {
+      return fail(state == State::List ? "expected a string in a list" : "unexpected value");
+    }
+    captured = std::forward<T>(v);
+    finish_capture();
+    return true;
+  }
+
+  void capture_open(json&& container) {
+    json* slot;
+    if (!capturing()) {
+      captured = std::move(container);
+      slot = &captured;
+    } else if (stack.back()->is_array()) {
+      stack.back()->push_back(std::move(container));
+      slot = &stack.back()->back();
+    } else {
+      slot = &((*stack.back())[pending_key] = std::move(container));
+    }
+    stack.push_back(slot);
+  }
+
+  void capture_close() {
+    stack.pop_back();
+    if (!capturing()) finish_capture();
+  }
+
+  void finish_capture() {
+    if (field == Field::Value)     cur.value = std::move(captured);
+    else if (field == Field::Type) cur.type = captured.is_string() ? captured.get<std::string>() : captured.dump();
+    field = Field::None;
+  }
+
+  std::vector<Instruction>& out;
+  State state = State::Top;
+  Field field = Field::None;
+  Instruction cur;
+  std::vector<std::string>* list = nullptr;
+
+  // DOM under construction for a value/type/unknown field, and the open containers in it
+  json captured;
+  std::vector<json*> stack;
+  std::string pending_key;
+};
+
+void write_string(std::string& out, const std::string& s) {
+  // Escape exactly what json::dump escapes
+  out += '"';
+  for (unsigned char c : s) {
+    switch (c) {
+      case '"':  out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\b': out += "\\b";  break;
+      case '\f': out += "\\f";  break;
+      case '\n': out += "\\n";  break;
+      case '\r': out += "\\r";  break;
+      case '\t': out += "\\t";  break;
+      default:
+        if (c < 0x20) {
+          char buf[7];
+          std::snprintf(buf, sizeof buf, "\\u%04x", c);
+          out += buf;
+        } else {
+          out += static_cast<char>(c);
+        }
+    }
+  }
+  out += '"';
+}
+
+void write_list(std::string& out, const char* key, const std::vector<std::string>& list) {
+  out += key;
+  out += '[';
+  for (size_t k = 0; k < list.size(); k++) {
+    if (k) out += ',';
+    write_string(out, list[k]);
+  }
+  out += ']';
+}
+
+} // namespace
+
+std::vector<Instruction> parse_instructions(const std::string& text) {
+  std::vector<Instruction> instrs;
+  InstructionReader reader(instrs);
+  json::sax_parse(text, &reader);
+  return instrs;
+}
+
+std::vector<Instruction> parse_instructions(std::istream& in) {
+  // Parsing from memory is much faster than through the stream's buffer a byte at a time
+  std::string text{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+  return parse_instructions(text);
+}
+
+void write_instruction(std::string& out, const Instruction& i) {
+  if (i.label) {
+    out += "{\"label\":";
+    write_string(out, *i.label);
+    out += '}';
+    return;
+  }
+
+  // Keys in the sorted order json::dump uses
+  out += '{';
+  bool first = true;
+  auto sep = [&]() -> std::string& { if (!first) out += ','; first = false; return out; };
+  if (!i.args.empty())   write_list(sep(), "\"args\":", i.args);
+  if (i.dest)            { sep() += "\"dest\":"; write_string(out, *i.dest); }
+  if (!i.funcs.empty())  write_list(sep(), "\"funcs\":", i.funcs);
+  if (!i.labels.empty()) write_list(sep(), "\"labels\":", i.labels);
+  sep() += "\"op\":";
+  write_string(out, i.op);
+  if (i.type) {
+    // Parameterized types are already stored as compact JSON text
+    sep() += "\"type\":";
+    if (!i.type->empty() && i.type->front() == '{') out += *i.type;
+    else                                         write_string(out, *i.type);
+  }
+  if (i.value) {
+    sep() += "\"value\":";
+    if (i.value->is_number_integer()) out += i.value->is_number_unsigned() ? std::to_string(i.value->get<uint64_t>())
+                                                                           : std::to_string(i.value->get<int64_t>());
+    else if (i.value->is_boolean())   out += i.value->get<bool>() ? "true" : "false";
+    else                              out += i.value->dump();
+  }
+  out += '}';
+}
+
+std::string dump_instructions(const std::vector<Instruction>& instrs) {
+  std::string out;
+  out.reserve(instrs.size() * 64);
+  out += '[';
+  for (size_t k = 0; k < instrs.size(); k++) {
+    if (k) out += ',';
+    write_instruction(out, instrs[k]);
+  }
+  out += ']';
+  return out;
+}
@@ -1,6 +1,7 @@
 #ifndef UTILS_HPP
 #define UTILS_HPP
 
+#include <iosfwd>
 #include <string>
 #include <vector>
 #include <optional>
@@ -37,7 +38,8 @@ struct Instruction {
   std::optional<std::string>   dest;
 
   /// The type of the destination register, if any.
-  /// E.g. "int", "bool", or "float".
+  /// E.g. "int", "bool", or "float".  Parameterized types such as
+  /// `{"ptr": "int"}` are kept as their JSON text.
   std::optional<std::string>   type;
 
   /// The operand registers or literal arguments for this instruction.
@@ -81,4 +83,30 @@ void to_json(nlohmann::json& j, const Instruction& i);
 /// \param i  The Instruction to populate.
 void from_json(const nlohmann::json& j, Instruction& i);
 
+/// \brief Parse a JSON array of instructions straight into Instructions.
+///
+/// Gives the same result as
+///   nlohmann::json::parse(text).get<std::vector<Instruction>>()
+/// but fills each Instruction from the parser's events as they arrive, so
+/// no DOM is built for the array, the instructions, or their string fields.
+/// Only \c value and parameterized \c type, which can be any JSON, are
+/// built as small DOMs.  Unknown fields (e.g. "pos") are skipped.
+///
+/// \param text  A JSON array of Bril instructions and labels, such as a trace.
+/// \throws nlohmann::json::parse_error on malformed JSON.
+/// \throws std::runtime_error if an element is not a valid instruction.
+std::vector<Instruction> parse_instructions(const std::string& text);
+
+/// \brief Read a whole stream and parse it with parse_instructions.
+std::vector<Instruction> parse_instructions(std::istream& in);
+
+/// \brief Append an Instruction to \p out as compact JSON.
+///
+/// Writes the text directly; the output is byte-for-byte what
+/// \c nlohmann::json(i).dump() gives, without building the object first.
+void write_instruction(std::string& out, const Instruction& i);
+
+/// \brief Serialize a list of Instructions as a compact JSON array.
+std::string dump_instructions(const std::vector<Instruction>& instrs);
+
 #endif // UTILS_HPP
\ No newline at end of file